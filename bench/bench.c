@@ -0,0 +1,193 @@
+// bench/bench.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+// Runs machdump over each file in every output mode and reports throughput
+// and peak memory. Each run is a separate process with its output sent to
+// /dev/null, so the numbers cover the whole tool: mapping, parsing,
+// formatting and writing. The best of several runs is reported.
+
+// wait4 is not POSIX, but it is the only way to get one child's peak RSS.
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <mach-o/loader.h>
+
+#define S(...) struct __VA_ARGS__
+
+struct mode {
+    const char* name;
+    const char* args[3];
+};
+
+static const struct mode modes[] = {
+    { "text", { "--no-color", NULL } },
+    { "json", { "--format", "json", NULL } },
+    { "binary", { "--format", "binary", NULL } },
+    { "hexdump", { "--no-color", "--hexdump", NULL } },
+};
+
+struct result {
+    double seconds;
+    long peak_kb;
+    int failed;
+};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static struct result run(const char* machdump, const struct mode* mode,
+                         const char* filename) {
+    struct result result = { 0, 0, 1 };
+    const char* argv[6];
+    size_t argc = 0;
+    argv[argc++] = machdump;
+    for (size_t i = 0; mode->args[i]; i++) {
+        argv[argc++] = mode->args[i];
+    }
+    argv[argc++] = filename;
+    argv[argc] = NULL;
+
+    const double start = now();
+    const pid_t pid = fork();
+    if (pid < 0) {
+        perror("bench: fork");
+        return result;
+    } else if (pid == 0) {
+        const int null = open("/dev/null", O_WRONLY);
+        if (null >= 0) {
+            dup2(null, STDOUT_FILENO);
+        }
+        execv(machdump, (char* const*)argv);
+        perror("bench: exec");
+        _exit(127);
+    }
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        perror("bench: wait");
+        return result;
+    }
+    result.seconds = now() - start;
+    // ru_maxrss is in kilobytes on Linux and in bytes on macOS.
+    #ifdef __APPLE__
+    result.peak_kb = usage.ru_maxrss / 1024;
+    #else
+    result.peak_kb = usage.ru_maxrss;
+    #endif
+    result.failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    return result;
+}
+
+// Returns the number of symbols in the file, from its LC_SYMTAB.
+static uint64_t count_symbols(const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    uint64_t nsyms = 0;
+    S(mach_header_64) header;
+    if (!file || fread(&header, sizeof(header), 1, file) != 1
+        || header.magic != MH_MAGIC_64) {
+        if (file) fclose(file);
+        return 0;
+    }
+    for (uint32_t i = 0; i < header.ncmds; i++) {
+        S(symtab_command) command;
+        const long offset = ftell(file);
+        if (fread(&command, sizeof(S(load_command)), 1, file) != 1
+            || command.cmdsize < sizeof(S(load_command))) {
+            break;
+        }
+        if (command.cmd == LC_SYMTAB) {
+            fseek(file, offset, SEEK_SET);
+            if (fread(&command, sizeof(command), 1, file) == 1) {
+                nsyms = command.nsyms;
+            }
+            break;
+        }
+        fseek(file, offset + (long)command.cmdsize, SEEK_SET);
+    }
+    fclose(file);
+    return nsyms;
+}
+
+int main(int argc, const char* argv[]) {
+    int repeat = 3;
+    int first = 1;
+    if (argc > 2 && strcmp(argv[1], "-r") == 0) {
+        repeat = atoi(argv[2]);
+        first = 3;
+    }
+    if (argc - first < 2 || repeat < 1) {
+        fprintf(stderr, "Usage: bench [-r RUNS] MACHDUMP FILE...\n");
+        return 1;
+    }
+    const char* machdump = argv[first];
+
+    printf("%-28s %-8s %9s %9s %9s %12s %10s\n", "file", "mode", "MB",
+           "seconds", "MB/s", "symbols/s", "peak MB");
+    int failed = 0;
+    for (int f = first + 1; f < argc; f++) {
+        struct stat info;
+        if (stat(argv[f], &info) != 0) {
+            perror(argv[f]);
+            failed = 1;
+            continue;
+        }
+        const double megabytes = (double)info.st_size / (1024 * 1024);
+        const uint64_t nsyms = count_symbols(argv[f]);
+        for (size_t m = 0; m < sizeof(modes) / sizeof(*modes); m++) {
+            struct result best = { 0, 0, 0 };
+            for (int r = 0; r < repeat; r++) {
+                const struct result result = run(machdump, &modes[m],
+                                                  argv[f]);
+                if (result.failed) {
+                    best.failed = 1;
+                    break;
+                }
+                if (r == 0 || result.seconds < best.seconds) {
+                    best.seconds = result.seconds;
+                }
+                if (result.peak_kb > best.peak_kb) {
+                    best.peak_kb = result.peak_kb;
+                }
+            }
+            if (best.failed) {
+                printf("%-28s %-8s %9.1f %9s\n", argv[f], modes[m].name,
+                       megabytes, "failed");
+                failed = 1;
+                continue;
+            }
+            printf("%-28s %-8s %9.1f %9.3f %9.1f %12.0f %10.1f\n", argv[f],
+                   modes[m].name, megabytes, best.seconds,
+                   megabytes / best.seconds, (double)nsyms / best.seconds,
+                   (double)best.peak_kb / 1024);
+            fflush(stdout);
+        }
+    }
+    return failed;
+}
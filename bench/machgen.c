@@ -0,0 +1,418 @@
+// bench/machgen.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+// Writes a synthetic but valid Mach-O object for benchmarking. The shape of
+// the file (width, byte order, segments, sections per segment, section size,
+// symbols, string table size and extra load commands) is set on the command
+// line, and the contents are generated from a fixed seed so that runs are
+// repeatable.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mach-o/loader.h>
+#include <mach-o/nlist.h>
+
+#define S(...) struct __VA_ARGS__
+#define ALIGN(n, a) (((n) + (a) - 1) & ~(uint64_t)((a) - 1))
+
+struct config {
+    const char* output;
+    uint32_t segments;
+    uint32_t sections;
+    uint64_t section_size;
+    uint32_t symbols;
+    uint64_t strsize;
+    uint32_t commands;
+    // 32-bit layout instead of 64-bit, and big-endian instead of host order.
+    int narrow;
+    int swapped;
+};
+
+static uint64_t state = 0x9e3779b97f4a7c15ull;
+
+static uint64_t next_random(void) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static void die(const char* message) {
+    fprintf(stderr, "machgen: error: %s\n", message);
+    exit(1);
+}
+
+static void put(FILE* file, const void* bytes, size_t size) {
+    if (fwrite(bytes, 1, size, file) != size) {
+        die("could not write output");
+    }
+}
+
+static void pad(FILE* file, uint64_t from, uint64_t to) {
+    static const char zeros[4096];
+    while (from < to) {
+        const size_t n = to - from < sizeof(zeros) ? (size_t)(to - from)
+                                                   : sizeof(zeros);
+        put(file, zeros, n);
+        from += n;
+    }
+}
+
+static void put32(const struct config* config, FILE* file, uint32_t value) {
+    if (config->swapped) {
+        value = value >> 24 | (value >> 8 & 0xff00) | (value << 8 & 0xff0000)
+                | value << 24;
+    }
+    put(file, &value, sizeof(value));
+}
+
+static void put16(const struct config* config, FILE* file, uint16_t value) {
+    if (config->swapped) {
+        value = (uint16_t)(value >> 8 | value << 8);
+    }
+    put(file, &value, sizeof(value));
+}
+
+static void put64(const struct config* config, FILE* file, uint64_t value) {
+    const uint32_t low = (uint32_t)value;
+    const uint32_t high = (uint32_t)(value >> 32);
+    // Host order is assumed little-endian, as everywhere Mach-O runs today.
+    put32(config, file, config->swapped ? high : low);
+    put32(config, file, config->swapped ? low : high);
+}
+
+// Addresses and sizes are as wide as the file.
+static void put_word(const struct config* config, FILE* file,
+                     uint64_t value) {
+    if (config->narrow) {
+        put32(config, file, (uint32_t)value);
+    } else {
+        put64(config, file, value);
+    }
+}
+
+// Writes a structure made only of 32-bit fields.
+static void put_words(const struct config* config, FILE* file,
+                      const void* bytes, size_t size) {
+    for (size_t i = 0; i < size; i += sizeof(uint32_t)) {
+        uint32_t word;
+        memcpy(&word, (const char*)bytes + i, sizeof(word));
+        put32(config, file, word);
+    }
+}
+
+// Section contents are a mix of code-like random bytes and runs of text, so
+// that both the hex and the ASCII columns of --hexdump get exercised.
+static void put_contents(FILE* file, uint64_t size) {
+    static const char text[] = "the quick brown fox jumps over the lazy dog ";
+    unsigned char chunk[4096];
+    while (size > 0) {
+        const size_t n = size < sizeof(chunk) ? (size_t)size : sizeof(chunk);
+        for (size_t i = 0; i < n; i += 8) {
+            const uint64_t r = next_random();
+            memcpy(chunk + i, &r, n - i < 8 ? n - i : 8);
+        }
+        for (size_t i = 0; i + 64 <= n; i += 512) {
+            memcpy(chunk + i, text, sizeof(text) - 1);
+        }
+        put(file, chunk, n);
+        size -= n;
+    }
+}
+
+// Symbol names are "_sym" and the index, padded with letters to `length`
+// so that the string table reaches the requested size. Returns the bytes
+// the name takes in the string table, and writes it if `file` is set.
+static size_t symbol_name(FILE* file, uint32_t index, size_t length) {
+    static const char letters[] = "abcdefghijklmnopqrstuvwxyz"
+                                  "abcdefghijklmnopqrstuvwxyz";
+    char prefix[16];
+    const size_t n = (size_t)sprintf(prefix, "_sym%u", index);
+    if (file) {
+        put(file, prefix, n);
+        for (size_t i = n; i < length; i += 26) {
+            put(file, letters + (i + index) % 26,
+                length - i < 26 ? length - i : 26);
+        }
+        put(file, "", 1);
+    }
+    return (n < length ? length : n) + 1;
+}
+
+// Fills a 16-byte name field, which need not be NUL-terminated.
+static void set_name(char* field, const char* prefix, uint32_t n) {
+    char name[32];
+    const int length = snprintf(name, sizeof(name), "%s%u", prefix, n);
+    memset(field, 0, 16);
+    memcpy(field, name, length < 16 ? (size_t)length : 16);
+}
+
+static void generate(const struct config* config, FILE* file) {
+    const uint32_t nsects = config->segments * config->sections;
+    const size_t header_size = config->narrow ? sizeof(S(mach_header))
+                                              : sizeof(S(mach_header_64));
+    const size_t section_size = config->narrow ? sizeof(S(section))
+                                               : sizeof(S(section_64));
+    const size_t nlist_size = config->narrow ? sizeof(S(nlist))
+                                             : sizeof(S(nlist_64));
+    const uint64_t seg_size = (config->narrow ? sizeof(S(segment_command))
+                                              : sizeof(S(segment_command_64)))
+        + (uint64_t)config->sections * section_size;
+    const uint32_t ncmds = config->segments + 4 + config->commands;
+    const uint64_t sizeofcmds = config->segments * seg_size
+        + sizeof(S(symtab_command)) + sizeof(S(dysymtab_command))
+        + sizeof(S(build_version_command)) + sizeof(S(uuid_command))
+        + (uint64_t)config->commands * sizeof(S(source_version_command));
+    if (sizeofcmds > UINT32_MAX) {
+        die("too many load commands");
+    }
+
+    // Every name gets at least its "_symN" prefix; the remainder of the
+    // requested string table is spread evenly over the names.
+    const size_t base = config->symbols ? config->strsize / config->symbols
+                                        : 0;
+    const size_t name_length = base > 1 ? base - 1 : 0;
+    const uint64_t data_off = ALIGN(header_size + sizeofcmds, 16);
+    const uint64_t symoff = ALIGN(data_off + nsects * config->section_size,
+                                  8);
+    const uint64_t stroff = symoff
+        + (uint64_t)config->symbols * nlist_size;
+    uint64_t strsize = 1;
+    for (uint32_t i = 0; i < config->symbols; i++) {
+        strsize += symbol_name(NULL, i, name_length);
+    }
+    if (stroff + strsize > UINT32_MAX) {
+        die("file would exceed the 4 GiB reach of 32-bit offsets");
+    }
+
+    S(mach_header_64) header = {0};
+    header.magic = config->narrow ? MH_MAGIC : MH_MAGIC_64;
+    header.cputype = config->narrow ? CPU_TYPE_I386 : CPU_TYPE_X86_64;
+    header.cpusubtype = config->narrow ? CPU_SUBTYPE_I386_ALL
+                                       : CPU_SUBTYPE_X86_64_ALL;
+    header.filetype = MH_OBJECT;
+    header.ncmds = ncmds;
+    header.sizeofcmds = (uint32_t)sizeofcmds;
+    header.flags = MH_SUBSECTIONS_VIA_SYMBOLS;
+    // The 32-bit header is the 64-bit one without `reserved`.
+    put_words(config, file, &header, header_size);
+
+    uint64_t offset = data_off;
+    for (uint32_t s = 0; s < config->segments; s++) {
+        char segname[16];
+        set_name(segname, "__SEG", s);
+        const uint64_t vmsize = config->sections * config->section_size;
+        put32(config, file, config->narrow ? LC_SEGMENT : LC_SEGMENT_64);
+        put32(config, file, (uint32_t)seg_size);
+        put(file, segname, sizeof(segname));
+        put_word(config, file, offset - data_off);
+        put_word(config, file, vmsize);
+        put_word(config, file, offset);
+        put_word(config, file, vmsize);
+        put32(config, file, 7);
+        put32(config, file, 7);
+        put32(config, file, config->sections);
+        put32(config, file, 0);
+        for (uint32_t i = 0; i < config->sections; i++) {
+            char sectname[16];
+            set_name(sectname, "__sect", i);
+            put(file, sectname, sizeof(sectname));
+            put(file, segname, sizeof(segname));
+            put_word(config, file, offset - data_off);
+            put_word(config, file, config->section_size);
+            put32(config, file, (uint32_t)offset);
+            put32(config, file, 4);
+            put32(config, file, 0);
+            put32(config, file, 0);
+            put32(config, file, i == 0 ? S_REGULAR | S_ATTR_PURE_INSTRUCTIONS
+                                         | S_ATTR_SOME_INSTRUCTIONS
+                                       : S_REGULAR);
+            put32(config, file, 0);
+            put32(config, file, 0);
+            if (!config->narrow) {
+                put32(config, file, 0);
+            }
+            offset += config->section_size;
+        }
+    }
+
+    // Locals come first, then external definitions, then undefined
+    // externals, as LC_DYSYMTAB requires.
+    const uint32_t nlocal = config->symbols / 4;
+    const uint32_t nundef = config->symbols / 4;
+    const uint32_t nextdef = config->symbols - nlocal - nundef;
+
+    S(symtab_command) symtab = {0};
+    symtab.cmd = LC_SYMTAB;
+    symtab.cmdsize = sizeof(symtab);
+    symtab.symoff = (uint32_t)symoff;
+    symtab.nsyms = config->symbols;
+    symtab.stroff = (uint32_t)stroff;
+    symtab.strsize = (uint32_t)strsize;
+    put_words(config, file, &symtab, sizeof(symtab));
+
+    S(dysymtab_command) dysymtab = {0};
+    dysymtab.cmd = LC_DYSYMTAB;
+    dysymtab.cmdsize = sizeof(dysymtab);
+    dysymtab.ilocalsym = 0;
+    dysymtab.nlocalsym = nlocal;
+    dysymtab.iextdefsym = nlocal;
+    dysymtab.nextdefsym = nextdef;
+    dysymtab.iundefsym = nlocal + nextdef;
+    dysymtab.nundefsym = nundef;
+    put_words(config, file, &dysymtab, sizeof(dysymtab));
+
+    S(build_version_command) version = {0};
+    version.cmd = LC_BUILD_VERSION;
+    version.cmdsize = sizeof(version);
+    version.platform = 1;
+    version.minos = 0x000b0000;
+    version.sdk = 0x000b0300;
+    put_words(config, file, &version, sizeof(version));
+
+    S(uuid_command) uuid = {0};
+    uuid.cmd = LC_UUID;
+    uuid.cmdsize = sizeof(uuid);
+    for (size_t i = 0; i < sizeof(uuid.uuid); i++) {
+        uuid.uuid[i] = (uint8_t)next_random();
+    }
+    put32(config, file, uuid.cmd);
+    put32(config, file, uuid.cmdsize);
+    put(file, uuid.uuid, sizeof(uuid.uuid));
+
+    for (uint32_t i = 0; i < config->commands; i++) {
+        put32(config, file, LC_SOURCE_VERSION);
+        put32(config, file, sizeof(S(source_version_command)));
+        put64(config, file, i);
+    }
+
+    pad(file, header_size + sizeofcmds, data_off);
+    for (uint32_t i = 0; i < nsects; i++) {
+        put_contents(file, config->section_size);
+    }
+    pad(file, data_off + nsects * config->section_size, symoff);
+
+    uint32_t strx = 1;
+    for (uint32_t i = 0; i < config->symbols; i++) {
+        S(nlist_64) sym = {0};
+        sym.n_un.n_strx = strx;
+        if (i < nlocal + nextdef && nsects > 0) {
+            sym.n_type = N_SECT | (i >= nlocal ? N_EXT : 0);
+            sym.n_sect = (uint8_t)(1 + i % (nsects < MAX_SECT ? nsects
+                                                              : MAX_SECT));
+            sym.n_value = (uint64_t)i * 16;
+        } else {
+            sym.n_type = N_UNDF | N_EXT;
+        }
+        put32(config, file, sym.n_un.n_strx);
+        put(file, &sym.n_type, 1);
+        put(file, &sym.n_sect, 1);
+        put16(config, file, sym.n_desc);
+        put_word(config, file, sym.n_value);
+        strx += (uint32_t)symbol_name(NULL, i, name_length);
+    }
+
+    put(file, "", 1);
+    for (uint32_t i = 0; i < config->symbols; i++) {
+        symbol_name(file, i, name_length);
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "Usage: machgen [OPTION...] -o FILE\n"
+            "\n"
+            "  --width 32         32-bit layout (default 64)\n"
+            "  --big-endian       big-endian byte order\n"
+            "  --segments N       segment commands (default 1)\n"
+            "  --sections N       sections per segment (default 2)\n"
+            "  --section-size N   bytes per section (default 4096)\n"
+            "  --symbols N        symbol table entries (default 1000)\n"
+            "  --strsize N        approximate string table bytes (default "
+            "16 per symbol)\n"
+            "  --commands N       extra LC_SOURCE_VERSION commands "
+            "(default 0)\n");
+    exit(1);
+}
+
+static uint64_t parse_number(const char* text) {
+    char* end;
+    if (!text) {
+        usage();
+    }
+    uint64_t value = strtoull(text, &end, 0);
+    switch (*end) {
+        case 'k': case 'K': value <<= 10; end++; break;
+        case 'm': case 'M': value <<= 20; end++; break;
+        case 'g': case 'G': value <<= 30; end++; break;
+    }
+    if (*text == '\0' || *end != '\0') {
+        usage();
+    }
+    return value;
+}
+
+int main(int argc, const char* argv[]) {
+    struct config config = { NULL, 1, 2, 4096, 1000, 0, 0, 0, 0 };
+    int strsize_set = 0;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "-o") == 0 && i + 1 < argc) {
+            config.output = argv[++i];
+        } else if (strcmp(arg, "--width") == 0 && i + 1 < argc) {
+            const char* width = argv[++i];
+            if (strcmp(width, "32") != 0 && strcmp(width, "64") != 0) {
+                usage();
+            }
+            config.narrow = strcmp(width, "32") == 0;
+        } else if (strcmp(arg, "--big-endian") == 0) {
+            config.swapped = 1;
+        } else if (strcmp(arg, "--segments") == 0) {
+            config.segments = (uint32_t)parse_number(argv[++i]);
+        } else if (strcmp(arg, "--sections") == 0) {
+            config.sections = (uint32_t)parse_number(argv[++i]);
+        } else if (strcmp(arg, "--section-size") == 0) {
+            config.section_size = parse_number(argv[++i]);
+        } else if (strcmp(arg, "--symbols") == 0) {
+            config.symbols = (uint32_t)parse_number(argv[++i]);
+        } else if (strcmp(arg, "--strsize") == 0) {
+            config.strsize = parse_number(argv[++i]);
+            strsize_set = 1;
+        } else if (strcmp(arg, "--commands") == 0) {
+            config.commands = (uint32_t)parse_number(argv[++i]);
+        } else {
+            usage();
+        }
+    }
+    if (!config.output) {
+        usage();
+    }
+    if (!strsize_set) {
+        config.strsize = (uint64_t)config.symbols * 16;
+    }
+
+    FILE* file = fopen(config.output, "wb");
+    if (!file) {
+        die("could not open output");
+    }
+    generate(&config, file);
+    if (fclose(file) != 0) {
+        die("could not write output");
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+// include/arch.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stdint.h>
+
+// An architecture as named on the command line (`--arch arm64`) and as
+// identified in Mach-O and fat headers.
+struct arch {
+    const char* name;
+    int32_t cputype;
+    int32_t cpusubtype;
+};
+
+// Returns the architecture called `name`, or NULL if there is none.
+const struct arch* arch_from_name(const char* name);
+
+// Returns the architecture for a CPU type and subtype, or NULL if unknown.
+// Capability bits in the subtype are ignored.
+const struct arch* arch_from_cpu(int32_t cputype, int32_t cpusubtype);
+
+// Returns whether a header's CPU type and subtype match `arch`.
+int arch_matches(const struct arch* arch, int32_t cputype,
+                 int32_t cpusubtype);
@@ -0,0 +1,92 @@
+// include/archive.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct arena;
+struct source;
+
+// A static library is an ar(1) archive: the magic "!<arch>\n" followed by
+// members, each a 60-byte text header and its contents. BSD archives, which
+// is what Apple's tools write, store names longer than 16 bytes or
+// containing spaces as "#1/LENGTH" with the name at the start of the
+// contents. The first member may be a ranlib symbol index, "__.SYMDEF" and
+// its variants, mapping symbol names to the members defining them.
+//
+// Parsing walks the member headers only; member contents are never read, so
+// each member can be dumped as a slice of the archive.
+enum archive_status {
+    ArchiveOk,
+    ArchiveNotArchive,
+    ArchiveBadHeader,
+    ArchiveBadLongName,
+    ArchiveMemberOutOfBounds,
+    ArchiveBadSymbolIndex
+};
+
+struct archive_member {
+    // Copied into the arena and terminated.
+    const char* name;
+    // Where the member's header starts, which is how the symbol index
+    // refers to it.
+    uint64_t header;
+    // Where its contents start, past any long name, and their size.
+    uint64_t offset;
+    uint64_t size;
+    uint64_t date;
+    uint32_t uid;
+    uint32_t gid;
+    uint32_t mode;
+};
+
+struct archive_symbol {
+    // NULL if the name lies outside the index's string table.
+    const char* name;
+    // The member defining the symbol, or NULL if `header` is not the start
+    // of one.
+    const struct archive_member* member;
+    uint64_t header;
+};
+
+struct archive {
+    struct source* source;
+    struct arena* arena;
+    // Every member but the symbol index, in file order.
+    struct archive_member* members;
+    size_t nmembers;
+    // The symbol index member, or NULL, and its entries.
+    const struct archive_member* symdef;
+    int symdef_64;
+    struct archive_symbol* symbols;
+    size_t nsymbols;
+    // The first problem found, if any. Members before a bad header are kept
+    // and the rest of the archive is skipped.
+    enum archive_status status;
+    uint64_t error_offset;
+};
+
+// Returns whether `source` starts with the archive magic.
+int archive_is(struct source* source);
+
+// Parses the member headers of `source` and its symbol index. Returns
+// ArchiveOk, or the first problem found, which is also kept in `status`.
+enum archive_status archive_parse(struct archive* archive,
+                                  struct source* source, struct arena* arena);
+
+const char* archive_status_message(enum archive_status status);
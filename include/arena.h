@@ -0,0 +1,46 @@
+// include/arena.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stddef.h>
+
+struct arena_block;
+
+// A bump allocator for everything that lives as long as one file's dump.
+// Nothing is freed individually; arena_reset releases it all at once and
+// keeps the memory for the next file, so dumping a run of similar files
+// settles into no allocations at all.
+struct arena {
+    struct arena_block* blocks;
+    size_t used;
+    size_t total;
+};
+
+void arena_init(struct arena* arena);
+
+// Returns `size` bytes aligned for any type. Never returns NULL.
+void* arena_alloc(struct arena* arena, size_t size);
+
+// Like arena_alloc, but returns NULL when memory is exhausted rather than
+// calling the failure handler in safe.h.
+void* arena_try_alloc(struct arena* arena, size_t size);
+
+// Releases every allocation. The arena is left with a single block large
+// enough for everything that was allocated since the last reset.
+void arena_reset(struct arena* arena);
+
+void arena_free(struct arena* arena);
@@ -0,0 +1,94 @@
+// include/cache.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+// Part of every entry's key, so entries from builds that print something
+// different are never used. Bump it with any change to what a dump prints.
+#define CACHE_FORMAT_VERSION 1
+
+// The size a cache directory may grow to unless told otherwise: 1 GiB.
+#define CACHE_DEFAULT_SIZE ((uint64_t)1 << 30)
+
+struct dump_options;
+struct output;
+struct source;
+
+// An on-disk cache of rendered dumps, so that files which have not changed
+// since the last run are copied out instead of parsed again. Entries are
+// keyed by the file's device, inode, size and modification time together
+// with everything that affects the output, and a hit is confirmed with a
+// hash of the file's contents before it is used.
+//
+// Each entry is a file that is written under a temporary name and renamed
+// into place, so processes sharing the directory never see one half
+// written and need no lock to read. Eviction, which removes the least
+// recently used entries until the directory fits in its limit, and the hit
+// and miss counters kept in the directory are updated under an fcntl lock.
+struct cache {
+    const char* dir;
+    uint64_t limit;
+    uint64_t options;
+    pthread_mutex_t lock;
+    // Counts for this run, added to the directory's counters on close.
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t evictions;
+};
+
+// What cache_lookup learned about a file, for cache_store on a miss.
+struct cache_key {
+    uint64_t identity;
+    uint64_t content;
+    int hashed;
+    // The dump's status on a hit.
+    int status;
+};
+
+enum cache_result {
+    CacheHit,
+    CacheMiss,
+    CacheSkip
+};
+
+// Opens, creating it if needed, the cache in `dir`, which may grow to
+// `limit` bytes, for dumps made with `options` to outputs with the given
+// colors. Returns 0 on success and -1 with errno set on failure.
+int cache_open(struct cache* cache, const char* dir, uint64_t limit,
+               const struct dump_options* options, int color,
+               int err_color);
+
+// Looks up the dump of `source`, opened from `filename`. On a hit, the
+// cached output and diagnostics are written to `out` and `err`. On a miss,
+// `key` is set up for cache_store. Files that cannot be cached, such as
+// standard input, are skipped.
+enum cache_result cache_lookup(struct cache* cache, const char* filename,
+                               struct source* source, struct cache_key* key,
+                               struct output* out, struct output* err);
+
+// Stores the dump of `source` rendered to the in-memory outputs `out` and
+// `err` after a miss.
+void cache_store(struct cache* cache, struct cache_key* key,
+                 struct source* source, const struct output* out,
+                 const struct output* err, int status);
+
+// Evicts entries if the directory has outgrown its limit, adds this run's
+// counts to the directory's and closes the cache.
+void cache_close(struct cache* cache);
@@ -0,0 +1,34 @@
+// include/compat/mach-o/arm64/reloc.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+// Bundled subset of Apple's <mach-o/arm64/reloc.h>; see loader.h.
+
+#pragma once
+
+enum reloc_type_arm64 {
+    ARM64_RELOC_UNSIGNED,
+    ARM64_RELOC_SUBTRACTOR,
+    ARM64_RELOC_BRANCH26,
+    ARM64_RELOC_PAGE21,
+    ARM64_RELOC_PAGEOFF12,
+    ARM64_RELOC_GOT_LOAD_PAGE21,
+    ARM64_RELOC_GOT_LOAD_PAGEOFF12,
+    ARM64_RELOC_POINTER_TO_GOT,
+    ARM64_RELOC_TLVP_LOAD_PAGE21,
+    ARM64_RELOC_TLVP_LOAD_PAGEOFF12,
+    ARM64_RELOC_ADDEND,
+    ARM64_RELOC_AUTHENTICATED_POINTER
+};
@@ -0,0 +1,69 @@
+// include/compat/mach-o/fixup-chains.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+// Bundled subset of Apple's <mach-o/fixup-chains.h>; see loader.h. The
+// pointer formats are bitfields in Apple's header; they are decoded with
+// shifts in src/dyld.c instead, so only the layouts of the tables are here.
+
+#pragma once
+
+#include <stdint.h>
+
+struct dyld_chained_fixups_header {
+    uint32_t fixups_version;
+    uint32_t starts_offset;
+    uint32_t imports_offset;
+    uint32_t symbols_offset;
+    uint32_t imports_count;
+    uint32_t imports_format;
+    uint32_t symbols_format;
+};
+
+struct dyld_chained_starts_in_image {
+    uint32_t seg_count;
+    uint32_t seg_info_offset[1];
+};
+
+struct dyld_chained_starts_in_segment {
+    uint32_t size;
+    uint16_t page_size;
+    uint16_t pointer_format;
+    uint64_t segment_offset;
+    uint32_t max_valid_pointer;
+    uint16_t page_count;
+    uint16_t page_start[1];
+};
+
+#define DYLD_CHAINED_PTR_START_NONE 0xFFFF
+#define DYLD_CHAINED_PTR_START_MULTI 0x8000
+#define DYLD_CHAINED_PTR_START_LAST 0x8000
+
+#define DYLD_CHAINED_PTR_ARM64E 1
+#define DYLD_CHAINED_PTR_64 2
+#define DYLD_CHAINED_PTR_32 3
+#define DYLD_CHAINED_PTR_32_CACHE 4
+#define DYLD_CHAINED_PTR_32_FIRMWARE 5
+#define DYLD_CHAINED_PTR_64_OFFSET 6
+#define DYLD_CHAINED_PTR_ARM64E_KERNEL 7
+#define DYLD_CHAINED_PTR_64_KERNEL_CACHE 8
+#define DYLD_CHAINED_PTR_ARM64E_USERLAND 9
+#define DYLD_CHAINED_PTR_ARM64E_FIRMWARE 10
+#define DYLD_CHAINED_PTR_X86_64_KERNEL_CACHE 11
+#define DYLD_CHAINED_PTR_ARM64E_USERLAND24 12
+
+#define DYLD_CHAINED_IMPORT 1
+#define DYLD_CHAINED_IMPORT_ADDEND 2
+#define DYLD_CHAINED_IMPORT_ADDEND64 3
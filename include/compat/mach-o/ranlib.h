@@ -0,0 +1,41 @@
+// include/compat/mach-o/ranlib.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+// Bundled subset of Apple's <mach-o/ranlib.h>; see loader.h.
+
+#pragma once
+
+#include <stdint.h>
+
+// Names of the archive member holding the symbol index written by ranlib(1).
+#define SYMDEF "__.SYMDEF"
+#define SYMDEF_SORTED "__.SYMDEF SORTED"
+#define SYMDEF_64 "__.SYMDEF_64"
+#define SYMDEF_64_SORTED "__.SYMDEF_64 SORTED"
+
+struct ranlib {
+    union {
+        uint32_t ran_strx;
+    } ran_un;
+    uint32_t ran_off;
+};
+
+struct ranlib_64 {
+    union {
+        unsigned long long ran_strx;
+    } ran_un;
+    unsigned long long ran_off;
+};
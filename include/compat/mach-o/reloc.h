@@ -0,0 +1,33 @@
+// include/compat/mach-o/reloc.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+// Bundled subset of Apple's <mach-o/reloc.h>; see loader.h.
+
+#pragma once
+
+#include <stdint.h>
+
+struct relocation_info {
+    int32_t r_address;
+    uint32_t r_symbolnum : 24,
+             r_pcrel : 1,
+             r_length : 2,
+             r_extern : 1,
+             r_type : 4;
+};
+
+#define R_ABS 0
+#define R_SCATTERED 0x80000000
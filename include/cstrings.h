@@ -0,0 +1,62 @@
+// include/cstrings.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Called for each string found by cstrings_scan, with its offset from the
+// start of the scanned bytes and its length without the terminator.
+// `terminated` is 0 only for trailing bytes that run off the end.
+typedef void (*cstring_visitor)(void* context, const char* string,
+                                size_t offset, size_t length,
+                                int terminated);
+
+// Splits `length` bytes into NUL-terminated strings, in order. The
+// terminators are found 64 bytes at a time with SIMD where the target has
+// it, so the cost per string is one call to `visit`.
+void cstrings_scan(const void* bytes, size_t length, cstring_visitor visit,
+                   void* context);
+
+// A set of distinct strings, each with the offset it was first seen at and
+// how many times it was added. The strings themselves are not copied.
+struct cstring_entry {
+    const char* string;
+    size_t length;
+    uint64_t offset;
+    uint64_t count;
+};
+
+struct cstring_set {
+    struct cstring_entry* entries;
+    size_t mask;
+    size_t count;
+};
+
+void cstring_set_init(struct cstring_set* set);
+void cstring_set_free(struct cstring_set* set);
+
+// Adds a string, or counts it again if it is already present. Returns its
+// entry, which is valid until the next add.
+struct cstring_entry* cstring_set_add(struct cstring_set* set,
+                                      const char* string, size_t length,
+                                      uint64_t offset);
+
+// Returns the entry for a string, or NULL if it was never added.
+const struct cstring_entry* cstring_set_find(const struct cstring_set* set,
+                                             const char* string,
+                                             size_t length);
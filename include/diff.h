@@ -0,0 +1,39 @@
+// include/diff.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+struct arena;
+struct dump_options;
+struct output;
+struct source;
+
+// Compares two Mach-O files structurally rather than line by line.
+// Load commands are matched by type and name (segment name, dylib path),
+// sections by name within their segment and symbols by name, so items that
+// merely moved are not reported. Matched items are compared field by field,
+// leaving out file offsets, which change whenever anything before them
+// does. Section and linkedit contents are compared in 64 KiB chunks by
+// hash, and only chunks whose hashes differ are compared byte by byte to
+// find the ranges that changed.
+//
+// Differences go to `out` as text or records, depending on `options`.
+// Returns 0 if the files are the same, 1 if they differ and -1 if either
+// could not be read.
+int mach_diff_sources(struct source* before, const char* before_name,
+                      struct source* after, const char* after_name,
+                      const struct dump_options* options, struct arena* arena,
+                      struct output* out, struct output* err);
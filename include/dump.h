@@ -17,5 +17,116 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
+
+struct arch;
+struct arena;
+struct output;
+struct source;
+struct stats;
+
+struct section_name {
+    char segname[17];
+    char sectname[17];
+};
+
+enum dump_format {
+    DumpText,
+    DumpJson,
+    DumpBinary
+};
+
+enum dump_strings {
+    StringsNone,
+    StringsAll,
+    StringsUnique,
+    StringsSummary
+};
+
+enum dump_hash {
+    HashNone,
+    HashFast,
+    HashSha256
+};
+
+enum dump_relocs {
+    RelocsNone,
+    RelocsAll,
+    RelocsSummary
+};
+
+struct dump_options {
+    // Human-readable text, or one of the record formats in record.h.
+    enum dump_format format;
+    // Print a per-file table of load commands ordered by the bytes they
+    // account for.
+    int summary;
+    // Dump only this architecture of a universal binary, or NULL for all.
+    const struct arch* arch;
+    // Number of threads used for the architectures of a universal binary,
+    // the members of a static library, or the regions hashed with --hash.
+    unsigned jobs;
+    // Symbol queries. When any is set, only the matching nlist_64 entries
+    // are printed instead of the full dump. With `fixups` set, `symbol` and
+    // `prefix` pick the binds and exports to list instead.
+    const char* symbol;
+    const char* prefix;
+    int find_address;
+    uint64_t address;
+    // Filters. With --header-only nothing past the Mach-O header is read.
+    // Otherwise, when commands or sections are listed, only those load
+    // commands, and segments holding those sections, are decoded.
+    int header_only;
+    const uint32_t* commands;
+    size_t command_count;
+    const struct section_name* sections;
+    size_t section_count;
+    // Print the full contents of each dumped section rather than its first
+    // and last few bytes. Only affects text output.
+    int hexdump;
+    // Instead of the full dump, list the strings in the string table and
+    // cstring sections: all of them, each distinct string once, or only a
+    // summary. With `summary` set, listings end with the summary too.
+    enum dump_strings strings;
+    // List the relocations of each dumped section with their targets, or,
+    // instead of the full dump, only count them by type and target. With
+    // `summary` set, listings end with the counts too.
+    enum dump_relocs relocs;
+    // Instead of the full dump, hash each segment, section and linkedit
+    // region with XXH64, and SHA-256 too if asked, and combine them into a
+    // semantic digest that leaves out LC_UUID, the code signature, dylib
+    // timestamps and the commands listed here.
+    enum dump_hash hash;
+    const uint32_t* hash_excludes;
+    size_t hash_exclude_count;
+    // Instead of the full dump, list every rebase, bind and export in the
+    // dyld info, chained fixups and export trie, optionally only the binds
+    // to, and re-exports from, the dylib named `dylib`.
+    int fixups;
+    const char* dylib;
+    // Dump only the static library members with these names.
+    const char* const* members;
+    size_t member_count;
+};
 
 void mach_dump(void* buffer, const size_t length);
+
+// Looks up a load command ID by its name, e.g. "LC_SYMTAB". Returns -1 if
+// the name is unknown.
+int load_command_from_name(const char* name, uint32_t* cmd);
+
+// Returns the name of a load command ID, e.g. "LC_SYMTAB", or NULL if it is
+// not one machdump knows.
+const char* load_command_name(uint32_t cmd);
+
+// Dumps `source`, a Mach-O file, universal binary or static library, to
+// `out`, reporting problems with the file to `err`.
+// `options` may be NULL for the defaults. Everything allocated for the dump
+// comes from `arena`, which the caller resets once the output is written;
+// with NULL a temporary arena is used. Parse and render times, bytes read
+// and counts are added to `stats` unless it is NULL. Returns 0 on success and
+// -1 if the file could not be dumped or was malformed.
+int mach_dump_source(struct source* source,
+                     const struct dump_options* options, struct arena* arena,
+                     struct output* out, struct output* err,
+                     struct stats* stats);
@@ -0,0 +1,128 @@
+// include/dyld.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "image.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Decoders for the data dyld uses to fix up an image when loading it: the
+// rebase and bind opcode streams and export trie of LC_DYLD_INFO, and the
+// chained fixups of LC_DYLD_CHAINED_FIXUPS. Each expands its input into a
+// flat list of entries handed to a visitor in batches, in one pass and
+// without allocating, so the work is linear in the input plus the entries
+// it expands to. Decoding stops at the first malformed byte, with the
+// entries before it already visited; the status says why and `stop` is set
+// to the offset of the problem within `bytes`.
+
+enum dyld_fixup_kind {
+    DyldRebase,
+    DyldBind,
+    DyldWeakBind,
+    DyldLazyBind
+};
+
+// What the opcodes and fixup chains know about each segment, in load
+// command order, which is how they refer to segments. Fixups outside a
+// segment's `vmsize` are malformed. `bytes` holds the segment's `filesize`
+// bytes of contents and is only needed for chained fixups.
+struct dyld_segment {
+    uint64_t vmaddr;
+    uint64_t vmsize;
+    const uint8_t* bytes;
+    uint64_t filesize;
+};
+
+struct dyld_fixup {
+    enum dyld_fixup_kind kind;
+    // REBASE_TYPE_* or BIND_TYPE_*, which have the same values.
+    uint8_t type;
+    // BIND_SYMBOL_FLAGS_*.
+    uint8_t flags;
+    // Set for arm64e pointers that are signed when fixed up.
+    uint8_t auth;
+    uint32_t segment;
+    uint64_t offset;
+    // Binds: the dylib ordinal, counting from 1, or a BIND_SPECIAL_DYLIB_*
+    // value, and the symbol, which points into the decoded bytes.
+    int64_t ordinal;
+    const char* symbol;
+    int64_t addend;
+    // Chained rebases: the target as stored, an address or an offset from
+    // the start of the image depending on the pointer format.
+    uint64_t target;
+};
+
+typedef void (*dyld_fixup_visitor)(void* context,
+                                   const struct dyld_fixup* fixups,
+                                   size_t count);
+
+// Decodes a rebase opcode stream. `pointer_size` is 8 in 64-bit images
+// and 4 in 32-bit ones.
+enum image_status dyld_rebases(const uint8_t* bytes, size_t size,
+                               const struct dyld_segment* segments,
+                               uint32_t nsegments, unsigned pointer_size,
+                               dyld_fixup_visitor visit, void* context,
+                               size_t* stop);
+
+// Decodes a bind, weak bind or lazy bind opcode stream, depending on
+// `kind`. Lazy binds are separated by BIND_OPCODE_DONE rather than ended by
+// it. The threaded binds of older arm64e images are not supported.
+enum image_status dyld_binds(enum dyld_fixup_kind kind, const uint8_t* bytes,
+                             size_t size, const struct dyld_segment* segments,
+                             uint32_t nsegments, unsigned pointer_size,
+                             dyld_fixup_visitor visit, void* context,
+                             size_t* stop);
+
+// Walks the fixup chains of every page listed in a dyld_chained_fixups
+// header, resolving binds through its imports table. The 64-bit and arm64e
+// userland pointer formats are supported.
+enum image_status dyld_chained_fixups(const uint8_t* bytes, size_t size,
+                                      const struct dyld_segment* segments,
+                                      uint32_t nsegments,
+                                      dyld_fixup_visitor visit, void* context,
+                                      size_t* stop);
+
+// The longest exported name the trie walk builds, and how deeply nested
+// the trie may be.
+#define DYLD_EXPORT_NAME_MAX 4096
+#define DYLD_EXPORT_DEPTH_MAX 128
+
+struct dyld_export {
+    // Valid only during the visit.
+    const char* name;
+    size_t length;
+    // EXPORT_SYMBOL_FLAGS_*.
+    uint64_t flags;
+    // The offset of the symbol from the start of the image, or its value
+    // for absolute symbols. Unused for re-exports.
+    uint64_t address;
+    // Re-exports: the dylib ordinal and the name in that dylib, which is
+    // empty when it is the same. Stubs with resolvers: the resolver's
+    // offset.
+    uint64_t other;
+    const char* import_name;
+};
+
+typedef void (*dyld_export_visitor)(void* context,
+                                    const struct dyld_export* entry);
+
+// Visits every terminal node of an export trie, in trie order, which is
+// sorted by name.
+enum image_status dyld_exports(const uint8_t* bytes, size_t size,
+                               dyld_export_visitor visit, void* context,
+                               size_t* stop);
@@ -0,0 +1,32 @@
+// include/hash.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// XXH64, a fast non-cryptographic hash: 32 bytes per step in four
+// independent lanes, so it runs at close to memory bandwidth. Input is
+// read little-endian, so a value is the same on every host.
+uint64_t hash64(const void* bytes, size_t length, uint64_t seed);
+
+#define SHA256_SIZE 32
+
+// SHA-256, for when a hash has to hold up against deliberate collisions.
+// It is several times slower than hash64.
+void sha256(const void* bytes, size_t length,
+            unsigned char digest[SHA256_SIZE]);
@@ -0,0 +1,30 @@
+// include/hexdump.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct output;
+
+// Writes `length` bytes as rows in the style of `hexdump -C`: an offset,
+// 16 bytes in hex in two groups of 8, and the same bytes as ASCII between
+// bars, with unprintable bytes shown as dots. Each row is preceded by `prefix`, and row offsets count up from `offset`.
+// Rows are formatted straight into the output buffer, 16 bytes at a time
+// with SIMD where the target has it.
+void hexdump(struct output* out, const char* prefix, const void* bytes,
+             size_t length, uint64_t offset);
@@ -0,0 +1,188 @@
+// include/image.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "machdump.h"
+#include <stddef.h>
+#include <stdint.h>
+
+struct arena;
+struct source;
+struct load_command;
+struct mach_header_64;
+struct nlist_64;
+struct relocation_info;
+struct section_64;
+struct image_variant;
+
+// An image is the validated form of one Mach-O file. Parsing checks every
+// size and offset in the header and load commands against the file once, so
+// the renderers can follow them without checks of their own. All of it is
+// allocated from an arena and lives until the arena is reset.
+//
+// Whatever the file's width and byte order, an image presents it in the
+// layout of a native 64-bit file: 32-bit headers, segments, sections and
+// symbols are widened to their 64-bit forms, keeping their own `cmd`, and
+// byte-swapped files are put in host order as they are parsed.
+//
+// Problems that make the file unreadable stop the parse. Anything else is
+// recorded as an error and the offending part is marked unusable, so the rest
+// of the file can still be dumped.
+enum image_status {
+    ImageOk,
+    ImageNotMachO,
+    ImageCommandsOutOfBounds,
+    ImageBadCommandSize,
+    ImageTruncatedCommand,
+    ImageBadSegmentWidth,
+    ImageTooManySections,
+    ImageSegmentOutOfBounds,
+    ImageSectionOutOfBounds,
+    ImageSymbolsOutOfBounds,
+    ImageStringsOutOfBounds,
+    ImageBadStringIndex,
+    ImageRelocationsOutOfBounds,
+    ImageIndirectSymbolsOutOfBounds,
+    ImageBadSymbolRanges,
+    ImageBadIndirectRange,
+    ImageFixupsOutOfBounds,
+    ImageTruncatedFixups,
+    ImageBadFixupOpcode,
+    ImageBadFixupSegment,
+    ImageBadFixupAddress,
+    ImageBadChainedFixups,
+    ImageBadExportTrie,
+    ImageUnsupportedFixups,
+    ImageReadFailed,
+    ImageOutOfMemory
+};
+
+// Only the first IMAGE_ERROR_MAX errors are kept; the rest are counted.
+#define IMAGE_ERROR_MAX 32
+
+struct image_error {
+    struct image_error* next;
+    enum image_status status;
+    // The index of the load command the error was found in.
+    uint32_t command;
+    // Where in the file the bad data is.
+    uint64_t offset;
+};
+
+enum image_contents {
+    ContentsInFile,
+    ContentsZeroFill,
+    ContentsOutOfBounds
+};
+
+struct image_section {
+    const struct section_64* header;
+    enum image_contents contents;
+    // The number of relocation entries, or 0 if they do not all lie within
+    // the file.
+    uint32_t nreloc;
+};
+
+struct image_symbol {
+    const struct nlist_64* nlist;
+    // NULL if n_strx is outside the string table or the string runs off
+    // its end.
+    const char* name;
+};
+
+struct image_command {
+    uint64_t offset;
+    // All `cmdsize` bytes of the command lie within the load commands.
+    const struct load_command* header;
+    // Set when `cmdsize` is too small for the command's structure, in which
+    // case only `cmd` and `cmdsize` may be read.
+    int truncated;
+    // Segments: the sections that fit within the command.
+    struct image_section* sections;
+    uint32_t nsects;
+    // LC_SYMTAB, filled in by image_symbols.
+    int symbols_parsed;
+    enum image_status symbols_status;
+    struct image_symbol* symbols;
+    uint32_t nsyms;
+    const struct nlist_64* nlist;
+    const char* strings;
+};
+
+struct image {
+    struct source* source;
+    struct arena* arena;
+    const struct mach_header_64* header;
+    // The size of the header as stored, and what kind of file it is.
+    size_t header_size;
+    int wide;
+    int swapped;
+    const struct image_variant* variant;
+    struct image_command* commands;
+    uint32_t ncmds;
+    // The first LC_SYMTAB, or NULL.
+    struct image_command* symtab;
+    struct image_error* errors;
+    struct image_error** tail;
+    size_t error_count;
+    // Set when memory ran out, leaving some of the file unread.
+    int out_of_memory;
+};
+
+// Validates the header and load commands of `source`. Returns ImageOk, or
+// the reason the file cannot be dumped at all.
+enum image_status image_parse(struct image* image, struct source* source,
+                              struct arena* arena);
+
+// Validates the symbol and string tables of an LC_SYMTAB command and resolves
+// every symbol's name. This is done on first use, since most dumps that are
+// filtered never look at the symbols. Returns ImageOk or why the tables
+// could not be read.
+enum image_status image_symbols(struct image* image,
+                                struct image_command* command);
+
+// Returns the relocation entries of a section, in host order, or NULL if
+// they could not be read or converted.
+const struct relocation_info* image_relocations(
+    struct image* image, const struct image_section* section);
+
+// Returns the indirect symbol table of an LC_DYSYMTAB command, in host
+// order, or NULL if it does not lie within the file.
+const uint32_t* image_indirect_symbols(struct image* image,
+                                       const struct image_command* command);
+
+// Returns the size of one symbol table entry as stored: an nlist_64, or an
+// nlist in 32-bit files.
+size_t image_nlist_size(const struct image* image);
+
+// Returns whether `cmd` is LC_SEGMENT_64 or, in 32-bit files, LC_SEGMENT.
+int image_is_segment(uint32_t cmd);
+
+// Records a problem found by a decoder outside of parsing, such as in the
+// dyld info, alongside the ones parsing found.
+void image_add_error(struct image* image, enum image_status status,
+                     uint32_t command, uint64_t offset);
+
+const char* image_status_message(enum image_status status);
+
+// Walks an image already parsed with image_parse for a visitor, as
+// machdump_visit does; see machdump.h. The image can be walked any number of
+// times, and the command, section and symbol indices the callbacks receive
+// index its own arrays.
+enum machdump_status machdump_visit_image(
+    struct image* image, const struct machdump_visitor* visitor,
+    void* context);
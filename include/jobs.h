@@ -0,0 +1,52 @@
+// include/jobs.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stddef.h>
+
+struct output;
+
+// Renders job `index` to `out`, with diagnostics going to `err`. Returns 0
+// on success and nonzero if the job failed.
+typedef int (*job_func)(void* context, size_t index, struct output* out,
+                        struct output* err);
+
+// Runs `count` jobs on up to `threads` workers. Each worker renders into its
+// own buffers, which are flushed to `out` and `err` in job order so that the
+// output is byte-identical to running the jobs one after another. A failing
+// job does not stop the others. Returns the number of jobs that failed.
+size_t jobs_run(size_t count, unsigned threads, job_func func, void* context,
+                struct output* out, struct output* err);
+
+// Fetches job `index` before it runs, for jobs that are not known up front.
+// Returns 0 if there is such a job and nonzero once there are no more.
+typedef int (*job_next)(void* context, size_t index);
+
+// Like jobs_run, but for jobs that arrive one at a time, such as requests
+// read from a pipe, until `next` reports that there are no more. Calls to
+// `next` are serialized and in job order. At most jobs_window(threads) jobs
+// are fetched and not yet flushed at any time, so contexts can keep what
+// `next` fetched in a ring of that many entries. `out` is flushed after each
+// job so that a reader waiting on it sees the job at once.
+size_t jobs_stream(unsigned threads, job_next next, job_func func,
+                   void* context, struct output* out, struct output* err);
+
+// Returns the most jobs jobs_stream holds at once with `threads` workers.
+size_t jobs_window(unsigned threads);
+
+// Returns the number of online processors, or 1 if it cannot be determined.
+unsigned jobs_default_threads(void);
@@ -0,0 +1,34 @@
+// include/leb.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// LEB128 decoding for the dyld opcode streams and export trie. Each function
+// reads from `p`, never past `end`, and returns the byte after what it
+// decoded, or NULL if the value runs off the end or does not fit in 64 bits.
+// Values of up to 8 bytes are decoded from one 64-bit load without a loop
+// when at least 8 bytes remain.
+const uint8_t* uleb128(const uint8_t* p, const uint8_t* end,
+                       uint64_t* value);
+const uint8_t* sleb128(const uint8_t* p, const uint8_t* end, int64_t* value);
+
+// Decodes `count` consecutive unsigned values, as the dyld opcodes that
+// take several operands store them.
+const uint8_t* uleb128_n(const uint8_t* p, const uint8_t* end,
+                         uint64_t* values, size_t count);
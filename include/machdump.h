@@ -0,0 +1,196 @@
+// include/machdump.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// libmachdump is the parsing core of machdump, built as a static and a
+// shared library for tools that would otherwise run machdump and parse its
+// text. It walks an image and calls back for each part of it, described by
+// the structures below, which are in host order and widened to 64 bits
+// whatever the file's width and byte order. They are only valid during the
+// callback that receives them. Nothing is printed and nothing exits:
+// problems in the file go to the `error` callback and the walk returns a
+// status. machdump's own renderers are one client of this walk.
+enum machdump_status {
+    MachdumpOk,
+    // A callback returned MachdumpStop.
+    MachdumpStopped,
+    // The load commands are too broken to walk, or the walk finished but
+    // left out malformed parts, each of which was passed to `error`.
+    MachdumpMalformed,
+    MachdumpNotMachO,
+    // Memory ran out, before or during the walk.
+    MachdumpOutOfMemory,
+    MachdumpReadFailed
+};
+
+// What the walk does after a callback returns. MachdumpSkip leaves out the
+// item, everything inside it and its end callback.
+enum machdump_step {
+    MachdumpContinue,
+    MachdumpSkip,
+    MachdumpStop
+};
+
+struct machdump_header {
+    // Kept as stored, so it tells the file's width and byte order.
+    uint32_t magic;
+    int32_t cputype;
+    int32_t cpusubtype;
+    uint32_t filetype;
+    uint32_t ncmds;
+    uint32_t sizeofcmds;
+    uint32_t flags;
+    // Whether the file is 64-bit, and whether its byte order is not the
+    // host's.
+    int wide;
+    int swapped;
+};
+
+struct machdump_command {
+    // The position of the command among the load commands.
+    uint32_t index;
+    uint32_t cmd;
+    uint32_t cmdsize;
+    // Where in the file the command is.
+    uint64_t offset;
+    // Set when `cmdsize` is too small for the command's structure, in which
+    // case none of its contents are visited.
+    int truncated;
+    // The command as machdump reads it, for callers that decode commands
+    // themselves with <mach-o/loader.h>: the fields machdump knows are in
+    // host order, and segments are in their 64-bit form.
+    const void* data;
+};
+
+struct machdump_segment {
+    char segname[16];
+    uint64_t vmaddr;
+    uint64_t vmsize;
+    uint64_t fileoff;
+    uint64_t filesize;
+    int32_t maxprot;
+    int32_t initprot;
+    uint32_t nsects;
+    uint32_t flags;
+};
+
+enum machdump_contents {
+    MachdumpContentsInFile,
+    MachdumpContentsZeroFill,
+    MachdumpContentsOutOfBounds
+};
+
+struct machdump_section {
+    // The position of the section within its segment.
+    uint32_t index;
+    char sectname[16];
+    char segname[16];
+    uint64_t addr;
+    uint64_t size;
+    uint32_t offset;
+    uint32_t align;
+    uint32_t reloff;
+    // The number of relocation entries, or 0 if they do not all lie within
+    // the file.
+    uint32_t nreloc;
+    uint32_t flags;
+    uint32_t reserved1;
+    uint32_t reserved2;
+    uint32_t reserved3;
+    enum machdump_contents contents;
+};
+
+// One relocation_info entry with its bit fields unpacked.
+struct machdump_relocation {
+    int32_t address;
+    // A symbol table index if `external` is set, otherwise a section
+    // ordinal, counting from 1, or R_ABS. ARM64_RELOC_ADDEND keeps its
+    // addend here instead.
+    uint32_t symbolnum;
+    uint8_t pcrel;
+    // Log2 of the size of the relocated field in bytes.
+    uint8_t length;
+    uint8_t external;
+    uint8_t type;
+};
+
+struct machdump_symbol {
+    // The position of the symbol in the symbol table.
+    uint32_t index;
+    // NULL if n_strx is outside the string table or the string runs off
+    // its end.
+    const char* name;
+    uint8_t type;
+    uint8_t sect;
+    uint16_t desc;
+    uint64_t value;
+};
+
+struct machdump_error {
+    const char* message;
+    // The index of the load command the error was found in.
+    uint32_t command;
+    // Where in the file the bad data is.
+    uint64_t offset;
+};
+
+// Any callback may be NULL. The order is the header, then for each load
+// command: `load_command`; for segments `segment`, then each section with
+// its `relocations` and `end_section`; for symbol tables each `symbol`; and
+// `end_command`. Symbols are only read if `symbol` is set, and relocations
+// only if `relocations` is, so a visitor pays for what it asks for.
+struct machdump_visitor {
+    enum machdump_step (*header)(void* context,
+                                 const struct machdump_header* header);
+    enum machdump_step (*load_command)(
+        void* context, const struct machdump_command* command);
+    enum machdump_step (*segment)(void* context,
+                                  const struct machdump_command* command,
+                                  const struct machdump_segment* segment);
+    enum machdump_step (*section)(void* context,
+                                  const struct machdump_command* command,
+                                  const struct machdump_section* section);
+    // A section's relocation entries, in file order and in batches of at
+    // most MACHDUMP_RELOCATION_BATCH.
+    enum machdump_step (*relocations)(
+        void* context, const struct machdump_section* section,
+        const struct machdump_relocation* relocs, uint32_t count);
+    enum machdump_step (*end_section)(void* context,
+                                      const struct machdump_command* command,
+                                      const struct machdump_section* section);
+    enum machdump_step (*symbol)(void* context,
+                                 const struct machdump_command* symtab,
+                                 const struct machdump_symbol* symbol);
+    enum machdump_step (*end_command)(
+        void* context, const struct machdump_command* command);
+    // Called when the walk ends, for each problem found in the file.
+    void (*error)(void* context, const struct machdump_error* error);
+};
+
+#define MACHDUMP_RELOCATION_BATCH 256
+
+// Walks the Mach-O file in `data`, which must stay valid until this
+// returns. Universal binaries and static libraries are not split here; pass
+// each slice or member on its own.
+enum machdump_status machdump_visit(const void* data, size_t size,
+                                    const struct machdump_visitor* visitor,
+                                    void* context);
+
+const char* machdump_status_message(enum machdump_status status);
@@ -0,0 +1,87 @@
+// include/output.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Format strings passed to output_printf may contain color markup:
+//
+//     {K} {R} {G} {Y} {B} {M} {C} {W}   foreground color, optionally
+//                                       followed by + for bold
+//     {+} bold    {/} italic    {_} underline    {0} reset
+//
+// Markup is resolved once per format string and cached, so a call costs a
+// table lookup plus the printf conversions themselves. With color disabled
+// the markup is simply dropped and literal-only formats are copied straight
+// into the buffer.
+
+#define OUTPUT_CACHE_SIZE 64
+
+struct output_format;
+
+// An output is either a buffered writer to a file descriptor, which writes
+// in large blocks, or a growable in-memory buffer.
+struct output {
+    int fd;
+    int color;
+    int failed;
+    char* data;
+    size_t length;
+    size_t capacity;
+    // Bytes written to the file descriptor so far and the time spent
+    // writing them, in nanoseconds, for --stats.
+    uint64_t flushed;
+    uint64_t write_ns;
+    const struct output_format* cache[OUTPUT_CACHE_SIZE];
+};
+
+void output_open(struct output* output, int fd, int color);
+void output_open_memory(struct output* output, int color);
+
+// Returns whether color should be used for `fd` by default, i.e. whether it
+// is a terminal and NO_COLOR is unset.
+int output_default_color(int fd);
+
+void output_printf(struct output* output, const char* format, ...);
+void output_vprintf(struct output* output, const char* format, va_list args);
+void output_write(struct output* output, const void* bytes, size_t length);
+void output_char(struct output* output, char c);
+
+// Returns `format`, which must not contain conversions, with its markup
+// resolved for `output`, and sets `length` to its length. For callers that
+// write the same text many times without going through printf.
+const char* output_markup(struct output* output, const char* format,
+                          size_t* length);
+
+// Appends `length` uninitialized bytes and returns a pointer to them, for
+// callers that format directly into the buffer. The pointer is only valid
+// until the next call on `output`.
+char* output_claim(struct output* output, size_t length);
+
+// Writes buffered bytes to the file descriptor; a no-op for memory outputs.
+// Returns -1 if any write has failed.
+int output_flush(struct output* output);
+
+// Returns the number of bytes written to `output`, flushed or not.
+uint64_t output_emitted(const struct output* output);
+
+// Empties a memory output without releasing its buffer.
+void output_reset(struct output* output);
+
+void output_close(struct output* output);
@@ -0,0 +1,69 @@
+// include/record.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct output;
+
+// Machine-readable output is a stream of flat records, one per header, load
+// command, segment, section, symbol and so on. Each record has a type and a
+// list of named integer or string fields, and is written to the output as
+// soon as it is complete, so memory use does not grow with the file.
+//
+// RecordJson writes one JSON object per line, with the type under "type".
+// Integers are exact; strings are escaped, with bytes outside printable
+// ASCII written as \u00XX.
+//
+// RecordBinary writes length-prefixed records, all integers little-endian:
+//
+//     u32 length of the rest of the record
+//     u8  type length, type bytes
+//     then per field:
+//         u8 key length, key bytes
+//         u8 tag: 0 = u64, 1 = i64, 2 = string
+//         u64 / i64 value, or u32 length and string bytes
+enum record_format {
+    RecordJson,
+    RecordBinary
+};
+
+struct record_writer {
+    struct output* out;
+    enum record_format format;
+    char* data;
+    size_t length;
+    size_t capacity;
+};
+
+void record_writer_init(struct record_writer* writer, struct output* out,
+                        enum record_format format);
+void record_writer_free(struct record_writer* writer);
+
+void record_begin(struct record_writer* writer, const char* type);
+void record_uint(struct record_writer* writer, const char* key,
+                 uint64_t value);
+void record_int(struct record_writer* writer, const char* key,
+                int64_t value);
+void record_string(struct record_writer* writer, const char* key,
+                   const char* value);
+// Like record_string, but stops after `max` bytes, for fixed-size name
+// fields such as segname that need not be terminated.
+void record_string_n(struct record_writer* writer, const char* key,
+                     const char* value, size_t max);
+void record_end(struct record_writer* writer);
@@ -0,0 +1,33 @@
+// include/relocs.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "machdump.h"
+#include <stdint.h>
+
+// Unpacks `count` consecutive relocation_info entries from `bytes`. The
+// fields are taken from the two words of each entry with shifts and masks,
+// so the result does not depend on how the compiler lays out bit fields.
+void relocs_decode(const void* bytes, uint32_t count,
+                   struct machdump_relocation* relocs);
+
+// Returns the name of a relocation type for an architecture, e.g.
+// "X86_64_RELOC_BRANCH", or NULL if it is not known.
+const char* reloc_type_name(int32_t cputype, uint32_t type);
+
+// Whether `symbolnum` holds an addend rather than naming a target.
+int reloc_is_addend(int32_t cputype, uint32_t type);
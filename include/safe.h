@@ -20,21 +20,17 @@
 #include <stdlib.h>
 
 enum failure {
-    VirtualMemoryExhausted,
-    FailedToOpenFile,
-    FailedToReadFile,
-    FailedToCloseFile
+    VirtualMemoryExhausted
 };
 
+// Without a handler, running out of memory prints a message and exits.
+// Library code that must not exit allocates through arena_try_alloc and
+// reports ImageOutOfMemory instead.
 void set_failure_handler(void (*handler)(enum failure));
 
+// Calls the failure handler, or exits if there is none. Returns NULL if the
+// handler returns.
+void* memory_exhausted(void);
+
 void* xmalloc(size_t n);
 #define xfree free
-
-FILE* xfopen(const char* filename, const char* mode);
-unsigned long xfread(void* buffer, size_t size, size_t count, FILE* stream);
-int xfclose(FILE* file);
-
-#define xfseek fseek
-#define xftell ftell
-#define xrewind rewind
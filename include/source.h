@@ -0,0 +1,70 @@
+// include/source.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A source is a read-only view of a file's bytes. Regular files are memory
+// mapped so that only the pages the decoders touch are ever faulted in. When
+// a file cannot be mapped, the byte ranges asked for are fetched with
+// positioned reads instead, and streams that cannot be positioned at all
+// (pipes, stdin) are read into memory.
+enum source_kind {
+    SourceMemory,
+    SourceMapped,
+    SourcePositioned
+};
+
+struct source_region;
+
+struct source {
+    enum source_kind kind;
+    int fd;
+    const char* data;
+    size_t length;
+    int owns_data;
+    struct source_region* regions;
+    pthread_mutex_t lock;
+    struct source* parent;
+    size_t base;
+    // Bytes handed out by source_read, for --stats.
+    uint64_t bytes_read;
+};
+
+// Opens `filename` (or stdin for "-"). Returns 0 on success and -1 with
+// errno set on failure.
+int source_open(struct source* source, const char* filename);
+
+// Wraps an in-memory buffer, which must outlive the source.
+void source_from_memory(struct source* source, const void* buffer,
+                        size_t length);
+
+// Makes `slice` a view of `size` bytes of `parent` starting at `offset`,
+// without copying or reading them. Returns -1 if the range lies outside
+// `parent`. The slice must not outlive its parent.
+int source_slice(struct source* slice, struct source* parent, size_t offset,
+                 size_t size);
+
+// Returns a pointer to `size` bytes at `offset`, or NULL if the range lies
+// outside the source or could not be read. The pointer stays valid until the
+// source is closed. Sources and their slices may be read from several
+// threads at once.
+const void* source_read(struct source* source, size_t offset, size_t size);
+
+void source_close(struct source* source);
@@ -0,0 +1,76 @@
+// include/stats.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct output;
+
+// Where the time went while dumping, for --stats. Times are in nanoseconds:
+//
+//     load     opening and mapping (or reading) the file
+//     parse    validating the header, load commands and symbol tables
+//     render   formatting into the output buffer
+//     write    writing the buffer out
+//
+// Writes happen whenever the buffer fills, so a file is charged for the
+// writes made while it was being dumped; with -j, output is written after
+// rendering and only shows up in the total.
+//
+// Load commands are tallied by type in `by_command`, indexed by the same slot
+// as dump.c's decoder table, so the slowest types can be listed.
+#define STATS_COMMAND_SLOTS 0x100
+#define STATS_SLOWEST 5
+
+struct stats_command {
+    uint32_t cmd;
+    uint32_t count;
+    uint64_t ns;
+};
+
+struct stats {
+    uint64_t files;
+    uint64_t load_ns;
+    uint64_t parse_ns;
+    uint64_t render_ns;
+    uint64_t write_ns;
+    uint64_t bytes_read;
+    uint64_t bytes_emitted;
+    uint64_t commands;
+    uint64_t sections;
+    uint64_t symbols;
+    // With --cache, the files found in the cache and those dumped into it.
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    struct stats_command by_command[STATS_COMMAND_SLOTS];
+};
+
+enum stats_format {
+    StatsNone,
+    StatsText,
+    StatsJson
+};
+
+// Returns a monotonic time in nanoseconds.
+uint64_t stats_now(void);
+
+void stats_merge(struct stats* into, const struct stats* from);
+
+// Prints `stats` for `name` (a file name, or a description of the total).
+void stats_print(struct output* out, enum stats_format format,
+                 const char* name, const struct stats* stats);
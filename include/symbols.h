@@ -0,0 +1,73 @@
+// include/symbols.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct nlist_64;
+
+#define SYMBOL_NONE UINT32_MAX
+
+struct symbol_name_entry {
+    const char* name;
+    uint32_t index;
+};
+
+struct symbol_address_entry {
+    uint64_t value;
+    uint32_t index;
+};
+
+// An index over a symbol table, built in one pass over the nlist_64 array
+// and string table. Names are hashed for exact lookups and sorted for prefix
+// lookups; symbols defined in a section are sorted by address.
+struct symbol_index {
+    const struct nlist_64* symbols;
+    uint32_t count;
+    const char* strings;
+    uint32_t strsize;
+    uint32_t* buckets;
+    size_t mask;
+    struct symbol_name_entry* by_name;
+    struct symbol_address_entry* by_address;
+    uint32_t address_count;
+};
+
+void symbol_index_build(struct symbol_index* index,
+                        const struct nlist_64* symbols, uint32_t count,
+                        const char* strings, uint32_t strsize);
+void symbol_index_free(struct symbol_index* index);
+
+// Returns the name of symbol `i`, or "" if its string table offset is out of
+// bounds or the string is not terminated within the table.
+const char* symbol_index_name(const struct symbol_index* index, uint32_t i);
+
+// Returns the next symbol named `name`, or SYMBOL_NONE when there are no
+// more. `cursor` must start at 0.
+uint32_t symbol_index_find(const struct symbol_index* index,
+                           const char* name, size_t* cursor);
+
+// Returns how many names start with `prefix` and sets `first` to the
+// position of the first one in `by_name`.
+size_t symbol_index_prefix(const struct symbol_index* index,
+                           const char* prefix, size_t* first);
+
+// Returns the defined symbol with the greatest address not above `address`,
+// or SYMBOL_NONE.
+uint32_t symbol_index_containing(const struct symbol_index* index,
+                                 uint64_t address);
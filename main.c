@@ -14,33 +14,358 @@
 // You should have received a copy of the GNU General Public License
 // along with machdump. If not, see <https://www.gnu.org/licenses/>.
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include "include/arch.h"
+#include "include/arena.h"
+#include "include/cache.h"
+#include "include/diff.h"
 #include "include/dump.h"
+#include "include/jobs.h"
+#include "include/output.h"
+#include "include/record.h"
 #include "include/safe.h"
+#include "include/source.h"
+#include "include/stats.h"
 
-void driver(const char* filename) {
-    FILE* file = xfopen(filename, "r");
-    xfseek(file, 0, SEEK_END);
-    const size_t length = xftell(file);
-    xrewind(file);
-    
-    void* buffer = xmalloc(length);
-    xfread(buffer, sizeof(char), length, file);
-    
-    xfclose(file);
-    
-    mach_dump(buffer, length);
-    
-    xfree(buffer);
+// Dumps `source` through `cache`: on a miss the dump is rendered into
+// memory, stored and then copied out.
+static int cached_dump(struct cache* cache, const char* filename,
+                       struct source* source,
+                       const struct dump_options* options,
+                       struct arena* arena, struct output* out,
+                       struct output* err, struct stats* stats) {
+    struct cache_key key;
+    switch (cache_lookup(cache, filename, source, &key, out, err)) {
+        case CacheHit:
+            if (stats) {
+                stats->cache_hits = 1;
+            }
+            return key.status;
+        case CacheSkip:
+            return mach_dump_source(source, options, arena, out, err, stats);
+        case CacheMiss:
+            break;
+    }
+    if (stats) {
+        stats->cache_misses = 1;
+    }
+    struct output rendered, diagnostics;
+    output_open_memory(&rendered, out->color);
+    output_open_memory(&diagnostics, err->color);
+    const int status = mach_dump_source(source, options, arena, &rendered,
+                                        &diagnostics, stats);
+    cache_store(cache, &key, source, &rendered, &diagnostics, status);
+    output_write(out, rendered.data, rendered.length);
+    output_write(err, diagnostics.data, diagnostics.length);
+    output_close(&rendered);
+    output_close(&diagnostics);
+    return status;
+}
+
+int driver(const char* filename, const struct dump_options* options,
+           struct cache* cache, struct arena* arena, struct output* out,
+           struct output* err, struct stats* stats) {
+    const uint64_t start = stats ? stats_now() : 0;
+    const uint64_t emitted = output_emitted(out);
+    const uint64_t write_ns = out->write_ns;
+    struct source source;
+    const int opened = source_open(&source, filename);
+    if (stats) {
+        stats->files = 1;
+        stats->load_ns = stats_now() - start;
+    }
+    if (opened != 0) {
+        output_printf(err, "machdump: {R+}error:{0} %s: %s\n", filename,
+                      strerror(errno));
+        return -1;
+    }
+
+    if (options->format != DumpText) {
+        struct record_writer records;
+        record_writer_init(&records, out, options->format == DumpJson
+                                          ? RecordJson : RecordBinary);
+        record_begin(&records, "file");
+        record_string(&records, "path", filename);
+        record_uint(&records, "size", source.length);
+        record_end(&records);
+        record_writer_free(&records);
+    }
+
+    const int status = cache
+        ? cached_dump(cache, filename, &source, options, arena, out, err,
+                      stats)
+        : mach_dump_source(&source, options, arena, out, err, stats);
+
+    source_close(&source);
+    arena_reset(arena);
+    if (stats) {
+        stats->write_ns = out->write_ns - write_ns;
+        stats->bytes_emitted = output_emitted(out) - emitted;
+    }
+    return status;
+}
+
+// Each worker takes an arena from `idle` for the file it is dumping and puts
+// it back afterwards, so there is one arena per worker no matter how many
+// files there are.
+struct run {
+    const char** filenames;
+    struct dump_options options;
+    pthread_mutex_t lock;
+    struct arena* arenas;
+    struct arena** idle;
+    size_t idle_count;
+    // With --stats, each file's stats are printed after it and added to
+    // `total` under `lock`.
+    enum stats_format stats;
+    struct stats total;
+    // With --cache, the cache that dumps go through, or NULL.
+    struct cache* cache;
+    // With --batch, the filenames read from standard input, ending with
+    // `delimiter`, go into a ring of `window` reused buffers.
+    char delimiter;
+    size_t window;
+    char** paths;
+    size_t* capacities;
+};
+
+static int run_file(struct run* run, const char* filename,
+                    struct output* out, struct output* err) {
+    pthread_mutex_lock(&run->lock);
+    struct arena* arena = run->idle[--run->idle_count];
+    pthread_mutex_unlock(&run->lock);
+
+    struct stats* stats = NULL;
+    if (run->stats != StatsNone) {
+        stats = xmalloc(sizeof(*stats));
+        memset(stats, 0, sizeof(*stats));
+    }
+    const int status = driver(filename, &run->options, run->cache, arena,
+                              out, err, stats);
+    if (stats) {
+        stats_print(err, run->stats, filename, stats);
+    }
+
+    pthread_mutex_lock(&run->lock);
+    run->idle[run->idle_count++] = arena;
+    if (stats) {
+        stats_merge(&run->total, stats);
+    }
+    pthread_mutex_unlock(&run->lock);
+    xfree(stats);
+    return status;
+}
+
+static int driver_job(void* context, size_t index, struct output* out,
+                      struct output* err) {
+    struct run* run = context;
+    return run_file(run, run->filenames[index], out, err);
+}
+
+static int batch_next(void* context, size_t index) {
+    struct run* run = context;
+    char** path = &run->paths[index % run->window];
+    size_t* capacity = &run->capacities[index % run->window];
+    ssize_t length;
+    do {
+        length = getdelim(path, capacity, run->delimiter, stdin);
+        if (length < 0) {
+            return -1;
+        }
+        if ((*path)[length - 1] == run->delimiter) {
+            (*path)[--length] = '\0';
+        }
+    } while (length == 0);
+    return 0;
+}
+
+// Each file dumped with --batch is followed by a frame with its status, 0
+// or 1: a "result" record, or in text a line of ASCII RS, the status and
+// the filename, ended with the same delimiter as the filenames read.
+static int batch_job(void* context, size_t index, struct output* out,
+                     struct output* err) {
+    struct run* run = context;
+    const char* filename = run->paths[index % run->window];
+    int status;
+    if (strcmp(filename, "-") == 0) {
+        output_printf(err, "machdump: {R+}error:{0} -: standard input holds "
+                      "the filenames with --batch\n");
+        status = -1;
+    } else {
+        status = run_file(run, filename, out, err);
+    }
+    if (run->options.format != DumpText) {
+        struct record_writer records;
+        record_writer_init(&records, out, run->options.format == DumpJson
+                                          ? RecordJson : RecordBinary);
+        record_begin(&records, "result");
+        record_string(&records, "path", filename);
+        record_uint(&records, "status", status != 0);
+        record_end(&records);
+        record_writer_free(&records);
+    } else {
+        output_printf(out, "\036%d ", status != 0);
+        output_write(out, filename, strlen(filename));
+        output_char(out, run->delimiter);
+    }
+    return status;
+}
+
+// Compares two files like cmp(1): returns 0 if they are the same, 1 if
+// they differ and 2 if either could not be read.
+static int differ(const char* filenames[2], const struct dump_options* options,
+                  struct arena* arena, struct output* out,
+                  struct output* err) {
+    struct source sources[2];
+    int opened = 0;
+    for (; opened < 2; opened++) {
+        if (source_open(&sources[opened], filenames[opened]) != 0) {
+            output_printf(err, "machdump: {R+}error:{0} %s: %s\n",
+                          filenames[opened], strerror(errno));
+            break;
+        }
+    }
+    int status = -1;
+    if (opened == 2) {
+        status = mach_diff_sources(&sources[0], filenames[0], &sources[1],
+                                   filenames[1], options, arena, out, err);
+    }
+    while (opened > 0) {
+        source_close(&sources[--opened]);
+    }
+    arena_reset(arena);
+    return status < 0 ? 2 : status;
 }
 
 static void print_help(const char* argv[]) {
     printf("Usage: %s [--help|--version]\n"
-           "   or: %s [FILE...]\n"
+           "   or: %s [OPTION...] [FILE...]\n"
+           "\n"
+           "Verbatim dumps 32-bit and 64-bit Mach-O object files of either "
+           "byte\n"
+           "order, universal binaries and static libraries for low-level "
+           "debugging.\n"
+           "With FILE of -, reads standard input.\n"
            "\n"
-           "Verbatim dumps 64-bit Mach-O object files for low-level "
-           "debugging.\n",
+           "  -j N    dump up to N files in parallel (0 for one per CPU); "
+           "output\n"
+           "          is kept in command-line order. With fewer files, "
+           "the\n"
+           "          architectures of universal binaries and the members "
+           "of\n"
+           "          static libraries are dumped in parallel instead\n"
+           "  --color, --no-color\n"
+           "          force colored output on or off (default: on for "
+           "terminals\n"
+           "          unless NO_COLOR is set)\n"
+           "  --format text|json|binary\n"
+           "          print text for people, JSON Lines, or length-prefixed "
+           "binary\n"
+           "          records (see include/record.h)\n"
+           "  --arch ARCH\n"
+           "          dump only the ARCH slice (e.g. x86_64, arm64) of "
+           "universal\n"
+           "          binaries\n"
+           "  --symbol NAME, --prefix PREFIX, --addr ADDRESS\n"
+           "          print only the symbols named NAME, starting with "
+           "PREFIX, or\n"
+           "          containing ADDRESS, using an index over the symbol "
+           "table\n"
+           "  --header-only\n"
+           "          print only the Mach-O header\n"
+           "  --cmd LC_NAME\n"
+           "          dump only load commands of this type; may be "
+           "repeated\n"
+           "  --section SEGMENT,SECTION\n"
+           "          dump only this section and its segment; may be "
+           "repeated\n"
+           "  --strings, --strings=unique, --strings=summary\n"
+           "          list the strings in the string table and cstring "
+           "sections\n"
+           "          with their file offsets, each distinct string once "
+           "with its\n"
+           "          count, or only totals, duplicates and the longest "
+           "strings\n"
+           "  --relocs, --relocs=summary\n"
+           "          list the relocations of each section dumped with "
+           "their types\n"
+           "          and targets, or only count them by type and "
+           "target\n"
+           "  --fixups\n"
+           "          list each rebase, bind and export in the dyld info, "
+           "chained\n"
+           "          fixups and export trie; --symbol and --prefix pick "
+           "binds and\n"
+           "          exports by name instead of querying the symbol "
+           "table\n"
+           "  --dylib NAME\n"
+           "          with --fixups, list only binds to and re-exports "
+           "from the\n"
+           "          dylib with this install name or file name\n"
+           "  --member NAME\n"
+           "          dump only this member of static libraries; may be "
+           "repeated\n"
+           "  --hexdump\n"
+           "          print the full contents of each section dumped; "
+           "combine\n"
+           "          with --section to choose which\n"
+           "  --summary\n"
+           "          after each file, list its load commands by the bytes "
+           "they\n"
+           "          account for; with --strings or --relocs, "
+           "summarize those too\n"
+           "  --hash, --hash=sha256\n"
+           "          print an XXH64 hash, and a SHA-256 one if asked, of "
+           "the load\n"
+           "          commands and of each segment, section and linkedit "
+           "region, and\n"
+           "          a digest of them all that leaves out LC_UUID, the "
+           "code\n"
+           "          signature and dylib timestamps; narrowed by --cmd "
+           "and --section\n"
+           "  --hash-exclude LC_NAME\n"
+           "          also leave this load command type out of the hashes; "
+           "may be\n"
+           "          repeated\n"
+           "  --diff  compare two files by structure instead of dumping "
+           "them:\n"
+           "          load commands, sections and symbols are matched by "
+           "name and\n"
+           "          compared field by field; exits 1 if they differ\n"
+           "  --batch, --batch=nul\n"
+           "          read the files to dump from standard input, one per "
+           "line or\n"
+           "          NUL-terminated, until it ends, and follow each with a "
+           "frame\n"
+           "          holding its status: a result record, or in text a "
+           "line of\n"
+           "          ASCII RS, the status and the filename\n"
+           "  --cache DIR\n"
+           "          keep the output for each file in DIR and reuse it "
+           "while the\n"
+           "          file and options are unchanged; hit and miss counts "
+           "are kept\n"
+           "          in DIR/counters\n"
+           "  --cache-size SIZE\n"
+           "          evict the least recently used entries once DIR "
+           "holds more\n"
+           "          than SIZE bytes, with an optional K, M or G suffix "
+           "(default:\n"
+           "          1G)\n"
+           "  --stats, --stats=json\n"
+           "          print time spent loading, parsing, rendering and "
+           "writing,\n"
+           "          with byte and command counts, for each file and in "
+           "total to\n"
+           "          standard error, as text or JSON Lines\n",
            argv[0], argv[0]);
 }
 
@@ -53,20 +378,379 @@ static void print_version(void) {
            "There is NO WARRANTY, to the extent permitted by law.\n");
 }
 
+static int parse_command(const char* text, uint32_t* cmd) {
+    char* end;
+    if (load_command_from_name(text, cmd) == 0) {
+        return 0;
+    }
+    const unsigned long value = strtoul(text, &end, 0);
+    if (*text == '\0' || *end != '\0' || value > UINT32_MAX) {
+        return -1;
+    }
+    *cmd = (uint32_t)value;
+    return 0;
+}
+
+static int parse_section(const char* text, struct section_name* section) {
+    const char* comma = strchr(text, ',');
+    if (!comma || comma - text > 16 || strlen(comma + 1) > 16) {
+        return -1;
+    }
+    memset(section, 0, sizeof(*section));
+    memcpy(section->segname, text, (size_t)(comma - text));
+    strcpy(section->sectname, comma + 1);
+    return 0;
+}
+
+static int parse_jobs(const char* text, unsigned* jobs) {
+    char* end;
+    const unsigned long value = strtoul(text, &end, 10);
+    if (*text == '\0' || *end != '\0' || value > 1024) {
+        return -1;
+    }
+    *jobs = value == 0 ? jobs_default_threads() : (unsigned)value;
+    return 0;
+}
+
+// Parses a size in bytes, optionally followed by K, M or G.
+static int parse_size(const char* text, uint64_t* size) {
+    char* end;
+    const unsigned long long value = strtoull(text, &end, 10);
+    const char* units = "KMG";
+    const char* unit = *end ? strchr(units, *end) : NULL;
+    const unsigned shift = unit ? 10 * (unsigned)(unit - units + 1) : 0;
+    if (unit) {
+        end++;
+    }
+    if (*text < '0' || *text > '9' || *end != '\0'
+        || value > UINT64_MAX >> shift) {
+        return -1;
+    }
+    *size = (uint64_t)value << shift;
+    return 0;
+}
+
+// --fixups, the symbol queries, --strings, --hash and --relocs=summary each
+// print something in place of the dump, so at most one may be given. Sets
+// `first` and `second` to two that were given together and returns -1 if
+// so.
+static int check_modes(const struct dump_options* options,
+                       const char** first, const char** second) {
+    const char* modes[6];
+    size_t count = 0;
+    if (options->fixups) {
+        modes[count++] = "--fixups";
+        // --symbol and --prefix pick fixups, but nothing handles --addr.
+        if (options->find_address) {
+            modes[count++] = "--addr";
+        }
+    } else if (options->symbol) {
+        modes[count++] = "--symbol";
+    } else if (options->prefix) {
+        modes[count++] = "--prefix";
+    } else if (options->find_address) {
+        modes[count++] = "--addr";
+    }
+    if (options->strings != StringsNone) {
+        modes[count++] = "--strings";
+    }
+    if (options->hash != HashNone) {
+        modes[count++] = "--hash";
+    }
+    if (options->relocs == RelocsSummary) {
+        modes[count++] = "--relocs=summary";
+    }
+    if (count > 1) {
+        *first = modes[0];
+        *second = modes[1];
+        return -1;
+    }
+    return 0;
+}
+
 int main(int argc, const char* argv[]) {
     if (argc == 1) {
         print_help(argv);
-    } else if (argc == 2) {
-        if (strncmp(argv[1], "--help", 7) == 0) {
+        return 0;
+    }
+
+    struct run run;
+    memset(&run, 0, sizeof(run));
+    unsigned jobs = 1;
+    int jobs_given = 0;
+    int color = output_default_color(STDOUT_FILENO);
+    int err_color = output_default_color(STDERR_FILENO);
+    const char** filenames = xmalloc(sizeof(*filenames) * argc);
+    uint32_t* commands = xmalloc(sizeof(*commands) * argc);
+    struct section_name* sections = xmalloc(sizeof(*sections) * argc);
+    const char** members = xmalloc(sizeof(*members) * argc);
+    uint32_t* excludes = xmalloc(sizeof(*excludes) * argc);
+    run.filenames = filenames;
+    run.options.commands = commands;
+    run.options.sections = sections;
+    run.options.members = members;
+    run.options.hash_excludes = excludes;
+    size_t count = 0;
+    int options = 1;
+    int diff = 0;
+    int batch = 0;
+    const char* cache_dir = NULL;
+    uint64_t cache_size = CACHE_DEFAULT_SIZE;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (!options || arg[0] != '-' || arg[1] == '\0') {
+            filenames[count++] = arg;
+        } else if (strcmp(arg, "--") == 0) {
+            options = 0;
+        } else if (strcmp(arg, "--help") == 0) {
             print_help(argv);
-        } else if (strncmp(argv[1], "--version", 10) == 0) {
+            return 0;
+        } else if (strcmp(arg, "--version") == 0) {
             print_version();
+            return 0;
+        } else if (strcmp(arg, "--color") == 0) {
+            color = err_color = 1;
+        } else if (strcmp(arg, "--no-color") == 0) {
+            color = err_color = 0;
+        } else if (strcmp(arg, "--format") == 0) {
+            const char* value = argv[++i];
+            if (value && strcmp(value, "text") == 0) {
+                run.options.format = DumpText;
+            } else if (value && strcmp(value, "json") == 0) {
+                run.options.format = DumpJson;
+            } else if (value && strcmp(value, "binary") == 0) {
+                run.options.format = DumpBinary;
+            } else {
+                fprintf(stderr, "machdump: error: --format expects text, "
+                        "json or binary\n");
+                return 1;
+            }
+        } else if (strcmp(arg, "--arch") == 0) {
+            const char* name = argv[++i];
+            if (!name || !(run.options.arch = arch_from_name(name))) {
+                fprintf(stderr, "machdump: error: unknown architecture "
+                        "'%s'\n", name ? name : "");
+                return 1;
+            }
+        } else if (strcmp(arg, "--symbol") == 0) {
+            if (!(run.options.symbol = argv[++i])) {
+                fprintf(stderr, "machdump: error: --symbol expects a "
+                        "name\n");
+                return 1;
+            }
+        } else if (strcmp(arg, "--prefix") == 0) {
+            if (!(run.options.prefix = argv[++i])) {
+                fprintf(stderr, "machdump: error: --prefix expects a "
+                        "prefix\n");
+                return 1;
+            }
+        } else if (strcmp(arg, "--addr") == 0) {
+            const char* value = argv[++i];
+            char* end = NULL;
+            if (value) {
+                run.options.address = strtoull(value, &end, 0);
+            }
+            if (!value || *value == '\0' || *end != '\0') {
+                fprintf(stderr, "machdump: error: --addr expects an "
+                        "address\n");
+                return 1;
+            }
+            run.options.find_address = 1;
+        } else if (strcmp(arg, "--header-only") == 0) {
+            run.options.header_only = 1;
+        } else if (strcmp(arg, "--cmd") == 0) {
+            const char* value = argv[++i];
+            if (!value || parse_command(value,
+                                        &commands[run.options.command_count])
+                          != 0) {
+                fprintf(stderr, "machdump: error: unknown load command "
+                        "'%s'\n", value ? value : "");
+                return 1;
+            }
+            run.options.command_count++;
+        } else if (strcmp(arg, "--section") == 0) {
+            const char* value = argv[++i];
+            if (!value || parse_section(value,
+                                        &sections[run.options.section_count])
+                          != 0) {
+                fprintf(stderr, "machdump: error: --section expects "
+                        "SEGMENT,SECTION\n");
+                return 1;
+            }
+            run.options.section_count++;
+        } else if (strcmp(arg, "--strings") == 0) {
+            run.options.strings = StringsAll;
+        } else if (strcmp(arg, "--strings=unique") == 0) {
+            run.options.strings = StringsUnique;
+        } else if (strcmp(arg, "--strings=summary") == 0) {
+            run.options.strings = StringsSummary;
+        } else if (strcmp(arg, "--relocs") == 0) {
+            run.options.relocs = RelocsAll;
+        } else if (strcmp(arg, "--relocs=summary") == 0) {
+            run.options.relocs = RelocsSummary;
+        } else if (strcmp(arg, "--fixups") == 0) {
+            run.options.fixups = 1;
+        } else if (strcmp(arg, "--dylib") == 0) {
+            if (!(run.options.dylib = argv[++i])) {
+                fprintf(stderr, "machdump: error: --dylib expects a "
+                        "name\n");
+                return 1;
+            }
+        } else if (strcmp(arg, "--member") == 0) {
+            if (!(members[run.options.member_count] = argv[++i])) {
+                fprintf(stderr, "machdump: error: --member expects a "
+                        "name\n");
+                return 1;
+            }
+            run.options.member_count++;
+        } else if (strcmp(arg, "--hexdump") == 0) {
+            run.options.hexdump = 1;
+        } else if (strcmp(arg, "--summary") == 0) {
+            run.options.summary = 1;
+        } else if (strcmp(arg, "--hash") == 0) {
+            run.options.hash = HashFast;
+        } else if (strcmp(arg, "--hash=sha256") == 0) {
+            run.options.hash = HashSha256;
+        } else if (strcmp(arg, "--hash-exclude") == 0) {
+            const char* value = argv[++i];
+            uint32_t* excluded = &excludes[run.options.hash_exclude_count];
+            if (!value || parse_command(value, excluded) != 0) {
+                fprintf(stderr, "machdump: error: unknown load command "
+                        "'%s'\n", value ? value : "");
+                return 1;
+            }
+            run.options.hash_exclude_count++;
+        } else if (strcmp(arg, "--diff") == 0) {
+            diff = 1;
+        } else if (strcmp(arg, "--batch") == 0) {
+            batch = 1;
+            run.delimiter = '\n';
+        } else if (strcmp(arg, "--batch=nul") == 0) {
+            batch = 1;
+            run.delimiter = '\0';
+        } else if (strcmp(arg, "--cache") == 0) {
+            if (!(cache_dir = argv[++i])) {
+                fprintf(stderr, "machdump: error: --cache expects a "
+                        "directory\n");
+                return 1;
+            }
+        } else if (strcmp(arg, "--cache-size") == 0) {
+            const char* value = argv[++i];
+            if (!value || parse_size(value, &cache_size) != 0) {
+                fprintf(stderr, "machdump: error: --cache-size expects a "
+                        "size such as 512M\n");
+                return 1;
+            }
+        } else if (strcmp(arg, "--stats") == 0) {
+            run.stats = StatsText;
+        } else if (strcmp(arg, "--stats=json") == 0) {
+            run.stats = StatsJson;
+        } else if (strncmp(arg, "-j", 2) == 0) {
+            const char* value = arg[2] ? arg + 2 : argv[++i];
+            if (!value || parse_jobs(value, &jobs) != 0) {
+                fprintf(stderr, "machdump: error: -j expects a number of "
+                        "jobs\n");
+                return 1;
+            }
+            jobs_given = 1;
         } else {
-            driver(argv[1]);
+            fprintf(stderr, "machdump: error: unknown option '%s'\n", arg);
+            return 1;
         }
-    } else {
-        for (int i = 1; i < argc; i++) {
-            driver(argv[i]);
+    }
+
+    if (diff && count != 2) {
+        fprintf(stderr, "machdump: error: --diff expects two files\n");
+        return 2;
+    }
+    const char* first;
+    const char* second;
+    if (check_modes(&run.options, &first, &second) != 0) {
+        fprintf(stderr, "machdump: error: %s cannot be combined with %s\n",
+                first, second);
+        return 1;
+    }
+    if (batch && (diff || count > 0)) {
+        fprintf(stderr, "machdump: error: --batch reads the files from "
+                "standard input\n");
+        return 1;
+    }
+
+    // Hashing is worth spreading over every CPU unless told otherwise.
+    if (run.options.hash != HashNone && !jobs_given) {
+        jobs = jobs_default_threads();
+    }
+
+    // Spare workers go to the architectures of universal binaries. With
+    // --batch there is always another file for them.
+    run.options.jobs = count < jobs && !batch ? jobs : 1;
+
+    pthread_mutex_init(&run.lock, NULL);
+    run.arenas = xmalloc(sizeof(*run.arenas) * jobs);
+    run.idle = xmalloc(sizeof(*run.idle) * jobs);
+    for (unsigned i = 0; i < jobs; i++) {
+        arena_init(&run.arenas[i]);
+        run.idle[run.idle_count++] = &run.arenas[i];
+    }
+
+    struct cache cache;
+    if (cache_dir && !diff) {
+        if (cache_open(&cache, cache_dir, cache_size, &run.options, color,
+                       err_color) != 0) {
+            fprintf(stderr, "machdump: error: %s: %s\n", cache_dir,
+                    strerror(errno));
+            return 1;
+        }
+        run.cache = &cache;
+    }
+
+    struct output out, err;
+    output_open(&out, STDOUT_FILENO, color);
+    output_open(&err, STDERR_FILENO, err_color);
+    int status;
+    if (diff) {
+        status = differ(filenames, &run.options, &run.arenas[0], &out, &err);
+    } else if (batch) {
+        run.window = jobs_window(jobs);
+        run.paths = xmalloc(sizeof(*run.paths) * run.window);
+        run.capacities = xmalloc(sizeof(*run.capacities) * run.window);
+        memset(run.paths, 0, sizeof(*run.paths) * run.window);
+        memset(run.capacities, 0, sizeof(*run.capacities) * run.window);
+        const size_t failures = jobs_stream(jobs, batch_next, batch_job, &run,
+                                            &out, &err);
+        status = failures > 0 ? 1 : 0;
+        for (size_t i = 0; i < run.window; i++) {
+            xfree(run.paths[i]);
         }
+        xfree(run.capacities);
+        xfree(run.paths);
+    } else {
+        const size_t failures = jobs_run(count, jobs, driver_job, &run, &out,
+                                         &err);
+        status = failures > 0 ? 1 : 0;
+    }
+    if (run.stats != StatsNone && !diff) {
+        // Parallel jobs write after rendering, so only stdout itself knows
+        // how long writing took in all.
+        output_flush(&out);
+        run.total.write_ns = out.write_ns;
+        stats_print(&err, run.stats, "total", &run.total);
+    }
+    output_close(&out);
+    output_close(&err);
+    if (run.cache) {
+        cache_close(run.cache);
+    }
+    for (unsigned i = 0; i < jobs; i++) {
+        arena_free(&run.arenas[i]);
     }
+    xfree(run.idle);
+    xfree(run.arenas);
+    pthread_mutex_destroy(&run.lock);
+    xfree(excludes);
+    xfree(members);
+    xfree(sections);
+    xfree(commands);
+    xfree(filenames);
+    return status;
 }
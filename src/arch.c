@@ -0,0 +1,58 @@
+// src/arch.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#include "arch.h"
+#include <string.h>
+#include <mach-o/loader.h>
+
+static const struct arch arches[] = {
+    { "x86_64", CPU_TYPE_X86_64, CPU_SUBTYPE_X86_64_ALL },
+    { "x86_64h", CPU_TYPE_X86_64, CPU_SUBTYPE_X86_64_H },
+    { "i386", CPU_TYPE_I386, CPU_SUBTYPE_I386_ALL },
+    { "arm64", CPU_TYPE_ARM64, CPU_SUBTYPE_ARM64_ALL },
+    { "arm64e", CPU_TYPE_ARM64, CPU_SUBTYPE_ARM64E },
+    { "arm64_32", CPU_TYPE_ARM64_32, 1 },
+    { "armv7", CPU_TYPE_ARM, CPU_SUBTYPE_ARM_V7 },
+    { "armv7s", CPU_TYPE_ARM, 11 },
+    { "ppc", CPU_TYPE_POWERPC, CPU_SUBTYPE_POWERPC_ALL },
+    { "ppc64", CPU_TYPE_POWERPC64, CPU_SUBTYPE_POWERPC_ALL }
+};
+
+#define ARCH_COUNT (sizeof(arches) / sizeof(*arches))
+
+const struct arch* arch_from_name(const char* name) {
+    for (size_t i = 0; i < ARCH_COUNT; i++) {
+        if (strcmp(arches[i].name, name) == 0) {
+            return &arches[i];
+        }
+    }
+    return NULL;
+}
+
+const struct arch* arch_from_cpu(int32_t cputype, int32_t cpusubtype) {
+    for (size_t i = 0; i < ARCH_COUNT; i++) {
+        if (arch_matches(&arches[i], cputype, cpusubtype)) {
+            return &arches[i];
+        }
+    }
+    return NULL;
+}
+
+int arch_matches(const struct arch* arch, int32_t cputype,
+                 int32_t cpusubtype) {
+    return arch->cputype == cputype
+        && arch->cpusubtype == (int32_t)(cpusubtype & ~CPU_SUBTYPE_MASK);
+}
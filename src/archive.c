@@ -0,0 +1,262 @@
+// src/archive.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#include "archive.h"
+#include "arena.h"
+#include "source.h"
+#include <ar.h>
+#include <string.h>
+#include <mach-o/ranlib.h>
+
+#define S(...) struct __VA_ARGS__
+
+// BSD long names; not every host's <ar.h> has this.
+#ifndef AR_EFMT1
+#define AR_EFMT1 "#1/"
+#endif
+
+int archive_is(struct source* source) {
+    const char* magic = source_read(source, 0, SARMAG);
+    return magic && memcmp(magic, ARMAG, SARMAG) == 0;
+}
+
+// Reads a space-padded number. Empty fields, which some tools write for the
+// date and IDs, read as zero.
+static int parse_number(const char* field, size_t width, unsigned base,
+                        uint64_t* value) {
+    size_t i = 0;
+    *value = 0;
+    for (; i < width && field[i] >= '0' && field[i] < (char)('0' + base);
+         i++) {
+        if (*value > (UINT64_MAX - 9) / base) {
+            return -1;
+        }
+        *value = *value * base + (uint64_t)(field[i] - '0');
+    }
+    for (; i < width; i++) {
+        if (field[i] != ' ') {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static const char* copy_name(struct arena* arena, const char* name,
+                             size_t length) {
+    char* copy = arena_alloc(arena, length + 1);
+    memcpy(copy, name, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+// Fills in `member` from the header at `offset`, returning where the next
+// header starts in `next`, which is left alone on failure.
+static enum archive_status parse_member(struct archive* archive,
+                                        uint64_t offset,
+                                        struct archive_member* member,
+                                        uint64_t* next) {
+    struct source* source = archive->source;
+    const S(ar_hdr*) header = source_read(source, offset, sizeof(*header));
+    uint64_t size, date, uid, gid, mode;
+    if (!header || memcmp(header->ar_fmag, ARFMAG, 2) != 0
+        || parse_number(header->ar_size, sizeof(header->ar_size), 10, &size)
+        || parse_number(header->ar_date, sizeof(header->ar_date), 10, &date)
+        || parse_number(header->ar_uid, sizeof(header->ar_uid), 10, &uid)
+        || parse_number(header->ar_gid, sizeof(header->ar_gid), 10, &gid)
+        || parse_number(header->ar_mode, sizeof(header->ar_mode), 8,
+                        &mode)) {
+        return ArchiveBadHeader;
+    }
+    const uint64_t start = offset + sizeof(*header);
+    if (size > source->length - start) {
+        return ArchiveMemberOutOfBounds;
+    }
+    member->header = offset;
+    member->offset = start;
+    member->size = size;
+    member->date = date;
+    member->uid = (uint32_t)uid;
+    member->gid = (uint32_t)gid;
+    member->mode = (uint32_t)mode;
+    // Members start on even offsets.
+    *next = start + size + (size & 1);
+
+    const size_t prefix = sizeof(AR_EFMT1) - 1;
+    if (memcmp(header->ar_name, AR_EFMT1, prefix) == 0) {
+        uint64_t length;
+        const char* name;
+        if (parse_number(header->ar_name + prefix,
+                         sizeof(header->ar_name) - prefix, 10, &length)
+            || length > size
+            || !(name = source_read(source, start, (size_t)length))) {
+            return ArchiveBadLongName;
+        }
+        // The name is padded with NULs to keep the contents aligned.
+        const char* end = memchr(name, '\0', (size_t)length);
+        member->name = copy_name(archive->arena, name,
+                                 end ? (size_t)(end - name) : (size_t)length);
+        member->offset += length;
+        member->size -= length;
+    } else {
+        size_t length = sizeof(header->ar_name);
+        while (length > 0 && header->ar_name[length - 1] == ' ') {
+            length--;
+        }
+        member->name = copy_name(archive->arena, header->ar_name, length);
+    }
+    return ArchiveOk;
+}
+
+static int is_symdef(const char* name) {
+    return strcmp(name, SYMDEF) == 0 || strcmp(name, SYMDEF_SORTED) == 0
+        || strcmp(name, SYMDEF_64) == 0 || strcmp(name, SYMDEF_64_SORTED) == 0;
+}
+
+// Index fields are host-endian but need not be aligned.
+static uint64_t read_word(const char* bytes, int is_64) {
+    if (is_64) {
+        uint64_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static const struct archive_member* find_member(
+    const struct archive* archive, uint64_t header) {
+    size_t low = 0, high = archive->nmembers;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (archive->members[middle].header < header) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < archive->nmembers && archive->members[low].header == header
+        ? &archive->members[low]
+        : NULL;
+}
+
+// The index is a byte count and that many ranlib entries, then a byte count
+// and the string table they refer to.
+static enum archive_status parse_symdef(struct archive* archive) {
+    const struct archive_member* symdef = archive->symdef;
+    const int is_64 = archive->symdef_64;
+    const size_t word = is_64 ? sizeof(uint64_t) : sizeof(uint32_t);
+    const size_t entry = is_64 ? sizeof(S(ranlib_64)) : sizeof(S(ranlib));
+    const char* bytes = source_read(archive->source, symdef->offset,
+                                    symdef->size);
+    if (!bytes || symdef->size < word) {
+        return ArchiveBadSymbolIndex;
+    }
+    const uint64_t size = symdef->size;
+    const uint64_t entries = read_word(bytes, is_64);
+    if (entries % entry != 0 || entries > size - word
+        || size - word - entries < word) {
+        return ArchiveBadSymbolIndex;
+    }
+    const char* table = bytes + word;
+    const uint64_t strsize = read_word(table + entries, is_64);
+    const char* strings = table + entries + word;
+    if (strsize > size - word - entries - word) {
+        return ArchiveBadSymbolIndex;
+    }
+
+    archive->nsymbols = (size_t)(entries / entry);
+    archive->symbols = arena_alloc(archive->arena, sizeof(*archive->symbols)
+                                                   * archive->nsymbols);
+    for (size_t i = 0; i < archive->nsymbols; i++) {
+        struct archive_symbol* symbol = &archive->symbols[i];
+        const uint64_t strx = read_word(table + i * entry, is_64);
+        symbol->header = read_word(table + i * entry + word, is_64);
+        symbol->member = find_member(archive, symbol->header);
+        symbol->name = strx < strsize
+                       && memchr(strings + strx, '\0', strsize - strx)
+            ? strings + strx
+            : NULL;
+    }
+    return ArchiveOk;
+}
+
+enum archive_status archive_parse(struct archive* archive,
+                                  struct source* source, struct arena* arena) {
+    memset(archive, 0, sizeof(*archive));
+    archive->source = source;
+    archive->arena = arena;
+    if (!archive_is(source)) {
+        return archive->status = ArchiveNotArchive;
+    }
+
+    size_t capacity = 16;
+    archive->members = arena_alloc(arena, sizeof(*archive->members)
+                                          * capacity);
+    uint64_t offset = SARMAG;
+    while (offset < source->length) {
+        if (archive->nmembers == capacity) {
+            struct archive_member* members =
+                arena_alloc(arena, sizeof(*members) * capacity * 2);
+            memcpy(members, archive->members, sizeof(*members) * capacity);
+            archive->members = members;
+            capacity *= 2;
+        }
+        struct archive_member* member = &archive->members[archive->nmembers];
+        const enum archive_status status = parse_member(archive, offset,
+                                                        member, &offset);
+        if (status != ArchiveOk) {
+            archive->status = status;
+            archive->error_offset = offset;
+            break;
+        }
+        if (archive->nmembers == 0 && !archive->symdef
+            && is_symdef(member->name)) {
+            // Kept apart from the members, which it would otherwise lead.
+            struct archive_member* symdef = arena_alloc(arena,
+                                                        sizeof(*symdef));
+            *symdef = *member;
+            archive->symdef = symdef;
+            archive->symdef_64 = strstr(member->name, "_64") != NULL;
+        } else {
+            archive->nmembers++;
+        }
+    }
+
+    if (archive->symdef && parse_symdef(archive) != ArchiveOk) {
+        archive->nsymbols = 0;
+        if (archive->status == ArchiveOk) {
+            archive->status = ArchiveBadSymbolIndex;
+            archive->error_offset = archive->symdef->header;
+        }
+    }
+    return archive->status;
+}
+
+const char* archive_status_message(enum archive_status status) {
+    switch (status) {
+        case ArchiveOk: return "No error";
+        case ArchiveNotArchive: return "Expected ar archive";
+        case ArchiveBadHeader: return "Archive member header is invalid";
+        case ArchiveBadLongName:
+            return "Archive member name extends past its contents";
+        case ArchiveMemberOutOfBounds:
+            return "Archive member extends past end of file";
+        case ArchiveBadSymbolIndex:
+            return "Archive symbol index is malformed";
+    }
+    return "Unknown error";
+}
@@ -0,0 +1,98 @@
+// src/arena.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#include "arena.h"
+#include "safe.h"
+
+#define ARENA_BLOCK (64 * 1024)
+#define ARENA_ALIGN 16
+
+struct arena_block {
+    struct arena_block* next;
+    size_t size;
+};
+
+// Allocations start past the block header, rounded up to the alignment.
+#define ARENA_HEADER ((sizeof(struct arena_block) + ARENA_ALIGN - 1) \
+                      & ~(size_t)(ARENA_ALIGN - 1))
+
+static struct arena_block* block_new(size_t size) {
+    struct arena_block* block = malloc(ARENA_HEADER + size);
+    if (block) {
+        block->next = NULL;
+        block->size = size;
+    }
+    return block;
+}
+
+void arena_init(struct arena* arena) {
+    arena->blocks = NULL;
+    arena->used = 0;
+    arena->total = 0;
+}
+
+void* arena_try_alloc(struct arena* arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    struct arena_block* block = arena->blocks;
+    if (!block || block->size - arena->used < size) {
+        size_t capacity = block ? block->size * 2 : ARENA_BLOCK;
+        while (capacity < size) {
+            capacity *= 2;
+        }
+        block = block_new(capacity);
+        if (!block) {
+            return NULL;
+        }
+        block->next = arena->blocks;
+        arena->blocks = block;
+        arena->used = 0;
+    }
+    void* bytes = (char*)block + ARENA_HEADER + arena->used;
+    arena->used += size;
+    arena->total += size;
+    return bytes;
+}
+
+void* arena_alloc(struct arena* arena, size_t size) {
+    void* bytes = arena_try_alloc(arena, size);
+    return bytes ? bytes : memory_exhausted();
+}
+
+void arena_reset(struct arena* arena) {
+    if (arena->blocks && arena->blocks->next) {
+        // Several blocks were needed, so replace them with one that fits
+        // the whole high-water mark.
+        size_t capacity = ARENA_BLOCK;
+        while (capacity < arena->total) {
+            capacity *= 2;
+        }
+        arena_free(arena);
+        // If this fails the next allocation starts a block of its own.
+        arena->blocks = block_new(capacity);
+    }
+    arena->used = 0;
+    arena->total = 0;
+}
+
+void arena_free(struct arena* arena) {
+    while (arena->blocks) {
+        struct arena_block* next = arena->blocks->next;
+        xfree(arena->blocks);
+        arena->blocks = next;
+    }
+    arena->used = 0;
+    arena->total = 0;
+}
@@ -0,0 +1,420 @@
+// src/cache.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#define _POSIX_C_SOURCE 200809L
+#define _DARWIN_C_SOURCE
+
+#include "cache.h"
+#include "arch.h"
+#include "dump.h"
+#include "hash.h"
+#include "output.h"
+#include "safe.h"
+#include "source.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Entries are named by 16 hex digits. Temporary files left behind by a
+// process that died while storing are removed once they are this old.
+#define CACHE_NAME 16
+#define CACHE_TEMP ".tmp."
+#define CACHE_STALE (24 * 60 * 60)
+
+// The nanosecond modification time of a struct stat.
+#ifdef __APPLE__
+#define STAT_MTIME(info) ((info)->st_mtimespec)
+#else
+#define STAT_MTIME(info) ((info)->st_mtim)
+#endif
+
+static const char cache_magic[8] = "MDCACHE1";
+
+struct cache_header {
+    char magic[8];
+    uint64_t identity;
+    uint64_t options;
+    uint64_t content;
+    uint64_t out_length;
+    uint64_t err_length;
+    int64_t status;
+};
+
+static uint64_t mix_uint(uint64_t seed, uint64_t value) {
+    return hash64(&value, sizeof(value), seed);
+}
+
+static uint64_t mix_string(uint64_t seed, const char* text) {
+    if (!text) {
+        return mix_uint(seed, 0);
+    }
+    return hash64(text, strlen(text) + 1, mix_uint(seed, 1));
+}
+
+// Every option that changes what is printed must be mixed in here.
+static uint64_t options_key(const struct dump_options* options, int color,
+                            int err_color) {
+    uint64_t key = mix_uint(0, CACHE_FORMAT_VERSION);
+    key = mix_uint(key, options->format);
+    key = mix_uint(key, options->summary);
+    key = mix_string(key, options->arch ? options->arch->name : NULL);
+    key = mix_string(key, options->symbol);
+    key = mix_string(key, options->prefix);
+    key = mix_uint(key, options->find_address);
+    key = mix_uint(key, options->address);
+    key = mix_uint(key, options->header_only);
+    key = mix_uint(key, options->command_count);
+    for (size_t i = 0; i < options->command_count; i++) {
+        key = mix_uint(key, options->commands[i]);
+    }
+    key = mix_uint(key, options->section_count);
+    for (size_t i = 0; i < options->section_count; i++) {
+        key = mix_string(key, options->sections[i].segname);
+        key = mix_string(key, options->sections[i].sectname);
+    }
+    key = mix_uint(key, options->hexdump);
+    key = mix_uint(key, options->strings);
+    key = mix_uint(key, options->relocs);
+    key = mix_uint(key, options->hash);
+    key = mix_uint(key, options->hash_exclude_count);
+    for (size_t i = 0; i < options->hash_exclude_count; i++) {
+        key = mix_uint(key, options->hash_excludes[i]);
+    }
+    key = mix_uint(key, options->fixups);
+    key = mix_string(key, options->dylib);
+    key = mix_uint(key, options->member_count);
+    for (size_t i = 0; i < options->member_count; i++) {
+        key = mix_string(key, options->members[i]);
+    }
+    key = mix_uint(key, color);
+    return mix_uint(key, err_color);
+}
+
+static uint64_t identity_key(const struct stat* info) {
+    uint64_t key = mix_uint(0, (uint64_t)info->st_dev);
+    key = mix_uint(key, (uint64_t)info->st_ino);
+    key = mix_uint(key, (uint64_t)info->st_size);
+    key = mix_uint(key, (uint64_t)STAT_MTIME(info).tv_sec);
+    return mix_uint(key, (uint64_t)STAT_MTIME(info).tv_nsec);
+}
+
+// Returns the path of `name` in the cache directory, to be freed by the
+// caller.
+static char* cache_path(const struct cache* cache, const char* name) {
+    const size_t length = strlen(cache->dir) + strlen(name) + 2;
+    char* path = xmalloc(length);
+    snprintf(path, length, "%s/%s", cache->dir, name);
+    return path;
+}
+
+static char* entry_path(const struct cache* cache, uint64_t identity) {
+    char name[CACHE_NAME + 1];
+    snprintf(name, sizeof(name), "%016llx",
+             (unsigned long long)hash64(&identity, sizeof(identity),
+                                        cache->options));
+    return cache_path(cache, name);
+}
+
+static int is_entry_name(const char* name) {
+    size_t i = 0;
+    for (; name[i]; i++) {
+        if (!strchr("0123456789abcdef", name[i])) {
+            return 0;
+        }
+    }
+    return i == CACHE_NAME;
+}
+
+static int hash_contents(struct source* source, struct cache_key* key) {
+    if (!key->hashed) {
+        const void* bytes = source->length > 0
+            ? source_read(source, 0, source->length) : "";
+        if (!bytes) {
+            return -1;
+        }
+        key->content = hash64(bytes, source->length, 0);
+        key->hashed = 1;
+    }
+    return 0;
+}
+
+static int write_all(int fd, const void* bytes, size_t length) {
+    const char* next = bytes;
+    while (length > 0) {
+        const ssize_t count = write(fd, next, length);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        } else if (count <= 0) {
+            return -1;
+        }
+        next += count;
+        length -= (size_t)count;
+    }
+    return 0;
+}
+
+static void count(struct cache* cache, uint64_t* counter) {
+    pthread_mutex_lock(&cache->lock);
+    (*counter)++;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+int cache_open(struct cache* cache, const char* dir, uint64_t limit,
+               const struct dump_options* options, int color,
+               int err_color) {
+    struct stat info;
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    if (stat(dir, &info) != 0) {
+        return -1;
+    } else if (!S_ISDIR(info.st_mode)) {
+        errno = ENOTDIR;
+        return -1;
+    }
+    memset(cache, 0, sizeof(*cache));
+    cache->dir = dir;
+    cache->limit = limit;
+    cache->options = options_key(options, color, err_color);
+    pthread_mutex_init(&cache->lock, NULL);
+    return 0;
+}
+
+enum cache_result cache_lookup(struct cache* cache, const char* filename,
+                               struct source* source, struct cache_key* key,
+                               struct output* out, struct output* err) {
+    struct stat info;
+    if (strcmp(filename, "-") == 0 || stat(filename, &info) != 0
+        || !S_ISREG(info.st_mode)) {
+        return CacheSkip;
+    }
+    key->identity = identity_key(&info);
+    key->hashed = 0;
+
+    char* path = entry_path(cache, key->identity);
+    const int fd = open(path, O_RDONLY);
+    xfree(path);
+    if (fd < 0) {
+        count(cache, &cache->misses);
+        return CacheMiss;
+    }
+
+    // Entries are never changed once renamed into place, so one that is
+    // the size its header says is complete.
+    enum cache_result result = CacheMiss;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &info) == 0
+        && (size_t)info.st_size >= sizeof(struct cache_header)) {
+        map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd,
+                   0);
+    }
+    if (map != MAP_FAILED) {
+        const struct cache_header* header = map;
+        const char* data = (const char*)map + sizeof(*header);
+        const uint64_t size = (uint64_t)info.st_size - sizeof(*header);
+        if (memcmp(header->magic, cache_magic, sizeof(cache_magic)) == 0
+            && header->identity == key->identity
+            && header->options == cache->options
+            && header->out_length <= size
+            && header->err_length == size - header->out_length
+            && hash_contents(source, key) == 0
+            && header->content == key->content) {
+            output_write(out, data, header->out_length);
+            output_write(err, data + header->out_length, header->err_length);
+            key->status = (int)header->status;
+            result = CacheHit;
+            // Eviction goes by modification time, least recent first.
+            futimens(fd, NULL);
+        }
+        munmap(map, (size_t)info.st_size);
+    }
+    close(fd);
+    count(cache, result == CacheHit ? &cache->hits : &cache->misses);
+    return result;
+}
+
+void cache_store(struct cache* cache, struct cache_key* key,
+                 struct source* source, const struct output* out,
+                 const struct output* err, int status) {
+    // An entry larger than the whole cache would only be evicted again.
+    if (sizeof(struct cache_header) + out->length + err->length
+        > cache->limit || hash_contents(source, key) != 0) {
+        return;
+    }
+    struct cache_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.identity = key->identity;
+    header.options = cache->options;
+    header.content = key->content;
+    header.out_length = out->length;
+    header.err_length = err->length;
+    header.status = status;
+
+    char* temp = cache_path(cache, CACHE_TEMP "XXXXXX");
+    const int fd = mkstemp(temp);
+    if (fd < 0) {
+        xfree(temp);
+        return;
+    }
+    const int written = write_all(fd, &header, sizeof(header)) == 0
+        && write_all(fd, out->data, out->length) == 0
+        && write_all(fd, err->data, err->length) == 0;
+    char* path = entry_path(cache, key->identity);
+    if (close(fd) == 0 && written && rename(temp, path) == 0) {
+        count(cache, &cache->stores);
+    } else {
+        unlink(temp);
+    }
+    xfree(path);
+    xfree(temp);
+}
+
+struct cache_file {
+    char name[CACHE_NAME + 1];
+    struct timespec mtime;
+    uint64_t size;
+};
+
+static int compare_mtime(const void* lhs, const void* rhs) {
+    const struct cache_file* a = lhs;
+    const struct cache_file* b = rhs;
+    if (a->mtime.tv_sec != b->mtime.tv_sec) {
+        return (a->mtime.tv_sec > b->mtime.tv_sec) ? 1 : -1;
+    }
+    return (a->mtime.tv_nsec > b->mtime.tv_nsec)
+           - (a->mtime.tv_nsec < b->mtime.tv_nsec);
+}
+
+// Removes the least recently used entries until the directory is down to
+// seven eighths of its limit, so that a full cache is not evicted from on
+// every run. Also removes stale temporary files.
+static void evict(struct cache* cache) {
+    DIR* dir = opendir(cache->dir);
+    if (!dir) {
+        return;
+    }
+    size_t capacity = 64;
+    size_t nfiles = 0;
+    struct cache_file* files = xmalloc(sizeof(*files) * capacity);
+    uint64_t total = 0;
+    const time_t now = time(NULL);
+    struct dirent* entry;
+    while ((entry = readdir(dir))) {
+        const int temp = strncmp(entry->d_name, CACHE_TEMP,
+                                 strlen(CACHE_TEMP)) == 0;
+        struct stat info;
+        if ((!temp && !is_entry_name(entry->d_name))
+            || fstatat(dirfd(dir), entry->d_name, &info, 0) != 0) {
+            continue;
+        }
+        if (temp) {
+            if (now - info.st_mtime > CACHE_STALE) {
+                unlinkat(dirfd(dir), entry->d_name, 0);
+            }
+            continue;
+        }
+        if (nfiles == capacity) {
+            struct cache_file* grown = xmalloc(sizeof(*files) * capacity * 2);
+            memcpy(grown, files, sizeof(*files) * nfiles);
+            xfree(files);
+            files = grown;
+            capacity *= 2;
+        }
+        memcpy(files[nfiles].name, entry->d_name, CACHE_NAME + 1);
+        files[nfiles].mtime = STAT_MTIME(&info);
+        files[nfiles].size = (uint64_t)info.st_size;
+        total += files[nfiles].size;
+        nfiles++;
+    }
+    if (total > cache->limit) {
+        qsort(files, nfiles, sizeof(*files), compare_mtime);
+        const uint64_t target = cache->limit - cache->limit / 8;
+        for (size_t i = 0; i < nfiles && total > target; i++) {
+            if (unlinkat(dirfd(dir), files[i].name, 0) == 0) {
+                total -= files[i].size;
+                cache->evictions++;
+            }
+        }
+    }
+    xfree(files);
+    closedir(dir);
+}
+
+// The directory's counters are kept as text, one "name value" per line, so
+// they can be read with cat.
+static void update_counters(struct cache* cache) {
+    const char* names[] = { "hits", "misses", "stores", "evictions" };
+    uint64_t values[] = { cache->hits, cache->misses, cache->stores,
+                          cache->evictions };
+    char* path = cache_path(cache, "counters");
+    FILE* file = fopen(path, "r");
+    if (file) {
+        char name[16];
+        unsigned long long value;
+        while (fscanf(file, "%15s %llu", name, &value) == 2) {
+            for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++) {
+                if (strcmp(name, names[i]) == 0) {
+                    values[i] += value;
+                }
+            }
+        }
+        fclose(file);
+    }
+    char* temp = cache_path(cache, CACHE_TEMP "XXXXXX");
+    const int fd = mkstemp(temp);
+    if (fd >= 0) {
+        char text[256];
+        size_t length = 0;
+        for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++) {
+            length += (size_t)snprintf(text + length, sizeof(text) - length,
+                                       "%s %llu\n", names[i],
+                                       (unsigned long long)values[i]);
+        }
+        const int written = write_all(fd, text, length) == 0;
+        if (close(fd) != 0 || !written || rename(temp, path) != 0) {
+            unlink(temp);
+        }
+    }
+    xfree(temp);
+    xfree(path);
+}
+
+void cache_close(struct cache* cache) {
+    char* path = cache_path(cache, "lock");
+    const int fd = open(path, O_RDWR | O_CREAT, 0666);
+    xfree(path);
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    if (fd >= 0 && fcntl(fd, F_SETLKW, &lock) == 0) {
+        evict(cache);
+        if (cache->hits + cache->misses > 0) {
+            update_counters(cache);
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    pthread_mutex_destroy(&cache->lock);
+}
@@ -0,0 +1,163 @@
+// src/cstrings.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#include "cstrings.h"
+#include "safe.h"
+#include <string.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__) && defined(__GNUC__)
+#include <arm_neon.h>
+#endif
+
+#define BLOCK 64
+
+// Returns a mask with bit i set when byte i of the block is zero.
+#if defined(__SSE2__) && defined(__GNUC__)
+static uint64_t zero_mask(const char* block) {
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t mask = 0;
+    for (int i = 0; i < 4; i++) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(block + 16 * i));
+        mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero))
+             << (16 * i);
+    }
+    return mask;
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__) && defined(__GNUC__)
+static uint64_t zero_mask(const char* block) {
+    // NEON has no movemask: each matching lane keeps one bit of its
+    // position, and pairwise adds fold the four vectors into 64 bits.
+    static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128,
+                                         1, 2, 4, 8, 16, 32, 64, 128 };
+    const uint8x16_t bit = vld1q_u8(weights);
+    const uint8_t* b = (const uint8_t*)block;
+    const uint8x16_t t0 = vandq_u8(vceqzq_u8(vld1q_u8(b)), bit);
+    const uint8x16_t t1 = vandq_u8(vceqzq_u8(vld1q_u8(b + 16)), bit);
+    const uint8x16_t t2 = vandq_u8(vceqzq_u8(vld1q_u8(b + 32)), bit);
+    const uint8x16_t t3 = vandq_u8(vceqzq_u8(vld1q_u8(b + 48)), bit);
+    uint8x16_t sum = vpaddq_u8(vpaddq_u8(t0, t1), vpaddq_u8(t2, t3));
+    sum = vpaddq_u8(sum, sum);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(sum), 0);
+}
+#endif
+
+void cstrings_scan(const void* bytes, size_t length, cstring_visitor visit,
+                   void* context) {
+    const char* data = bytes;
+    size_t start = 0;
+    size_t i = 0;
+#if (defined(__SSE2__) || (defined(__ARM_NEON) && defined(__aarch64__))) \
+    && defined(__GNUC__)
+    for (; length - i >= BLOCK; i += BLOCK) {
+        for (uint64_t mask = zero_mask(data + i); mask; mask &= mask - 1) {
+            const size_t nul = i + (size_t)__builtin_ctzll(mask);
+            visit(context, data + start, start, nul - start, 1);
+            start = nul + 1;
+        }
+    }
+#endif
+    for (; i < length; i++) {
+        if (data[i] == '\0') {
+            visit(context, data + start, start, i - start, 1);
+            start = i + 1;
+        }
+    }
+    if (start < length) {
+        visit(context, data + start, start, length - start, 0);
+    }
+}
+
+static uint64_t hash_bytes(const char* string, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325ull ^ length;
+    size_t i = 0;
+    for (; length - i >= 8; i += 8) {
+        uint64_t word;
+        memcpy(&word, string + i, sizeof(word));
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+        hash ^= hash >> 29;
+    }
+    for (; i < length; i++) {
+        hash = (hash ^ (unsigned char)string[i]) * 0x100000001b3ull;
+    }
+    return hash ^ (hash >> 32);
+}
+
+void cstring_set_init(struct cstring_set* set) {
+    set->mask = 1023;
+    set->count = 0;
+    set->entries = xmalloc(sizeof(*set->entries) * (set->mask + 1));
+    memset(set->entries, 0, sizeof(*set->entries) * (set->mask + 1));
+}
+
+void cstring_set_free(struct cstring_set* set) {
+    xfree(set->entries);
+    set->entries = NULL;
+}
+
+static struct cstring_entry* find_slot(struct cstring_entry* entries,
+                                       size_t mask, const char* string,
+                                       size_t length) {
+    size_t slot = (size_t)hash_bytes(string, length) & mask;
+    while (entries[slot].string
+           && (entries[slot].length != length
+               || memcmp(entries[slot].string, string, length) != 0)) {
+        slot = (slot + 1) & mask;
+    }
+    return &entries[slot];
+}
+
+static void grow(struct cstring_set* set) {
+    const size_t mask = set->mask * 2 + 1;
+    struct cstring_entry* entries = xmalloc(sizeof(*entries) * (mask + 1));
+    memset(entries, 0, sizeof(*entries) * (mask + 1));
+    for (size_t i = 0; i <= set->mask; i++) {
+        if (set->entries[i].string) {
+            *find_slot(entries, mask, set->entries[i].string,
+                       set->entries[i].length) = set->entries[i];
+        }
+    }
+    xfree(set->entries);
+    set->entries = entries;
+    set->mask = mask;
+}
+
+struct cstring_entry* cstring_set_add(struct cstring_set* set,
+                                      const char* string, size_t length,
+                                      uint64_t offset) {
+    if ((set->count + 1) * 2 > set->mask + 1) {
+        grow(set);
+    }
+    struct cstring_entry* entry = find_slot(set->entries, set->mask, string,
+                                            length);
+    if (!entry->string) {
+        entry->string = string;
+        entry->length = length;
+        entry->offset = offset;
+        set->count++;
+    }
+    entry->count++;
+    return entry;
+}
+
+const struct cstring_entry* cstring_set_find(const struct cstring_set* set,
+                                             const char* string,
+                                             size_t length) {
+    const struct cstring_entry* entry = find_slot(set->entries, set->mask,
+                                                  string, length);
+    return entry->string ? entry : NULL;
+}
@@ -0,0 +1,682 @@
+// src/diff.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#include "diff.h"
+#include "arena.h"
+#include "cstrings.h"
+#include "dump.h"
+#include "hash.h"
+#include "image.h"
+#include "output.h"
+#include "record.h"
+#include "source.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#define printf(...) output_printf(diff->out, __VA_ARGS__)
+#include <mach-o/loader.h>
+#include <mach-o/nlist.h>
+
+#define S(...) struct __VA_ARGS__
+
+#define local static inline
+
+#define DIFF_CHUNK (64 * 1024)
+#define DIFF_RANGES_MAX 8
+#define DIFF_NAME_MAX 512
+
+struct diff {
+    struct output* out;
+    struct record_writer* records;
+    struct image* before;
+    struct image* after;
+    struct arena* arena;
+    uint64_t differences;
+};
+
+// The fields compared for each structure. File offsets are left out on
+// purpose; see diff.h.
+struct field {
+    const char* name;
+    uint16_t offset;
+    uint16_t size;
+};
+
+#define FIELD(type, member) \
+    { #member, offsetof(S(type), member), sizeof(((S(type)*)0)->member) }
+#define FIELDS(table) table, sizeof(table) / sizeof(*table)
+
+static const struct field header_fields[] = {
+    FIELD(mach_header_64, cputype), FIELD(mach_header_64, cpusubtype),
+    FIELD(mach_header_64, filetype), FIELD(mach_header_64, ncmds),
+    FIELD(mach_header_64, sizeofcmds), FIELD(mach_header_64, flags),
+};
+
+static const struct field segment_fields[] = {
+    FIELD(segment_command_64, vmaddr), FIELD(segment_command_64, vmsize),
+    FIELD(segment_command_64, filesize), FIELD(segment_command_64, maxprot),
+    FIELD(segment_command_64, initprot), FIELD(segment_command_64, nsects),
+    FIELD(segment_command_64, flags),
+};
+
+static const struct field section_fields[] = {
+    FIELD(section_64, addr), FIELD(section_64, size),
+    FIELD(section_64, align), FIELD(section_64, nreloc),
+    FIELD(section_64, flags), FIELD(section_64, reserved1),
+    FIELD(section_64, reserved2), FIELD(section_64, reserved3),
+};
+
+static const struct field symtab_fields[] = {
+    FIELD(symtab_command, nsyms), FIELD(symtab_command, strsize),
+};
+
+static const struct field dysymtab_fields[] = {
+    FIELD(dysymtab_command, ilocalsym), FIELD(dysymtab_command, nlocalsym),
+    FIELD(dysymtab_command, iextdefsym), FIELD(dysymtab_command, nextdefsym),
+    FIELD(dysymtab_command, iundefsym), FIELD(dysymtab_command, nundefsym),
+    FIELD(dysymtab_command, ntoc), FIELD(dysymtab_command, nmodtab),
+    FIELD(dysymtab_command, nextrefsyms),
+    FIELD(dysymtab_command, nindirectsyms), FIELD(dysymtab_command, nextrel),
+    FIELD(dysymtab_command, nlocrel),
+};
+
+static const struct field uuid_fields[] = {
+    FIELD(uuid_command, uuid),
+};
+
+static const struct field linkedit_data_fields[] = {
+    FIELD(linkedit_data_command, datasize),
+};
+
+static const struct field build_version_fields[] = {
+    FIELD(build_version_command, platform),
+    FIELD(build_version_command, minos), FIELD(build_version_command, sdk),
+    FIELD(build_version_command, ntools),
+};
+
+static const struct field version_min_fields[] = {
+    FIELD(version_min_command, version), FIELD(version_min_command, sdk),
+};
+
+static const struct field dylib_fields[] = {
+    FIELD(dylib_command, dylib.timestamp),
+    FIELD(dylib_command, dylib.current_version),
+    FIELD(dylib_command, dylib.compatibility_version),
+};
+
+static const struct field source_version_fields[] = {
+    FIELD(source_version_command, version),
+};
+
+static const struct field entry_point_fields[] = {
+    FIELD(entry_point_command, entryoff),
+    FIELD(entry_point_command, stacksize),
+};
+
+// Returns the fields compared for a load command, or NULL if it is
+// compared as a whole.
+local const struct field* command_fields(uint32_t cmd, size_t* count) {
+    #define CASE(value, table) \
+        case value: *count = sizeof(table) / sizeof(*table); return table
+    switch (cmd) {
+        CASE(LC_SEGMENT_64, segment_fields);
+        CASE(LC_SEGMENT, segment_fields);
+        CASE(LC_SYMTAB, symtab_fields);
+        CASE(LC_DYSYMTAB, dysymtab_fields);
+        CASE(LC_UUID, uuid_fields);
+        case LC_FUNCTION_STARTS:
+        case LC_DATA_IN_CODE:
+        case LC_SEGMENT_SPLIT_INFO:
+        case LC_DYLIB_CODE_SIGN_DRS:
+        case LC_LINKER_OPTIMIZATION_HINT:
+        case LC_DYLD_EXPORTS_TRIE:
+        case LC_DYLD_CHAINED_FIXUPS:
+        CASE(LC_CODE_SIGNATURE, linkedit_data_fields);
+        CASE(LC_BUILD_VERSION, build_version_fields);
+        CASE(LC_VERSION_MIN_MACOSX, version_min_fields);
+        case LC_LOAD_DYLIB:
+        case LC_ID_DYLIB:
+        case LC_LOAD_WEAK_DYLIB:
+        case LC_REEXPORT_DYLIB:
+        case LC_LAZY_LOAD_DYLIB:
+        CASE(LC_LOAD_UPWARD_DYLIB, dylib_fields);
+        CASE(LC_SOURCE_VERSION, source_version_fields);
+        CASE(LC_MAIN, entry_point_fields);
+        default: return NULL;
+    }
+    #undef CASE
+}
+
+local uint64_t field_value(const void* base, const struct field* field) {
+    const unsigned char* p = (const unsigned char*)base + field->offset;
+    switch (field->size) {
+        case 1: return *p;
+        case 2: { uint16_t v; memcpy(&v, p, 2); return v; }
+        case 4: { uint32_t v; memcpy(&v, p, 4); return v; }
+        case 8: { uint64_t v; memcpy(&v, p, 8); return v; }
+        default: return 0;
+    }
+}
+
+local void format_bytes(char* out, const unsigned char* bytes, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        sprintf(out + 2 * i, "%02x", bytes[i]);
+    }
+}
+
+local void report_field(struct diff* diff, const char* item,
+                        const struct field* field, const void* before,
+                        const void* after) {
+    diff->differences++;
+    const unsigned char* a = (const unsigned char*)before + field->offset;
+    const unsigned char* b = (const unsigned char*)after + field->offset;
+    if (field->size > 8) {
+        char old_text[33], new_text[33];
+        format_bytes(old_text, a, field->size);
+        format_bytes(new_text, b, field->size);
+        if (diff->records) {
+            record_begin(diff->records, "difference");
+            record_string(diff->records, "kind", "field");
+            record_string(diff->records, "item", item);
+            record_string(diff->records, "field", field->name);
+            record_string(diff->records, "before", old_text);
+            record_string(diff->records, "after", new_text);
+            record_end(diff->records);
+        } else {
+            printf("  │ {+}%s{0}: %s: {Y}%s{0} -> {Y}%s{0}\n", item,
+                   field->name, old_text, new_text);
+        }
+        return;
+    }
+    const uint64_t old_value = field_value(before, field);
+    const uint64_t new_value = field_value(after, field);
+    if (diff->records) {
+        record_begin(diff->records, "difference");
+        record_string(diff->records, "kind", "field");
+        record_string(diff->records, "item", item);
+        record_string(diff->records, "field", field->name);
+        record_uint(diff->records, "before", old_value);
+        record_uint(diff->records, "after", new_value);
+        record_end(diff->records);
+    } else {
+        printf("  │ {+}%s{0}: %s: {Y}0x%llx{0} -> {Y}0x%llx{0}\n", item,
+               field->name, (unsigned long long)old_value,
+               (unsigned long long)new_value);
+    }
+}
+
+// Reports an item that is only in one file, or whose contents differ as a
+// whole: `kind` is "added", "removed" or "changed".
+local void report_item(struct diff* diff, const char* item,
+                       const char* kind) {
+    diff->differences++;
+    if (diff->records) {
+        record_begin(diff->records, "difference");
+        record_string(diff->records, "kind", kind);
+        record_string(diff->records, "item", item);
+        record_end(diff->records);
+    } else {
+        printf("  │ {+}%s{0}: %s\n", item, kind);
+    }
+}
+
+local void report_bytes(struct diff* diff, const char* item, uint64_t start,
+                        uint64_t end) {
+    diff->differences++;
+    if (diff->records) {
+        record_begin(diff->records, "difference");
+        record_string(diff->records, "kind", "bytes");
+        record_string(diff->records, "item", item);
+        record_uint(diff->records, "start", start);
+        record_uint(diff->records, "end", end);
+        record_end(diff->records);
+    } else {
+        printf("  │ {+}%s{0}: bytes {Y}0x%llx{0}..{Y}0x%llx{0} differ\n",
+               item, (unsigned long long)start,
+               (unsigned long long)(end - 1));
+    }
+}
+
+// Compares the fields both structures are large enough to hold.
+local void diff_fields(struct diff* diff, const char* item,
+                       const struct field* fields, size_t count,
+                       const void* before, size_t before_size,
+                       const void* after, size_t after_size) {
+    for (size_t i = 0; i < count; i++) {
+        const struct field* field = &fields[i];
+        const size_t end = (size_t)field->offset + field->size;
+        if (end <= before_size && end <= after_size
+            && memcmp((const char*)before + field->offset,
+                      (const char*)after + field->offset, field->size)
+               != 0) {
+            report_field(diff, item, field, before, after);
+        }
+    }
+}
+
+// Returns the first and one past the last differing byte of two blocks of
+// the same size, or 0 if they are the same.
+local int differing_range(const unsigned char* a, const unsigned char* b,
+                          size_t size, size_t* first, size_t* end) {
+    size_t i = 0;
+    while (i < size && a[i] == b[i]) i++;
+    if (i == size) {
+        return 0;
+    }
+    size_t j = size;
+    while (a[j - 1] == b[j - 1]) j--;
+    *first = i;
+    *end = j;
+    return 1;
+}
+
+// Compares contents chunk by chunk, skipping chunks whose hashes match.
+// Each run of differing chunks is reported as one range, from its first to
+// its last differing byte.
+local void diff_contents(struct diff* diff, const char* item,
+                         const unsigned char* before, uint64_t before_size,
+                         const unsigned char* after, uint64_t after_size) {
+    const uint64_t common = before_size < after_size ? before_size
+                                                     : after_size;
+    uint64_t ranges = 0;
+    uint64_t start = 0, end = 0;
+    int open = 0;
+    for (uint64_t offset = 0; offset < common; offset += DIFF_CHUNK) {
+        const size_t size = (size_t)(common - offset < DIFF_CHUNK
+                                     ? common - offset : DIFF_CHUNK);
+        size_t first, last;
+        if (hash64(before + offset, size, 0) == hash64(after + offset, size, 0)
+            || !differing_range(before + offset, after + offset, size,
+                                &first, &last)) {
+            if (open && ranges++ < DIFF_RANGES_MAX) {
+                report_bytes(diff, item, start, end);
+            }
+            open = 0;
+            continue;
+        }
+        if (!open) {
+            start = offset + first;
+            open = 1;
+        }
+        end = offset + last;
+    }
+    if (before_size != after_size) {
+        const uint64_t longer = before_size > after_size ? before_size
+                                                         : after_size;
+        if (!open) {
+            start = common;
+            open = 1;
+        }
+        end = longer;
+    }
+    if (open && ranges++ < DIFF_RANGES_MAX) {
+        report_bytes(diff, item, start, end);
+    }
+    if (ranges > DIFF_RANGES_MAX) {
+        diff->differences++;
+        if (diff->records) {
+            record_begin(diff->records, "difference");
+            record_string(diff->records, "kind", "more_bytes");
+            record_string(diff->records, "item", item);
+            record_uint(diff->records, "ranges", ranges - DIFF_RANGES_MAX);
+            record_end(diff->records);
+        } else {
+            printf("  │ {+}%s{0}: %llu more differing range(s)\n", item,
+                   (unsigned long long)(ranges - DIFF_RANGES_MAX));
+        }
+    }
+}
+
+// Compares `size` bytes at `offset` in each file, as long as both ranges
+// lie within their file.
+local void diff_region(struct diff* diff, const char* item,
+                       uint64_t before_offset, uint64_t before_size,
+                       uint64_t after_offset, uint64_t after_size) {
+    const unsigned char* before = source_read(diff->before->source,
+                                              before_offset, before_size);
+    const unsigned char* after = source_read(diff->after->source,
+                                             after_offset, after_size);
+    if (before && after) {
+        diff_contents(diff, item, before, before_size, after, after_size);
+    }
+}
+
+// Sections are matched by segment and section name, in order, so a
+// section that moved within its segment is still compared with itself.
+local void diff_sections(struct diff* diff, const struct image_command* before,
+                         const struct image_command* after) {
+    char item[DIFF_NAME_MAX];
+    char* matched = arena_alloc(diff->arena, after->nsects + 1);
+    memset(matched, 0, after->nsects + 1);
+    for (uint32_t i = 0; i < before->nsects; i++) {
+        const struct image_section* a = &before->sections[i];
+        snprintf(item, sizeof(item), "%.16s,%.16s", a->header->segname,
+                 a->header->sectname);
+        uint32_t j = 0;
+        while (j < after->nsects
+               && (matched[j]
+                   || strncmp(a->header->sectname,
+                              after->sections[j].header->sectname, 16)
+                   || strncmp(a->header->segname,
+                              after->sections[j].header->segname, 16))) {
+            j++;
+        }
+        if (j == after->nsects) {
+            report_item(diff, item, "removed");
+            continue;
+        }
+        matched[j] = 1;
+        const struct image_section* b = &after->sections[j];
+        diff_fields(diff, item, FIELDS(section_fields), a->header,
+                    sizeof(*a->header), b->header, sizeof(*b->header));
+        if (a->contents == ContentsInFile && b->contents == ContentsInFile) {
+            diff_region(diff, item, a->header->offset, a->header->size,
+                        b->header->offset, b->header->size);
+        }
+    }
+    for (uint32_t j = 0; j < after->nsects; j++) {
+        if (!matched[j]) {
+            snprintf(item, sizeof(item), "%.16s,%.16s",
+                     after->sections[j].header->segname,
+                     after->sections[j].header->sectname);
+            report_item(diff, item, "added");
+        }
+    }
+}
+
+// Adds every named symbol to `set`, with its index as the offset. Returns
+// -1 if the symbol table cannot be read.
+local int symbol_names(struct image* image, struct image_command* command,
+                       struct cstring_set* set) {
+    if (image_symbols(image, command) != ImageOk) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < command->nsyms; i++) {
+        const char* name = command->symbols[i].name;
+        if (name && *name) {
+            cstring_set_add(set, name, strlen(name), i);
+        }
+    }
+    return 0;
+}
+
+// Symbols are matched by name. Values are addresses and change with any
+// code before them, so only their type, section and description are
+// compared.
+local void diff_symbols(struct diff* diff, struct image_command* before,
+                        struct image_command* after) {
+    static const struct field nlist_fields[] = {
+        FIELD(nlist_64, n_type), FIELD(nlist_64, n_sect),
+        FIELD(nlist_64, n_desc),
+    };
+    struct cstring_set old_names, new_names;
+    cstring_set_init(&old_names);
+    cstring_set_init(&new_names);
+    const int readable = symbol_names(diff->before, before, &old_names) == 0
+        && symbol_names(diff->after, after, &new_names) == 0;
+    if (!readable) {
+        report_item(diff, "symbol table", "unreadable");
+    }
+    char item[DIFF_NAME_MAX];
+    for (uint32_t i = 0; readable && i < before->nsyms; i++) {
+        const char* name = before->symbols[i].name;
+        if (!name || !*name) {
+            continue;
+        }
+        snprintf(item, sizeof(item), "symbol %s", name);
+        const struct cstring_entry* entry =
+            cstring_set_find(&new_names, name, strlen(name));
+        if (!entry) {
+            report_item(diff, item, "removed");
+        } else if (cstring_set_find(&old_names, name, strlen(name))->offset
+                   == i) {
+            // Only the first symbol with a name is compared.
+            diff_fields(diff, item, FIELDS(nlist_fields),
+                        before->symbols[i].nlist, sizeof(S(nlist_64)),
+                        after->symbols[entry->offset].nlist,
+                        sizeof(S(nlist_64)));
+        }
+    }
+    for (uint32_t i = 0; readable && i < after->nsyms; i++) {
+        const char* name = after->symbols[i].name;
+        if (name && *name && !cstring_set_find(&old_names, name,
+                                               strlen(name))) {
+            snprintf(item, sizeof(item), "symbol %s", name);
+            report_item(diff, item, "added");
+        }
+    }
+    cstring_set_free(&old_names);
+    cstring_set_free(&new_names);
+}
+
+// Returns the string a command refers to by an lc_str at `offset`, with its
+// length, or NULL if it does not lie within the command.
+local const char* command_string(const struct image_command* command,
+                                 size_t offset, int* length) {
+    const S(load_command*) load_command = command->header;
+    if (load_command->cmdsize < offset + sizeof(union lc_str)) {
+        return NULL;
+    }
+    uint32_t start;
+    memcpy(&start, (const char*)load_command + offset, sizeof(start));
+    if (start >= load_command->cmdsize) {
+        return NULL;
+    }
+    const char* string = (const char*)load_command + start;
+    const char* end = memchr(string, '\0', load_command->cmdsize - start);
+    *length = (int)(end ? end - string : load_command->cmdsize - start);
+    return string;
+}
+
+// Names a load command for matching and reporting: its type, followed by
+// the segment name or library path for commands that have one.
+local void command_name(const struct image_command* command, char* name,
+                        size_t size) {
+    const uint32_t cmd = command->header->cmd;
+    const char* type = load_command_name(cmd);
+    char unknown[16];
+    if (!type) {
+        snprintf(unknown, sizeof(unknown), "0x%08x", cmd);
+        type = unknown;
+    }
+    const char* detail = NULL;
+    int length = 0;
+    size_t count;
+    if (image_is_segment(cmd) && !command->truncated) {
+        const S(segment_command_64*) seg64 = (const void*)command->header;
+        const char* end = memchr(seg64->segname, '\0',
+                                 sizeof(seg64->segname));
+        detail = seg64->segname;
+        length = end ? (int)(end - detail) : (int)sizeof(seg64->segname);
+    } else if (command_fields(cmd, &count) == dylib_fields) {
+        detail = command_string(command, offsetof(S(dylib_command),
+                                                  dylib.name), &length);
+    } else if (cmd == LC_LOAD_DYLINKER || cmd == LC_ID_DYLINKER) {
+        detail = command_string(command, offsetof(S(dylinker_command), name),
+                                &length);
+    }
+    if (detail && length > 0) {
+        snprintf(name, size, "%s %.*s", type, length, detail);
+    } else {
+        snprintf(name, size, "%s", type);
+    }
+}
+
+local char* copy_name(struct arena* arena, const char* name, size_t length) {
+    char* copy = arena_alloc(arena, length + 1);
+    memcpy(copy, name, length + 1);
+    return copy;
+}
+
+// Gives every load command a name that is unique within its file, by
+// numbering the second and later commands with the same name, and adds
+// them to `set` with their index as the offset.
+local char** command_names(struct diff* diff, const struct image* image,
+                           struct cstring_set* set) {
+    char** names = arena_alloc(diff->arena, sizeof(*names)
+                                            * (image->ncmds + 1));
+    struct cstring_set seen;
+    cstring_set_init(&seen);
+    char name[DIFF_NAME_MAX];
+    for (uint32_t i = 0; i < image->ncmds; i++) {
+        command_name(&image->commands[i], name, sizeof(name) - 24);
+        size_t length = strlen(name);
+        names[i] = copy_name(diff->arena, name, length);
+        const uint64_t count = cstring_set_add(&seen, names[i], length,
+                                               i)->count;
+        if (count > 1) {
+            length += (size_t)snprintf(name + length, 24, " #%llu",
+                                       (unsigned long long)count);
+            names[i] = copy_name(diff->arena, name, length);
+        }
+        cstring_set_add(set, names[i], length, i);
+    }
+    cstring_set_free(&seen);
+    return names;
+}
+
+// Segments of 32-bit files are widened to segment_command_64, which can be
+// larger than the command as stored.
+local size_t command_size(const struct image_command* command) {
+    const uint32_t cmdsize = command->header->cmdsize;
+    if (image_is_segment(command->header->cmd) && !command->truncated
+        && cmdsize < sizeof(S(segment_command_64))) {
+        return sizeof(S(segment_command_64));
+    }
+    return cmdsize;
+}
+
+local void diff_command(struct diff* diff, const char* name,
+                        struct image_command* before,
+                        struct image_command* after) {
+    const S(load_command*) a = before->header;
+    const S(load_command*) b = after->header;
+    size_t count;
+    const struct field* fields = command_fields(a->cmd, &count);
+    if (!fields) {
+        if (a->cmdsize != b->cmdsize || memcmp(a, b, a->cmdsize) != 0) {
+            report_item(diff, name, "changed");
+        }
+        return;
+    }
+    diff_fields(diff, name, fields, count, a, command_size(before), b,
+                command_size(after));
+    if (before->truncated || after->truncated) {
+        return;
+    }
+    if (image_is_segment(a->cmd)) {
+        diff_sections(diff, before, after);
+    } else if (a->cmd == LC_SYMTAB) {
+        diff_symbols(diff, before, after);
+    } else if (fields == linkedit_data_fields
+               && a->cmdsize >= sizeof(S(linkedit_data_command))
+               && b->cmdsize >= sizeof(S(linkedit_data_command))) {
+        const S(linkedit_data_command*) old_data = (const void*)a;
+        const S(linkedit_data_command*) new_data = (const void*)b;
+        diff_region(diff, name, old_data->dataoff, old_data->datasize,
+                    new_data->dataoff, new_data->datasize);
+    }
+}
+
+local void diff_images(struct diff* diff) {
+    struct image* before = diff->before;
+    struct image* after = diff->after;
+    const char* header = before->wide && after->wide ? "mach_header_64"
+                                                     : "mach_header";
+    diff_fields(diff, header, FIELDS(header_fields),
+                before->header, sizeof(*before->header), after->header,
+                sizeof(*after->header));
+
+    struct cstring_set old_names, new_names;
+    cstring_set_init(&old_names);
+    cstring_set_init(&new_names);
+    char** names = command_names(diff, before, &old_names);
+    char** added = command_names(diff, after, &new_names);
+    char* matched = arena_alloc(diff->arena, after->ncmds + 1);
+    memset(matched, 0, after->ncmds + 1);
+    for (uint32_t i = 0; i < before->ncmds; i++) {
+        const struct cstring_entry* entry =
+            cstring_set_find(&new_names, names[i], strlen(names[i]));
+        if (!entry) {
+            report_item(diff, names[i], "removed");
+            continue;
+        }
+        matched[entry->offset] = 1;
+        diff_command(diff, names[i], &before->commands[i],
+                     &after->commands[entry->offset]);
+    }
+    for (uint32_t i = 0; i < after->ncmds; i++) {
+        if (!matched[i]) {
+            report_item(diff, added[i], "added");
+        }
+    }
+    cstring_set_free(&old_names);
+    cstring_set_free(&new_names);
+}
+
+local struct image* parse(const char* name, struct source* source,
+                          struct arena* arena, struct output* err) {
+    struct image* image = arena_alloc(arena, sizeof(*image));
+    const enum image_status status = image_parse(image, source, arena);
+    if (status != ImageOk) {
+        output_printf(err, "machdump: {R+}error:{0} %s: %s\n", name,
+                      image_status_message(status));
+        return NULL;
+    }
+    return image;
+}
+
+int mach_diff_sources(struct source* before, const char* before_name,
+                      struct source* after, const char* after_name,
+                      const struct dump_options* options, struct arena* arena,
+                      struct output* out, struct output* err) {
+    struct diff diff;
+    memset(&diff, 0, sizeof(diff));
+    diff.out = out;
+    diff.arena = arena;
+    diff.before = parse(before_name, before, arena, err);
+    diff.after = parse(after_name, after, arena, err);
+    if (!diff.before || !diff.after) {
+        return -1;
+    }
+    struct record_writer records;
+    if (options->format != DumpText) {
+        record_writer_init(&records, out, options->format == DumpJson
+                                          ? RecordJson : RecordBinary);
+        diff.records = &records;
+        record_begin(&records, "diff");
+        record_string(&records, "before", before_name);
+        record_string(&records, "after", after_name);
+        record_end(&records);
+    } else {
+        output_printf(out, "│ {C}Diff{0}\n");
+        output_printf(out, "└─┐ Before: %s\n", before_name);
+        output_printf(out, "  │ After: %s\n", after_name);
+    }
+
+    diff_images(&diff);
+
+    if (diff.records) {
+        record_begin(&records, "diff_summary");
+        record_uint(&records, "differences", diff.differences);
+        record_end(&records);
+        record_writer_free(&records);
+    } else {
+        output_printf(out, "┌─┘ %llu difference(s)\n",
+                      (unsigned long long)diff.differences);
+    }
+    return diff.differences > 0 ? 1 : 0;
+}
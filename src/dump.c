@@ -15,20 +15,33 @@
 // along with machdump. If not, see <https://www.gnu.org/licenses/>.
 
 #include "dump.h"
+#include "arch.h"
+#include "archive.h"
+#include "arena.h"
+#include "cstrings.h"
+#include "dyld.h"
+#include "hash.h"
+#include "hexdump.h"
+#include "image.h"
+#include "jobs.h"
+#include "machdump.h"
+#include "output.h"
+#include "record.h"
+#include "relocs.h"
 #include "safe.h"
-#include "termcolor.h"
-#define printf tcol_printf
-#define fprintf tcol_fprintf
+#include "source.h"
+#include "stats.h"
+#include "symbols.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#define printf(...) output_printf(dump->out, __VA_ARGS__)
+#include <mach-o/fat.h>
 #include <mach-o/loader.h>
 #include <mach-o/nlist.h>
+#include <mach-o/reloc.h>
 
 #define S(...) struct __VA_ARGS__
-#define START_READ() size_t __CUR = 0
-#define READ(n) buffer + __CUR; do { \
-    __CUR += (n); \
-    if (__CUR >= length) return; \
-} while (0)
-#define CONSUME(n) __CUR += (n)
 
 #define PRINT_FLAG(flags, flag) \
     if ((flags) & (flag)) printf(" {+}" #flag "{0}")
@@ -41,28 +54,100 @@
 
 #define local static inline
 
-local const char* argz_get_string(const char* start, size_t index) {
-    const char* next = start;
-    while (index > 0) {
-        while (*next++);
-        start = next + 1;
-        index--;
-    };
-    return start;
+// Everything a decoder needs to render one file. Output goes to `out` rather
+// than stdout so that several files can be rendered concurrently.
+// Command IDs are small integers, some with LC_REQ_DYLD set, so the low seven
+// bits plus that flag give a dense index.
+#define LC_SLOT(cmd) (((cmd) & 0x7f) | (((cmd) & LC_REQ_DYLD) ? 0x80 : 0))
+#define LC_SLOTS 0x100
+
+struct command_count {
+    uint32_t count;
+    uint64_t bytes;
+};
+
+struct dump {
+    struct source* source;
+    struct image* image;
+    const struct dump_options* options;
+    struct output* out;
+    // Set when emitting JSON Lines or binary records instead of text.
+    struct record_writer* records;
+    struct command_count counts[LC_SLOTS];
+    struct command_count unknown;
+    // Set with --stats; everything timed is skipped otherwise.
+    struct stats* stats;
+    // Threads this file may use: 1 when it is itself one of several slices
+    // or members being dumped concurrently.
+    unsigned jobs;
+    struct arena* arena;
+    // Sections by ordinal, counting from 1, for relocation targets. Built
+    // on first use.
+    const struct image_section** ordinals;
+    uint32_t nordinals;
+    // When the load command being rendered started, with --stats.
+    uint64_t command_start;
+};
+
+// Symbol tables are validated lazily, when first rendered, so the time is
+// charged to parsing rather than to the command being rendered.
+local enum image_status parse_symbols(struct dump* dump,
+                                      struct image_command* command) {
+    if (!dump->stats || command->symbols_parsed) {
+        return image_symbols(dump->image, command);
+    }
+    const uint64_t start = stats_now();
+    const enum image_status status = image_symbols(dump->image, command);
+    dump->stats->parse_ns += stats_now() - start;
+    return status;
 }
 
-local void dump_header(void* buffer, S(mach_header_64)* header) {
-    printf("│ {C}Header{0}: {M+}struct {0}mach_header_64\n");
+local void dump_header(struct dump* dump, const S(mach_header_64*) header) {
+    printf("│ {C}Header{0}: {M+}struct {0}%s\n",
+           dump->image->wide ? "mach_header_64" : "mach_header");
     printf("└─┐ Magic: {Y}0x%08x{0}\n", header->magic);
 
     printf("  │ CPU Type: {Y}0x%08x{0}: ", header->cputype);
-    PRINT_OPTION(header->cputype, CPU_TYPE_X86_64);
-    PRINT_OPTION(header->cputype, CPU_TYPE_POWERPC64);
-    PRINT_OPTION(header->cputype, CPU_TYPE_ANY);
+    PRINT_OPTION(header->cputype, CPU_TYPE_X86_64); else
+    PRINT_OPTION(header->cputype, CPU_TYPE_ARM64); else
+    PRINT_OPTION(header->cputype, CPU_TYPE_ARM64_32); else
+    PRINT_OPTION(header->cputype, CPU_TYPE_POWERPC64); else
+    PRINT_OPTION(header->cputype, CPU_TYPE_I386); else
+    PRINT_OPTION(header->cputype, CPU_TYPE_ARM); else
+    PRINT_OPTION(header->cputype, CPU_TYPE_POWERPC); else
+    PRINT_OPTION(header->cputype, CPU_TYPE_ANY); else {
+        printf("Unknown\n");
+    }
 
+    // Subtype values are only meaningful relative to the CPU type.
+    const int32_t subtype = header->cpusubtype & ~CPU_SUBTYPE_MASK;
     printf("  │ CPU Subtype: {Y}0x%08x{0}:", header->cpusubtype);
-    PRINT_OPTION(header->cpusubtype, CPU_SUBTYPE_POWERPC_ALL);
-    PRINT_OPTION(header->cpusubtype, CPU_SUBTYPE_X86_64_ALL);
+    if (header->cputype == CPU_TYPE_X86_64) {
+        PRINT_OPTION(subtype, CPU_SUBTYPE_X86_64_ALL); else
+        PRINT_OPTION(subtype, CPU_SUBTYPE_X86_64_H); else {
+            printf(" Unknown\n");
+        }
+    } else if (header->cputype == CPU_TYPE_ARM64) {
+        PRINT_OPTION(subtype, CPU_SUBTYPE_ARM64_ALL); else
+        PRINT_OPTION(subtype, CPU_SUBTYPE_ARM64E); else {
+            printf(" Unknown\n");
+        }
+    } else if (header->cputype == CPU_TYPE_POWERPC64
+               || header->cputype == CPU_TYPE_POWERPC) {
+        PRINT_OPTION(subtype, CPU_SUBTYPE_POWERPC_ALL); else {
+            printf(" Unknown\n");
+        }
+    } else if (header->cputype == CPU_TYPE_I386) {
+        PRINT_OPTION(subtype, CPU_SUBTYPE_I386_ALL); else {
+            printf(" Unknown\n");
+        }
+    } else if (header->cputype == CPU_TYPE_ARM) {
+        PRINT_OPTION(subtype, CPU_SUBTYPE_ARM_V7); else {
+            printf(" Unknown\n");
+        }
+    } else {
+        printf(" Unknown\n");
+    }
 
     printf("  │ File Type: {Y}0x%08x{0}: ", header->filetype);
     PRINT_OPTION_EXT(header->filetype, MH_OBJECT,
@@ -107,11 +192,132 @@ local void dump_header(void* buffer, S(mach_header_64)* header) {
     if (header->flags == 0) {
         printf(" None");
     }
-    fputc('\n', stdout);
+    output_char(dump->out, '\n');
+}
+
+// Prints every byte of a section for --hexdump, with rows labelled by file
+// offset.
+local void dump_section_contents(struct dump* dump,
+                                 const S(section_64*) sec64) {
+    printf("    │ Contents: %llu byte(s)\n", (unsigned long long)sec64->size);
+    const void* bytes = source_read(dump->source, sec64->offset,
+                                    sec64->size);
+    if (!bytes) {
+        printf("  ┌─┘ {R+}<out of bounds>{0}\n");
+        return;
+    }
+    hexdump(dump->out, "    │ ", bytes, sec64->size, sec64->offset);
+    printf("  ┌─┘\n");
+}
+
+// Relocations are read and unpacked RELOCS_CHUNK entries at a time, so a
+// section's entries take one read however many there are.
+#define RELOCS_CHUNK 256
+#define RELOCS_TARGET_MAX 48
+
+local void find_ordinals(struct dump* dump) {
+    const struct image* image = dump->image;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < image->ncmds; i++) {
+        count += image->commands[i].nsects;
+    }
+    dump->ordinals = arena_alloc(dump->arena, sizeof(*dump->ordinals)
+                                              * (count + 1));
+    for (uint32_t i = 0; i < image->ncmds; i++) {
+        for (uint32_t j = 0; j < image->commands[i].nsects; j++) {
+            dump->ordinals[dump->nordinals++] =
+                &image->commands[i].sections[j];
+        }
+    }
+}
+
+// Returns the symbol an external relocation refers to, or NULL if there is
+// no such symbol. The symbol table is parsed once, on first use.
+local const char* reloc_symbol(struct dump* dump, uint32_t index) {
+    struct image_command* symtab = dump->image->symtab;
+    if (!symtab || parse_symbols(dump, symtab) != ImageOk
+        || index >= symtab->nsyms) {
+        return NULL;
+    }
+    return symtab->symbols[index].name;
+}
+
+local const struct image_section* reloc_section(struct dump* dump,
+                                                uint32_t ordinal) {
+    if (!dump->ordinals) {
+        find_ordinals(dump);
+    }
+    return ordinal > 0 && ordinal <= dump->nordinals
+        ? dump->ordinals[ordinal - 1]
+        : NULL;
+}
+
+// Describes what a relocation refers to, formatting into `buffer` when the
+// description is not already a string in the file.
+local const char* reloc_target(struct dump* dump,
+                               const struct machdump_relocation* reloc,
+                               char* buffer, size_t size) {
+    if (reloc_is_addend(dump->image->header->cputype, reloc->type)) {
+        snprintf(buffer, size, "addend 0x%x", reloc->symbolnum);
+    } else if (reloc->external) {
+        const char* name = reloc_symbol(dump, reloc->symbolnum);
+        if (name) {
+            return name;
+        }
+        snprintf(buffer, size, "symbol %u (invalid)", reloc->symbolnum);
+    } else if (reloc->symbolnum == R_ABS) {
+        return "absolute";
+    } else {
+        const struct image_section* section = reloc_section(dump,
+                                                            reloc->symbolnum);
+        if (section) {
+            snprintf(buffer, size, "%.16s,%.16s", section->header->segname,
+                     section->header->sectname);
+        } else {
+            snprintf(buffer, size, "section %u (invalid)",
+                     reloc->symbolnum);
+        }
+    }
+    return buffer;
+}
+
+local void dump_reloc(struct dump* dump,
+                      const struct machdump_relocation* reloc) {
+    char buffer[RELOCS_TARGET_MAX];
+    const char* target = reloc_target(dump, reloc, buffer, sizeof(buffer));
+    const char* type = reloc_type_name(dump->image->header->cputype,
+                                       reloc->type);
+    if (dump->records) {
+        record_begin(dump->records, "relocation");
+        record_int(dump->records, "address", reloc->address);
+        record_uint(dump->records, "symbolnum", reloc->symbolnum);
+        record_uint(dump->records, "pcrel", reloc->pcrel);
+        record_uint(dump->records, "length", reloc->length);
+        record_uint(dump->records, "extern", reloc->external);
+        record_uint(dump->records, "reloc_type", reloc->type);
+        record_string(dump->records, "name", type ? type : "Unknown");
+        record_string(dump->records, "target", target);
+        record_end(dump->records);
+        return;
+    }
+    printf("    │   {Y}0x%08x{0}: ", (uint32_t)reloc->address);
+    if (type) {
+        printf("%s", type);
+    } else {
+        printf("type %u", reloc->type);
+    }
+    printf("%s, %u byte(s) -> %s\n", reloc->pcrel ? ", pcrel" : "",
+           1u << reloc->length, target);
 }
 
-local void dump_section_64(void* buffer, S(section_64*) sec64) {
-    printf("  │ {C}Section 64{0}: {M+}struct {0}section_64\n");
+local void dump_section_64(struct dump* dump,
+                           const struct image_section* section) {
+    const S(section_64*) sec64 = section->header;
+    if (dump->image->wide) {
+        printf("  │ {C}Section 64{0}: {M+}struct {0}section_64\n");
+    } else {
+        printf("  │ {C}Section{0}: {M+}struct {0}section\n");
+    }
     printf("  └─┐ Section Name: {/}\"%.16s\"{0}\n", sec64->sectname);
     printf("    │ Segment Name: {/}\"%.16s\"{0}\n", sec64->segname);
     printf("    │ Virtual Memory Address: 0x%016llx\n", sec64->addr);
@@ -146,21 +352,76 @@ local void dump_section_64(void* buffer, S(section_64*) sec64) {
     if (sec64->flags == 0) {
         printf("None");
     }
-    fputc('\n', stdout);
+    output_char(dump->out, '\n');
+    if (dump->options->relocs == RelocsAll && section->nreloc > 0) {
+        printf("    │ Relocations: %u\n", section->nreloc);
+    }
+}
+
+// Ends a section, after its relocations, with its contents.
+local void dump_section_end(struct dump* dump,
+                            const struct image_section* section) {
+    const S(section_64*) sec64 = section->header;
+    if (section->contents == ContentsZeroFill) {
+        // Zero-fill sections occupy no space in the file; their offset is
+        // meaningless and is never read.
+        printf("  ┌─┘ Assembly: {/}zero-filled{0}, %llu byte(s)\n",
+               (unsigned long long)sec64->size);
+        return;
+    }
+    if (section->contents == ContentsOutOfBounds) {
+        printf("  ┌─┘ Assembly: {R+}<out of bounds>{0}\n");
+        return;
+    }
+    if (dump->options->hexdump) {
+        dump_section_contents(dump, sec64);
+        return;
+    }
     printf("  ┌─┘ Assembly:");
-    for (uint64_t i = 0; i < sec64->size; i++) {
-        const unsigned char byte = ((char*)buffer + sec64->offset)[i];
-        if (sec64->size > 16 && i > 4 && i < sec64->size - 4) {
-            i = sec64->size - 4;
-            printf(" ...");
-        } else {
-            printf(" 0x%02x", (uint32_t)byte);
+    // Only the bytes that are printed are read, so large sections are never
+    // paged in just to show their first and last few bytes.
+    const int elided = sec64->size > 16;
+    const size_t head = elided ? 5 : (size_t)sec64->size;
+    const size_t tail = elided ? 3 : 0;
+    const unsigned char* first = source_read(dump->source, sec64->offset,
+                                             head);
+    const unsigned char* last = elided
+        ? source_read(dump->source, sec64->offset + sec64->size - tail,
+                      tail)
+        : first + head;
+    if (!first || !last) {
+        printf(" {R+}<out of bounds>{0}\n");
+        return;
+    }
+    for (size_t i = 0; i < head; i++) {
+        printf(" 0x%02x", (uint32_t)first[i]);
+    }
+    if (elided) {
+        printf(" ...");
+        for (size_t i = 0; i < tail; i++) {
+            printf(" 0x%02x", (uint32_t)last[i]);
+        }
+    }
+    output_char(dump->out, '\n');
+}
+
+local int section_selected(const struct dump_options* options,
+                           const S(section_64*) sec64) {
+    if (options->section_count == 0) {
+        return 1;
+    }
+    for (size_t i = 0; i < options->section_count; i++) {
+        const struct section_name* name = &options->sections[i];
+        if (strncmp(name->segname, sec64->segname, 16) == 0
+            && strncmp(name->sectname, sec64->sectname, 16) == 0) {
+            return 1;
         }
     }
-    fputc('\n', stdout);
+    return 0;
 }
 
-local void dump_segment_64(void* buffer, S(segment_command_64*) seg64) {
+local void dump_segment_64(struct dump* dump, struct image_command* command) {
+    const S(segment_command_64*) seg64 = (const void*)command->header;
     printf("  │ Command Size: %u byte(s)\n", seg64->cmdsize);
     printf("  │ Segment Name: {/}\"%.16s\"{0}\n", seg64->segname);
     printf("  │ Virtual Memory Address: {Y}0x%016llx{0}\n", seg64->vmaddr);
@@ -184,20 +445,15 @@ local void dump_segment_64(void* buffer, S(segment_command_64*) seg64) {
     if (seg64->flags == 0) {
         printf(" None");
     }
-    fputc('\n', stdout);
-
-    char* sections = (void*)(seg64 + 1);
-    for (uint32_t i = 0; i < seg64->nsects; i++) {
-        S(section_64*) section = (void*)sections;
-        sections += sizeof(S(section_64));//section->size;
-        dump_section_64(buffer, section);
-    }
-    printf("┌─┘\n");
+    output_char(dump->out, '\n');
 }
 
-local void dumo_nlist64_elem(void* buffer, S(nlist_64*) elem,
-                             const char* symtable) {
-    printf("  │ {C}Symbol{0}: {M+}struct {0}nlist_64\n");
+local void dumo_nlist64_elem(struct dump* dump,
+                             const S(symtab_command*) symt,
+                             const struct image_symbol* symbol) {
+    const S(nlist_64*) elem = symbol->nlist;
+    printf("  │ {C}Symbol{0}: {M+}struct {0}%s\n",
+           dump->image->wide ? "nlist_64" : "nlist");
     printf("  └─┐ Offset in String Table: %u\n", elem->n_un.n_strx);
     printf("    │ Type: {Y}0x%02x{0}:", elem->n_type);
     PRINT_FLAG_EXT(elem->n_type, N_STAB, "(Symbolic Debugging Entry)");
@@ -205,13 +461,13 @@ local void dumo_nlist64_elem(void* buffer, S(nlist_64*) elem,
     PRINT_FLAG_EXT(elem->n_type, N_EXT, "(External Symbol)");
 
     const uint32_t actual_type = (elem->n_type & N_TYPE);
-    fputc(' ', stdout);
+    output_char(dump->out, ' ');
     PRINT_OPTION_EXT(actual_type, N_SECT, "(Defined in Section)"); else
     PRINT_OPTION_EXT(actual_type, N_INDR, "(Indirect)"); else
     PRINT_OPTION_EXT(actual_type, N_PBUD, "(Prebound)"); else
     PRINT_OPTION_EXT(actual_type, N_ABS, "(Absolute)"); else
     PRINT_OPTION_EXT(actual_type, N_UNDF, "(Undefined)"); else {
-        fputc('\n', stdout);
+        output_char(dump->out, '\n');
     }
 
     printf("    │ Section Location: ");
@@ -223,13 +479,18 @@ local void dumo_nlist64_elem(void* buffer, S(nlist_64*) elem,
     printf("    │ Description: {Y}0x%04x{0}\n", elem->n_desc);
     printf("    │ Address of Symbol in Assembly: {Y}0x%08x{0}\n",
            elem->n_value);
-    const char* symbol = symtable + elem->n_un.n_strx;
-    printf("  ┌─┘ String: offset {Y}0x%016lx{0}: {/}\"%s\"{0}\n", (void*)symbol - buffer,
-           symbol);
-
+    printf("  ┌─┘ String: offset {Y}0x%016lx{0}: ",
+           (unsigned long)symt->stroff + elem->n_un.n_strx);
+    if (symbol->name) {
+        printf("{/}\"%s\"{0}\n", symbol->name);
+    } else {
+        printf("{R+}<out of bounds>{0}\n");
+    }
 }
 
-local void dump_symbol_table(void* buffer, S(symtab_command*) symt) {
+local void dump_symbol_table(struct dump* dump,
+                              struct image_command* command) {
+    const S(symtab_command*) symt = (const void*)command->header;
     printf("  │ Command Size: %u byte(s)\n", symt->cmdsize);
     printf("  │ Symbol Table Offset: %u byte(s)\n", symt->symoff);
     printf("  │ Number of Symbols: %u\n", symt->nsyms);
@@ -240,15 +501,189 @@ local void dump_symbol_table(void* buffer, S(symtab_command*) symt) {
         printf("┌─┘ ");
     }
     printf("String Table Size: %u byte(s)\n", symt->strsize);
-    S(nlist_64*) syms = (void*)((char*)buffer + symt->symoff);
-    char* strtbl = (char*)buffer + symt->stroff;
-    for (uint32_t i = 0; i < symt->nsyms; i++) {
-        dumo_nlist64_elem(buffer, syms + i, strtbl);
+    if (parse_symbols(dump, command) != ImageOk) {
+        printf("  │ {R+}Symbol or string table out of bounds{0}\n");
+    }
+}
+
+// LC_DYSYMTAB splits the symbol table into three runs: local symbols,
+// defined external symbols and undefined ones. Each run is checked against
+// the types of the symbols in it.
+enum symbol_range {
+    RangeLocal,
+    RangeExternal,
+    RangeUndefined
+};
+
+local int symbol_in_range(enum symbol_range range, uint8_t type) {
+    const uint8_t kind = type & N_TYPE;
+    const int undefined = kind == N_UNDF || kind == N_PBUD;
+    if (range == RangeLocal || (type & N_STAB)) {
+        return range == RangeLocal && !(type & N_EXT);
+    } else if (range == RangeExternal) {
+        return (type & N_EXT) && !undefined;
+    }
+    return (type & N_EXT) && undefined;
+}
+
+local void dump_symbol_ranges(struct dump* dump,
+                              struct image_command* command) {
+    const S(dysymtab_command*) dsymt = (const void*)command->header;
+    const struct {
+        const char* title;
+        const char* kind;
+        uint32_t first, count;
+    } ranges[] = {
+        [RangeLocal] = { "Local", "local", dsymt->ilocalsym,
+                         dsymt->nlocalsym },
+        [RangeExternal] = { "External", "external", dsymt->iextdefsym,
+                            dsymt->nextdefsym },
+        [RangeUndefined] = { "Undefined", "undefined", dsymt->iundefsym,
+                             dsymt->nundefsym },
+    };
+    struct image_command* symtab = dump->image->symtab;
+    const int parsed = symtab && parse_symbols(dump, symtab) == ImageOk;
+    int outside = 0;
+    for (size_t i = 0; i < sizeof(ranges) / sizeof(*ranges); i++) {
+        const uint32_t first = ranges[i].first;
+        const uint32_t count = ranges[i].count;
+        const int inside = parsed && first <= symtab->nsyms
+                           && count <= symtab->nsyms - first;
+        uint32_t mismatched = 0;
+        for (uint32_t j = 0; inside && j < count; j++) {
+            mismatched += !symbol_in_range((enum symbol_range)i,
+                symtab->symbols[first + j].nlist->n_type);
+        }
+        outside |= parsed && !inside && count > 0;
+        if (dump->records) {
+            record_begin(dump->records, "symbol_range");
+            record_string(dump->records, "kind", ranges[i].kind);
+            record_uint(dump->records, "first", first);
+            record_uint(dump->records, "count", count);
+            if (inside) {
+                record_uint(dump->records, "mismatched", mismatched);
+            }
+            record_end(dump->records);
+            continue;
+        }
+        printf("  │ %s Symbols: %u from index %u", ranges[i].title, count,
+               first);
+        if (parsed && !inside && count > 0) {
+            printf(" {R+}(outside the symbol table){0}");
+        } else if (mismatched > 0) {
+            printf(" {R+}(%u not %s){0}", mismatched, ranges[i].kind);
+        }
+        printf("\n");
+    }
+    if (outside) {
+        image_add_error(dump->image, ImageBadSymbolRanges,
+                        (uint32_t)(command - dump->image->commands),
+                        command->offset);
+    }
+}
+
+// Stub and symbol pointer sections have one entry in the indirect symbol
+// table per slot, starting at the entry in reserved1. Returns the size of
+// a slot, or 0 for sections without indirect symbols.
+local uint32_t indirect_stride(const struct image* image,
+                              const S(section_64*) sec64) {
+    switch (sec64->flags & SECTION_TYPE) {
+        case S_SYMBOL_STUBS:
+            return sec64->reserved2;
+        case S_NON_LAZY_SYMBOL_POINTERS:
+        case S_LAZY_SYMBOL_POINTERS:
+        case S_LAZY_DYLIB_SYMBOL_POINTERS:
+        case S_THREAD_LOCAL_VARIABLE_POINTERS:
+            return image->wide ? sizeof(uint64_t) : sizeof(uint32_t);
+    }
+    return 0;
+}
+
+local void dump_indirect_symbol(struct dump* dump,
+                                const S(section_64*) sec64, uint32_t slot,
+                                uint32_t index, uint32_t entry) {
+    const uint64_t address = sec64->addr
+                             + (uint64_t)slot * indirect_stride(dump->image,
+                                                                sec64);
+    const char* name = entry == INDIRECT_SYMBOL_LOCAL
+        ? "INDIRECT_SYMBOL_LOCAL"
+        : entry == INDIRECT_SYMBOL_ABS ? "INDIRECT_SYMBOL_ABS"
+        : entry == (INDIRECT_SYMBOL_LOCAL | INDIRECT_SYMBOL_ABS)
+        ? "INDIRECT_SYMBOL_LOCAL INDIRECT_SYMBOL_ABS"
+        : NULL;
+    const int special = name != NULL;
+    if (!special) {
+        name = reloc_symbol(dump, entry);
+    }
+    if (dump->records) {
+        record_begin(dump->records, "indirect_symbol");
+        record_uint(dump->records, "index", index);
+        record_string_n(dump->records, "segname", sec64->segname, 16);
+        record_string_n(dump->records, "sectname", sec64->sectname, 16);
+        record_uint(dump->records, "address", address);
+        record_uint(dump->records, "symbol", entry);
+        record_string(dump->records, "name", name ? name : "");
+        record_end(dump->records);
+        return;
+    }
+    printf("  │ {Y}0x%016llx{0}: %.16s,%.16s[%u] -> ",
+           (unsigned long long)address, sec64->segname, sec64->sectname,
+           slot);
+    if (special) {
+        printf("{+}%s{0}\n", name);
+    } else if (name) {
+        printf("%s\n", name);
+    } else {
+        printf("{R+}symbol %u (invalid){0}\n", entry);
+    }
+}
+
+// Joins each stub and pointer slot to its symbol. Names are looked up by
+// index in the parsed symbol table, so this is one pass over the slots.
+local void dump_indirect_symbols(struct dump* dump,
+                                 struct image_command* command) {
+    struct image* image = dump->image;
+    const S(dysymtab_command*) dsymt = (const void*)command->header;
+    const uint32_t count = dsymt->nindirectsyms;
+    if (!dump->records) {
+        printf("  │ Indirect Symbols: %u\n", count);
+    }
+    if (count == 0) {
+        return;
+    }
+    const uint32_t* table = image_indirect_symbols(image, command);
+    if (!table) {
+        image_add_error(image, ImageIndirectSymbolsOutOfBounds,
+                        (uint32_t)(command - image->commands),
+                        dsymt->indirectsymoff);
+        return;
+    }
+    for (uint32_t i = 0; i < image->ncmds; i++) {
+        const struct image_command* segment = &image->commands[i];
+        for (uint32_t j = 0; j < segment->nsects; j++) {
+            const S(section_64*) sec64 = segment->sections[j].header;
+            const uint32_t stride = indirect_stride(image, sec64);
+            if (stride == 0) {
+                continue;
+            }
+            const uint64_t slots = sec64->size / stride;
+            const uint32_t first = sec64->reserved1;
+            if (first > count || slots > count - first) {
+                image_add_error(image, ImageBadIndirectRange, i,
+                                segment->offset);
+                continue;
+            }
+            for (uint32_t k = 0; k < slots; k++) {
+                dump_indirect_symbol(dump, sec64, k, first + k,
+                                     table[first + k]);
+            }
+        }
     }
-    printf("┌─┘\n");
 }
 
-local void dump_dysym_table(void* buffer, S(dysymtab_command*) dsymt) {
+local void dump_dysym_table(struct dump* dump,
+                             struct image_command* command) {
+    const S(dysymtab_command*) dsymt = (const void*)command->header;
     printf("  │ Command Size: %u byte(s)\n", dsymt->cmdsize);
     printf("  │ Index of first local symbol: %u\n", dsymt->ilocalsym);
     printf("  │ Number of local symbols: %u\n", dsymt->nlocalsym);
@@ -274,8 +709,11 @@ local void dump_dysym_table(void* buffer, S(dysymtab_command*) dsymt) {
     printf("  │ Number of entries in external relocation table: %u\n",
            dsymt->nextrel);
     printf("  │ File offset of local relocation table: %u\n", dsymt->locreloff);
-    printf("┌─┘ Number of entries in local relocation table: %u\n",
+    printf("  │ Number of entries in local relocation table: %u\n",
            dsymt->nlocrel);
+    dump_symbol_ranges(dump, command);
+    dump_indirect_symbols(dump, command);
+    printf("┌─┘\n");
 //    if (symt->nsyms > 0) {
 //        printf("  │ ");
 //    } else {
@@ -284,7 +722,9 @@ local void dump_dysym_table(void* buffer, S(dysymtab_command*) dsymt) {
 //    printf("┌─┘\n");
 }
 
-local void dump_build_version(void* buffer, S(build_version_command*) bver) {
+local void dump_build_version(struct dump* dump,
+                               struct image_command* command) {
+    const S(build_version_command*) bver = (const void*)command->header;
     printf("  │ Command Size: %u byte(s)\n", bver->cmdsize);
     printf("  │ Platform: {Y]0x%08x{0}\n", bver->platform);
     printf("  │ Minimum OS: {Y}0x%08x{0}: %u.%u.%u\n", bver->minos, bver->minos >> 16,
@@ -294,92 +734,2501 @@ local void dump_build_version(void* buffer, S(build_version_command*) bver) {
     printf("┌─┘ Number of build tools: %u\n", bver->ntools);
 }
 
-local void dump_load_command(void* buffer, S(load_command*) load_command) {
+local void dump_dyld_info(struct dump* dump, struct image_command* command) {
+    const S(dyld_info_command*) info = (const void*)command->header;
+    printf("  │ Command Size: %u byte(s)\n", info->cmdsize);
+    printf("  │ Rebase Info: %u byte(s) at offset %u\n", info->rebase_size,
+           info->rebase_off);
+    printf("  │ Bind Info: %u byte(s) at offset %u\n", info->bind_size,
+           info->bind_off);
+    printf("  │ Weak Bind Info: %u byte(s) at offset %u\n",
+           info->weak_bind_size, info->weak_bind_off);
+    printf("  │ Lazy Bind Info: %u byte(s) at offset %u\n",
+           info->lazy_bind_size, info->lazy_bind_off);
+    printf("┌─┘ Export Info: %u byte(s) at offset %u\n", info->export_size,
+           info->export_off);
+}
+
+// Structured output. Each renderer above has an emitter here that writes the
+// same fields as records; see record.h for the formats.
+
+local void emit_header(struct dump* dump, const S(mach_header_64*) header) {
+    struct record_writer* records = dump->records;
+    record_begin(records, "header");
+    record_uint(records, "magic", header->magic);
+    record_int(records, "cputype", header->cputype);
+    record_int(records, "cpusubtype", header->cpusubtype);
+    record_uint(records, "filetype", header->filetype);
+    record_uint(records, "ncmds", header->ncmds);
+    record_uint(records, "sizeofcmds", header->sizeofcmds);
+    record_uint(records, "flags", header->flags);
+    record_end(records);
+}
+
+local void emit_section_64(struct dump* dump,
+                           const struct image_section* section) {
+    struct record_writer* records = dump->records;
+    const S(section_64*) sec64 = section->header;
+    record_begin(records, "section");
+    record_string_n(records, "sectname", sec64->sectname, 16);
+    record_string_n(records, "segname", sec64->segname, 16);
+    record_uint(records, "addr", sec64->addr);
+    record_uint(records, "size", sec64->size);
+    record_uint(records, "offset", sec64->offset);
+    record_uint(records, "align", sec64->align);
+    record_uint(records, "reloff", sec64->reloff);
+    record_uint(records, "nreloc", sec64->nreloc);
+    record_uint(records, "flags", sec64->flags);
+    record_uint(records, "reserved1", sec64->reserved1);
+    record_uint(records, "reserved2", sec64->reserved2);
+    record_end(records);
+}
+
+local void emit_segment_64(struct dump* dump, struct image_command* command) {
+    struct record_writer* records = dump->records;
+    const S(segment_command_64*) seg64 = (const void*)command->header;
+    record_begin(records, "segment");
+    record_string_n(records, "segname", seg64->segname, 16);
+    record_uint(records, "vmaddr", seg64->vmaddr);
+    record_uint(records, "vmsize", seg64->vmsize);
+    record_uint(records, "fileoff", seg64->fileoff);
+    record_uint(records, "filesize", seg64->filesize);
+    record_int(records, "maxprot", seg64->maxprot);
+    record_int(records, "initprot", seg64->initprot);
+    record_uint(records, "nsects", seg64->nsects);
+    record_uint(records, "flags", seg64->flags);
+    record_end(records);
+}
+
+local void emit_nlist64_elem(struct dump* dump,
+                             const struct image_symbol* symbol,
+                             uint32_t index) {
+    struct record_writer* records = dump->records;
+    const S(nlist_64*) elem = symbol->nlist;
+    const uint32_t strx = elem->n_un.n_strx;
+    record_begin(records, "symbol");
+    record_uint(records, "index", index);
+    record_uint(records, "n_strx", strx);
+    record_uint(records, "n_type", elem->n_type);
+    record_uint(records, "n_sect", elem->n_sect);
+    record_uint(records, "n_desc", elem->n_desc);
+    record_uint(records, "n_value", elem->n_value);
+    record_string(records, "name", symbol->name ? symbol->name : "");
+    record_end(records);
+}
+
+local void emit_symbol_table(struct dump* dump,
+                              struct image_command* command) {
+    struct record_writer* records = dump->records;
+    const S(symtab_command*) symt = (const void*)command->header;
+    record_begin(records, "symtab");
+    record_uint(records, "symoff", symt->symoff);
+    record_uint(records, "nsyms", symt->nsyms);
+    record_uint(records, "stroff", symt->stroff);
+    record_uint(records, "strsize", symt->strsize);
+    record_end(records);
+    parse_symbols(dump, command);
+}
+
+local void emit_dysym_table(struct dump* dump,
+                             struct image_command* command) {
+    struct record_writer* records = dump->records;
+    const S(dysymtab_command*) dsymt = (const void*)command->header;
+    record_begin(records, "dysymtab");
+    record_uint(records, "ilocalsym", dsymt->ilocalsym);
+    record_uint(records, "nlocalsym", dsymt->nlocalsym);
+    record_uint(records, "iextdefsym", dsymt->iextdefsym);
+    record_uint(records, "nextdefsym", dsymt->nextdefsym);
+    record_uint(records, "iundefsym", dsymt->iundefsym);
+    record_uint(records, "nundefsym", dsymt->nundefsym);
+    record_uint(records, "tocoff", dsymt->tocoff);
+    record_uint(records, "ntoc", dsymt->ntoc);
+    record_uint(records, "modtaboff", dsymt->modtaboff);
+    record_uint(records, "nmodtab", dsymt->nmodtab);
+    record_uint(records, "extrefsymoff", dsymt->extrefsymoff);
+    record_uint(records, "nextrefsyms", dsymt->nextrefsyms);
+    record_uint(records, "indirectsymoff", dsymt->indirectsymoff);
+    record_uint(records, "nindirectsyms", dsymt->nindirectsyms);
+    record_uint(records, "extreloff", dsymt->extreloff);
+    record_uint(records, "nextrel", dsymt->nextrel);
+    record_uint(records, "locreloff", dsymt->locreloff);
+    record_uint(records, "nlocrel", dsymt->nlocrel);
+    record_end(records);
+    dump_symbol_ranges(dump, command);
+    dump_indirect_symbols(dump, command);
+}
+
+local void emit_build_version(struct dump* dump,
+                               struct image_command* command) {
+    struct record_writer* records = dump->records;
+    const S(build_version_command*) bver = (const void*)command->header;
+    record_begin(records, "build_version");
+    record_uint(records, "platform", bver->platform);
+    record_uint(records, "minos", bver->minos);
+    record_uint(records, "sdk", bver->sdk);
+    record_uint(records, "ntools", bver->ntools);
+    record_end(records);
+}
+
+local void emit_dyld_info(struct dump* dump, struct image_command* command) {
+    struct record_writer* records = dump->records;
+    const S(dyld_info_command*) info = (const void*)command->header;
+    record_begin(records, "dyld_info");
+    record_uint(records, "rebase_off", info->rebase_off);
+    record_uint(records, "rebase_size", info->rebase_size);
+    record_uint(records, "bind_off", info->bind_off);
+    record_uint(records, "bind_size", info->bind_size);
+    record_uint(records, "weak_bind_off", info->weak_bind_off);
+    record_uint(records, "weak_bind_size", info->weak_bind_size);
+    record_uint(records, "lazy_bind_off", info->lazy_bind_off);
+    record_uint(records, "lazy_bind_size", info->lazy_bind_size);
+    record_uint(records, "export_off", info->export_off);
+    record_uint(records, "export_size", info->export_size);
+    record_end(records);
+}
+
+// Load commands are dispatched through a table indexed by command ID; see
+// LC_SLOT. Commands without a decoder only print their name.
+struct load_command_decoder {
+    uint32_t cmd;
+    const char* name;
+    const char* type;
+    void (*decode)(struct dump* dump, struct image_command* command);
+    void (*emit)(struct dump* dump, struct image_command* command);
+    uint64_t (*extent)(const struct image* image, const void* command);
+};
+
+local uint64_t segment_64_extent(const struct image* image,
+                                 const void* command) {
+    (void)image;
+    return ((const S(segment_command_64*))command)->filesize;
+}
+
+local uint64_t symtab_extent(const struct image* image,
+                             const void* command) {
+    const S(symtab_command*) symt = command;
+    return (uint64_t)symt->nsyms * image_nlist_size(image) + symt->strsize;
+}
+
+local uint64_t linkedit_data_extent(const struct image* image,
+                                    const void* command) {
+    (void)image;
+    return ((const S(linkedit_data_command*))command)->datasize;
+}
+
+local uint64_t dyld_info_extent(const struct image* image,
+                                const void* command) {
+    const S(dyld_info_command*) info = command;
+    (void)image;
+    return (uint64_t)info->rebase_size + info->bind_size
+           + info->weak_bind_size + info->lazy_bind_size + info->export_size;
+}
+
+#define DECODER(cmd, type, ...) \
+    [LC_SLOT(cmd)] = { cmd, #cmd, type, __VA_ARGS__ }
+
+static const struct load_command_decoder decoders[LC_SLOTS] = {
+    DECODER(LC_UUID, "uuid_command", NULL, NULL, NULL),
+    DECODER(LC_SEGMENT, "segment_command", dump_segment_64, emit_segment_64,
+            segment_64_extent),
+    DECODER(LC_SEGMENT_64, "segment_command_64", dump_segment_64,
+            emit_segment_64, segment_64_extent),
+    DECODER(LC_SYMTAB, "symtab_command", dump_symbol_table,
+            emit_symbol_table, symtab_extent),
+    DECODER(LC_DYSYMTAB, "dysymtab_command", dump_dysym_table,
+            emit_dysym_table, NULL),
+    DECODER(LC_THREAD, "thread_command", NULL, NULL, NULL),
+    DECODER(LC_UNIXTHREAD, "thread_command", NULL, NULL, NULL),
+    DECODER(LC_LOAD_DYLIB, "dylib_command", NULL, NULL, NULL),
+    DECODER(LC_LOAD_WEAK_DYLIB, "dylib_command", NULL, NULL, NULL),
+    DECODER(LC_REEXPORT_DYLIB, "dylib_command", NULL, NULL, NULL),
+    DECODER(LC_LOAD_UPWARD_DYLIB, "dylib_command", NULL, NULL, NULL),
+    DECODER(LC_ID_DYLIB, "dylib_command", NULL, NULL, NULL),
+    DECODER(LC_PREBOUND_DYLIB, "prebound_dylib_command", NULL, NULL, NULL),
+    DECODER(LC_LOAD_DYLINKER, "dylinker_command", NULL, NULL, NULL),
+    DECODER(LC_ID_DYLINKER, "dylinker_command", NULL, NULL, NULL),
+    DECODER(LC_ROUTINES, "routines_command", NULL, NULL, NULL),
+    DECODER(LC_ROUTINES_64, "routines_command_64", NULL, NULL, NULL),
+    DECODER(LC_TWOLEVEL_HINTS, "twolevel_hints_command", NULL, NULL, NULL),
+    DECODER(LC_SUB_FRAMEWORK, "sub_framework_command", NULL, NULL, NULL),
+    DECODER(LC_SUB_UMBRELLA, "sub_umbrella_command", NULL, NULL, NULL),
+    DECODER(LC_SUB_LIBRARY, "sub_library_command", NULL, NULL, NULL),
+    DECODER(LC_SUB_CLIENT, "sub_client_command", NULL, NULL, NULL),
+    DECODER(LC_DYLD_INFO, "dyld_info_command", dump_dyld_info,
+            emit_dyld_info, dyld_info_extent),
+    DECODER(LC_DYLD_INFO_ONLY, "dyld_info_command", dump_dyld_info,
+            emit_dyld_info, dyld_info_extent),
+    DECODER(LC_VERSION_MIN_MACOSX, "version_min_command", NULL, NULL, NULL),
+    DECODER(LC_SOURCE_VERSION, "source_version_command", NULL, NULL, NULL),
+    DECODER(LC_MAIN, "entry_point_command", NULL, NULL, NULL),
+    DECODER(LC_FUNCTION_STARTS, "linkedit_data_command", NULL, NULL,
+            linkedit_data_extent),
+    DECODER(LC_DATA_IN_CODE, "linkedit_data_command", NULL, NULL,
+            linkedit_data_extent),
+    DECODER(LC_CODE_SIGNATURE, "linkedit_data_command", NULL, NULL,
+            linkedit_data_extent),
+    DECODER(LC_DYLD_EXPORTS_TRIE, "linkedit_data_command", NULL, NULL,
+            linkedit_data_extent),
+    DECODER(LC_DYLD_CHAINED_FIXUPS, "linkedit_data_command", NULL, NULL,
+            linkedit_data_extent),
+    DECODER(LC_LAZY_LOAD_DYLIB, "dylib_command", NULL, NULL, NULL),
+    DECODER(LC_BUILD_VERSION, "build_version_command", dump_build_version,
+            emit_build_version, NULL),
+    #ifdef LC_SYMSEG
+    DECODER(LC_SYMSEG, "symseg_command", NULL, NULL, NULL),
+    #endif
+};
+
+local const struct load_command_decoder* find_decoder(uint32_t cmd) {
+    if ((cmd & ~(LC_REQ_DYLD | 0x7f)) != 0) {
+        return NULL;
+    }
+    const struct load_command_decoder* decoder = &decoders[LC_SLOT(cmd)];
+    return decoder->name && decoder->cmd == cmd ? decoder : NULL;
+}
+
+const char* load_command_name(uint32_t cmd) {
+    const struct load_command_decoder* decoder = find_decoder(cmd);
+    return decoder ? decoder->name : NULL;
+}
+
+int load_command_from_name(const char* name, uint32_t* cmd) {
+    for (size_t i = 0; i < LC_SLOTS; i++) {
+        if (decoders[i].name && strcmp(decoders[i].name, name) == 0) {
+            *cmd = decoders[i].cmd;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+local void count_load_command(struct dump* dump,
+                              const struct image_command* command) {
+    const S(load_command*) load_command = command->header;
+    const struct load_command_decoder* decoder =
+        find_decoder(load_command->cmd);
+    struct command_count* count = decoder
+        ? &dump->counts[LC_SLOT(load_command->cmd)]
+        : &dump->unknown;
+    count->count++;
+    count->bytes += load_command->cmdsize;
+    if (decoder && decoder->extent && !command->truncated) {
+        count->bytes += decoder->extent(dump->image, load_command);
+    }
+}
+
+// Decides from the load command alone whether it is wanted, so filtered
+// commands are skipped without decoding or reading the data they reference.
+local int command_selected(const struct dump_options* options,
+                           const struct image_command* command) {
+    if (options->command_count == 0 && options->section_count == 0) {
+        return 1;
+    }
+    for (size_t i = 0; i < options->command_count; i++) {
+        if (options->commands[i] == command->header->cmd) {
+            return 1;
+        }
+    }
+    // section_selected accepts everything when no sections are listed, so
+    // segments are only picked for their sections when some are.
+    if (options->section_count == 0) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < command->nsects; i++) {
+        if (section_selected(options, command->sections[i].header)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+local void emit_load_command(struct dump* dump,
+                             struct image_command* command) {
+    struct record_writer* records = dump->records;
+    const S(load_command*) load_command = command->header;
+    const struct load_command_decoder* decoder =
+        find_decoder(load_command->cmd);
+    record_begin(records, "load_command");
+    record_uint(records, "offset", command->offset);
+    record_uint(records, "cmd", load_command->cmd);
+    record_string(records, "name", decoder ? decoder->name : "Unknown");
+    record_uint(records, "cmdsize", load_command->cmdsize);
+    record_end(records);
+    if (decoder && decoder->emit && !command->truncated) {
+        decoder->emit(dump, command);
+    }
+}
+
+local void dump_load_command(struct dump* dump,
+                             struct image_command* command) {
+    if (dump->records) {
+        emit_load_command(dump, command);
+        return;
+    }
+    const S(load_command*) load_command = command->header;
     printf("│ {C}Load Command{0} (at offset {Y}0x%016lx{0})\n",
-           (void*)load_command - buffer);
+           (unsigned long)command->offset);
     printf("└─┐ Command Type: {Y}0x%08x{0}: ", load_command->cmd);
 
-    if (load_command->cmd == LC_UUID) {
-        printf("LC_UUID: struct uuid_command\n");
-    } else if (load_command->cmd == LC_SEGMENT) {
-        printf("LC_SEGMENT: struct segment_command\n");
-    } else if (load_command->cmd == LC_SEGMENT_64) {
-        printf("{+}LC_SEGMENT_64{0}: {M+}struct {0}segment_command_64\n");
-        dump_segment_64(buffer, (S(segment_command_64*))load_command);
-    } else if (load_command->cmd == LC_SYMTAB) {
-        printf("{+}LC_SYMTAB{0}: {M+}struct {0}symtab_command\n");
-        dump_symbol_table(buffer, (S(symtab_command*))load_command);
-    } else if (load_command->cmd == LC_DYSYMTAB) {
-        printf("{+}LC_DYSYMTAB{0}: {M+}struct {0}dysymtab_command\n");
-        dump_dysym_table(buffer, (S(dysymtab_command*))load_command);
-    } else if (load_command->cmd == LC_THREAD) {
-        printf("LC_THREAD: struct thread_command\n");
-    } else if (load_command->cmd == LC_UNIXTHREAD) {
-        printf("LC_UNIXTHREAD: struct thread_command\n");
-    } else if (load_command->cmd == LC_LOAD_DYLIB) {
-        printf("LC_LOAD_DYLIB: struct dylib_command\n");
-    } else if (load_command->cmd == LC_ID_DYLIB) {
-        printf("LC_ID_DYLIB: struct dylib_command\n");
-    } else if (load_command->cmd == LC_PREBOUND_DYLIB) {
-        printf("LC_PREBOUND_DYLIB: struct prebound_dylib_command\n");
-    } else if (load_command->cmd == LC_LOAD_DYLINKER) {
-        printf("LC_LOAD_DYLINKER: struct dylinker_command\n");
-    } else if (load_command->cmd == LC_ID_DYLINKER) {
-        printf("LC_ID_DYLINKER: struct dylinker_command\n");
-    } else if (load_command->cmd == LC_ROUTINES) {
-        printf("LC_ROUTINES: struct routines_command\n");
-    } else if (load_command->cmd == LC_ROUTINES_64) {
-        printf("LC_ROUTINES_64: struct routines_command_64\n");
-    } else if (load_command->cmd == LC_TWOLEVEL_HINTS) {
-        printf("LC_TWOLEVEL_HINTS: struct twolevel_hints_command\n");
-    } else if (load_command->cmd == LC_SUB_FRAMEWORK) {
-        printf("LC_SUB_FRAMEWORK: struct sub_framework_command\n");
-    } else if (load_command->cmd == LC_SUB_UMBRELLA) {
-        printf("LC_SUB_UMBRELLA: struct sub_umbrella_command\n");
-    } else if (load_command->cmd == LC_SUB_LIBRARY) {
-        printf("LC_SUB_LIBRARY: struct sub_library_command\n");
-    } else if (load_command->cmd == LC_SUB_CLIENT) {
-        printf("LC_SUB_CLIENT: struct sub_client_command\n");
-    } else if (load_command->cmd == LC_DYLD_INFO_ONLY) {
-        printf("LC_DYLD_INFO_ONLY\n");
-    } else if (load_command->cmd == LC_VERSION_MIN_MACOSX) {
-        printf("LC_VERSION_MIN_MACOSX: struct version_min_command\n");
-    } else if (load_command->cmd == LC_SOURCE_VERSION) {
-        printf("LC_SOURCE_VERSION: struct source_version_command\n");
-    } else if (load_command->cmd == LC_MAIN) {
-        printf("LC_MAIN\n");
-    } else if (load_command->cmd == LC_FUNCTION_STARTS) {
-        printf("FUNCTION_STARTS\n");
-    } else if (load_command->cmd == LC_LAZY_LOAD_DYLIB) {
-        printf("LC_LAZY_LOAD_DYLIB\n");
-    } else if (load_command->cmd == LC_BUILD_VERSION) {
-        printf("{+}LC_BUILD_VERSION{0}: {M+}struct {0}build_version_command\n");
-        dump_build_version(buffer, (S(build_version_command*))load_command);
+    const struct load_command_decoder* decoder =
+        find_decoder(load_command->cmd);
+    if (!decoder) {
+        printf("Unknown\r├──\n");
+    } else if (command->truncated) {
+        printf("%s: struct %s {R+}<truncated>{0}\n", decoder->name,
+               decoder->type);
+    } else if (decoder->decode) {
+        printf("{+}%s{0}: {M+}struct {0}%s\n", decoder->name, decoder->type);
+        decoder->decode(dump, command);
+    } else {
+        printf("%s: struct %s\n", decoder->name, decoder->type);
+    }
+}
+
+local int compare_counts(const void* lhs, const void* rhs) {
+    const struct command_count* a = *(const struct command_count* const*)lhs;
+    const struct command_count* b = *(const struct command_count* const*)rhs;
+    return (a->bytes < b->bytes) - (a->bytes > b->bytes);
+}
+
+local void dump_summary(struct dump* dump) {
+    const struct command_count* seen[LC_SLOTS + 1];
+    size_t n = 0;
+    for (size_t i = 0; i < LC_SLOTS; i++) {
+        if (dump->counts[i].count > 0) {
+            seen[n++] = &dump->counts[i];
+        }
     }
+    if (dump->unknown.count > 0) {
+        seen[n++] = &dump->unknown;
+    }
+    qsort(seen, n, sizeof(*seen), compare_counts);
 
-    #ifdef LC_SYMSEG
-    else if (load_command->cmd == LC_SYMSEG) {
-        printf("LC_SYMSEG: struct symseg_command\n");
+    if (dump->records) {
+        for (size_t i = 0; i < n; i++) {
+            const int known = seen[i] != &dump->unknown;
+            record_begin(dump->records, "command_summary");
+            record_string(dump->records, "name", known
+                          ? decoders[seen[i] - dump->counts].name
+                          : "Unknown");
+            record_uint(dump->records, "count", seen[i]->count);
+            record_uint(dump->records, "bytes", seen[i]->bytes);
+            record_end(dump->records);
+        }
+        return;
     }
-    #endif
-    else {
-        printf("Unknown\r├──\n");
+    printf("│ {C}Load Command Summary{0}\n");
+    printf("└─┐ Commands by size (command plus referenced data)\n");
+    for (size_t i = 0; i < n; i++) {
+        const struct load_command_decoder* decoder = seen[i] == &dump->unknown
+            ? NULL
+            : &decoders[seen[i] - dump->counts];
+        printf("  │ {+}%s{0}: %u command(s), %llu byte(s)\n",
+               decoder ? decoder->name : "Unknown", seen[i]->count,
+               (unsigned long long)seen[i]->bytes);
     }
+    printf("┌─┘\n");
 }
 
-void mach_dump(void* buffer, const size_t length) {
-    START_READ();
+#define RELOCS_TOP 10
+
+struct reloc_count {
+    // A symbol index if `external` is set, otherwise a section ordinal.
+    uint32_t index;
+    int external;
+    uint64_t count;
+};
+
+local int compare_reloc_counts(const void* lhs, const void* rhs) {
+    const struct reloc_count* a = lhs;
+    const struct reloc_count* b = rhs;
+    if (a->count != b->count) {
+        return a->count < b->count ? 1 : -1;
+    } else if (a->external != b->external) {
+        return b->external - a->external;
+    }
+    return a->index < b->index ? -1 : a->index > b->index;
+}
 
-    S(mach_header_64*) header = READ(sizeof(*header));
-    if (header->magic != MH_MAGIC_64) {
-        fprintf(stderr, "machdump: {R+}error:{0} Expected 64 bit mach-o file\n");
+struct reloc_totals {
+    uint64_t total;
+    uint64_t sections;
+    uint64_t types[16];
+    // Indexed by symbol and by section ordinal.
+    uint64_t* symbols;
+    uint32_t nsyms;
+    uint64_t* ordinals;
+    uint64_t invalid;
+};
+
+local void count_relocs(struct dump* dump, struct reloc_totals* totals,
+                        const struct image_section* section) {
+    const unsigned char* bytes = (const void*)image_relocations(dump->image,
+                                                                section);
+    if (!bytes) {
         return;
     }
-    dump_header(buffer, header);
+    const int32_t cputype = dump->image->header->cputype;
+    totals->total += section->nreloc;
+    totals->sections++;
+    struct machdump_relocation relocs[RELOCS_CHUNK];
+    for (uint32_t i = 0; i < section->nreloc; i += RELOCS_CHUNK) {
+        const uint32_t count = section->nreloc - i < RELOCS_CHUNK
+            ? section->nreloc - i : RELOCS_CHUNK;
+        relocs_decode(bytes + (size_t)i * sizeof(S(relocation_info)), count,
+                      relocs);
+        for (uint32_t j = 0; j < count; j++) {
+            const struct machdump_relocation* reloc = &relocs[j];
+            totals->types[reloc->type]++;
+            if (reloc_is_addend(cputype, reloc->type)
+                || (!reloc->external && reloc->symbolnum == R_ABS)) {
+                continue;
+            } else if (reloc->external && reloc->symbolnum < totals->nsyms) {
+                totals->symbols[reloc->symbolnum]++;
+            } else if (!reloc->external
+                       && reloc->symbolnum <= dump->nordinals) {
+                totals->ordinals[reloc->symbolnum]++;
+            } else {
+                totals->invalid++;
+            }
+        }
+    }
+}
+
+local void dump_reloc_count(struct dump* dump, const char* record,
+                            const char* name, uint64_t count) {
+    if (dump->records) {
+        record_begin(dump->records, record);
+        record_string(dump->records, "name", name);
+        record_uint(dump->records, "count", count);
+        record_end(dump->records);
+    } else {
+        printf("  │   {+}%s{0}: %llu\n", name, (unsigned long long)count);
+    }
+}
+
+// Counts the relocations of every section by type and by target, so that
+// objects heavy in relocations, and the symbols behind them, stand out.
+local void dump_reloc_summary(struct dump* dump) {
+    struct image* image = dump->image;
+    struct reloc_totals totals;
+    memset(&totals, 0, sizeof(totals));
+    if (image->symtab && parse_symbols(dump, image->symtab) == ImageOk) {
+        totals.nsyms = image->symtab->nsyms;
+    }
+    if (!dump->ordinals) {
+        find_ordinals(dump);
+    }
+    totals.symbols = arena_alloc(dump->arena, sizeof(*totals.symbols)
+                                              * (totals.nsyms + 1));
+    memset(totals.symbols, 0, sizeof(*totals.symbols) * (totals.nsyms + 1));
+    totals.ordinals = arena_alloc(dump->arena, sizeof(*totals.ordinals)
+                                               * (dump->nordinals + 1));
+    memset(totals.ordinals, 0, sizeof(*totals.ordinals)
+                               * (dump->nordinals + 1));
+    for (uint32_t i = 0; i < dump->nordinals; i++) {
+        const struct image_section* section = dump->ordinals[i];
+        if (section->nreloc > 0
+            && section_selected(dump->options, section->header)) {
+            count_relocs(dump, &totals, section);
+        }
+    }
+
+    size_t ntargets = 0;
+    for (uint32_t i = 0; i < totals.nsyms; i++) {
+        ntargets += totals.symbols[i] > 0;
+    }
+    for (uint32_t i = 0; i <= dump->nordinals; i++) {
+        ntargets += totals.ordinals[i] > 0;
+    }
+    struct reloc_count* targets = arena_alloc(dump->arena, sizeof(*targets)
+                                                           * (ntargets + 1));
+    size_t n = 0;
+    for (uint32_t i = 0; i < totals.nsyms; i++) {
+        if (totals.symbols[i] > 0) {
+            targets[n++] = (struct reloc_count){ i, 1, totals.symbols[i] };
+        }
+    }
+    for (uint32_t i = 0; i <= dump->nordinals; i++) {
+        if (totals.ordinals[i] > 0) {
+            targets[n++] = (struct reloc_count){ i, 0, totals.ordinals[i] };
+        }
+    }
+    qsort(targets, n, sizeof(*targets), compare_reloc_counts);
+
+    if (dump->records) {
+        record_begin(dump->records, "relocation_summary");
+        record_uint(dump->records, "relocations", totals.total);
+        record_uint(dump->records, "sections", totals.sections);
+        record_uint(dump->records, "targets", ntargets);
+        record_uint(dump->records, "invalid", totals.invalid);
+        record_end(dump->records);
+    } else {
+        printf("│ {C}Relocation Summary{0}\n");
+        printf("└─┐ Relocations: %llu in %llu section(s)\n",
+               (unsigned long long)totals.total,
+               (unsigned long long)totals.sections);
+        printf("  │ Invalid targets: %llu\n",
+               (unsigned long long)totals.invalid);
+        printf("  │ By type:\n");
+    }
+    const int32_t cputype = image->header->cputype;
+    for (uint32_t type = 0; type < 16; type++) {
+        if (totals.types[type] == 0) {
+            continue;
+        }
+        char unknown[16];
+        const char* name = reloc_type_name(cputype, type);
+        if (!name) {
+            snprintf(unknown, sizeof(unknown), "type %u", type);
+            name = unknown;
+        }
+        dump_reloc_count(dump, "relocation_type", name, totals.types[type]);
+    }
+    if (!dump->records) {
+        printf("  │ By target, %zu of %zu:\n",
+               n < RELOCS_TOP ? n : RELOCS_TOP, ntargets);
+    }
+    for (size_t i = 0; i < n && i < RELOCS_TOP; i++) {
+        char buffer[RELOCS_TARGET_MAX];
+        const struct machdump_relocation reloc = { 0, targets[i].index, 0, 0,
+                                     (uint8_t)targets[i].external, 0 };
+        dump_reloc_count(dump, "relocation_target",
+                         reloc_target(dump, &reloc, buffer, sizeof(buffer)),
+                         targets[i].count);
+    }
+    if (!dump->records) {
+        printf("┌─┘\n");
+    }
+}
+
+// The full dump is rendered as a client of machdump_visit_image, walking
+// the image the same way library users do; see machdump.h. The callbacks
+// find the image's own structures from the indices they are given.
+local enum machdump_step render_header(void* context,
+                                       const struct machdump_header* header) {
+    struct dump* dump = context;
+    const struct dump_options* options = dump->options;
+    (void)header;
+    if (options->command_count == 0 && options->section_count == 0) {
+        if (dump->records) {
+            emit_header(dump, dump->image->header);
+        } else {
+            dump_header(dump, dump->image->header);
+        }
+    }
+    return options->header_only ? MachdumpStop : MachdumpContinue;
+}
+
+local enum machdump_step render_load_command(
+    void* context, const struct machdump_command* visited) {
+    struct dump* dump = context;
+    struct image_command* command = &dump->image->commands[visited->index];
+    count_load_command(dump, command);
+    if (!command_selected(dump->options, command)) {
+        return MachdumpSkip;
+    }
+    if (dump->stats) {
+        dump->command_start = stats_now();
+    }
+    dump_load_command(dump, command);
+    return MachdumpContinue;
+}
+
+local const struct image_section* visited_section(
+    const struct dump* dump, const struct machdump_command* segment,
+    const struct machdump_section* section) {
+    return &dump->image->commands[segment->index].sections[section->index];
+}
+
+local enum machdump_step render_section(
+    void* context, const struct machdump_command* segment,
+    const struct machdump_section* visited) {
+    struct dump* dump = context;
+    const struct image_section* section = visited_section(dump, segment,
+                                                          visited);
+    if (!section_selected(dump->options, section->header)) {
+        return MachdumpSkip;
+    } else if (dump->records) {
+        emit_section_64(dump, section);
+    } else {
+        dump_section_64(dump, section);
+    }
+    return MachdumpContinue;
+}
+
+local enum machdump_step render_relocations(
+    void* context, const struct machdump_section* section,
+    const struct machdump_relocation* relocs, uint32_t count) {
+    (void)section;
+    for (uint32_t i = 0; i < count; i++) {
+        dump_reloc(context, &relocs[i]);
+    }
+    return MachdumpContinue;
+}
+
+local enum machdump_step render_end_section(
+    void* context, const struct machdump_command* segment,
+    const struct machdump_section* visited) {
+    struct dump* dump = context;
+    if (!dump->records) {
+        dump_section_end(dump, visited_section(dump, segment, visited));
+    }
+    return MachdumpContinue;
+}
+
+local enum machdump_step render_symbol(void* context,
+                                       const struct machdump_command* visited,
+                                       const struct machdump_symbol* symbol) {
+    struct dump* dump = context;
+    const struct image_command* symtab =
+        &dump->image->commands[visited->index];
+    const struct image_symbol* entry = &symtab->symbols[symbol->index];
+    if (dump->records) {
+        emit_nlist64_elem(dump, entry, symbol->index);
+    } else {
+        dumo_nlist64_elem(dump, (const void*)symtab->header, entry);
+    }
+    return MachdumpContinue;
+}
+
+// Ends a command, timing it for --stats. The time includes parsing its
+// symbols, if it has any, and any writes made while rendering it.
+local enum machdump_step render_end_command(
+    void* context, const struct machdump_command* command) {
+    struct dump* dump = context;
+    const uint32_t cmd = command->cmd;
+    if (!dump->records && !command->truncated
+        && (image_is_segment(cmd) || cmd == LC_SYMTAB)) {
+        printf("┌─┘\n");
+    }
+    if (dump->stats) {
+        struct stats_command* slot = &dump->stats->by_command[LC_SLOT(cmd)];
+        slot->cmd = cmd;
+        slot->count++;
+        slot->ns += stats_now() - dump->command_start;
+    }
+    return MachdumpContinue;
+}
+
+local void render_image(struct dump* dump) {
+    struct machdump_visitor visitor = {
+        render_header, render_load_command, NULL, render_section,
+        NULL, render_end_section, render_symbol, render_end_command, NULL
+    };
+    if (dump->options->relocs == RelocsAll) {
+        visitor.relocations = render_relocations;
+    }
+    machdump_visit_image(dump->image, &visitor, dump);
+}
+
+local void dump_query_symbol(struct dump* dump,
+                             const struct image_command* command,
+                             uint32_t index) {
+    if (dump->records) {
+        emit_nlist64_elem(dump, &command->symbols[index], index);
+    } else {
+        dumo_nlist64_elem(dump, (const void*)command->header,
+                          &command->symbols[index]);
+    }
+}
+
+// Introduces the results of one query, as a text box or a query record.
+local void begin_query(struct dump* dump, const char* kind, const char* title,
+                       const char* text, uint64_t address, size_t matches) {
+    if (dump->records) {
+        record_begin(dump->records, "query");
+        record_string(dump->records, "kind", kind);
+        if (text) {
+            record_string(dump->records, "value", text);
+        } else {
+            record_uint(dump->records, "value", address);
+        }
+        record_uint(dump->records, "matches", matches);
+        record_end(dump->records);
+    } else if (text) {
+        printf("│ {C}%s{0} {/}\"%s\"{0}\n", title, text);
+        printf("└─┐ Matches: %zu\n", matches);
+    } else {
+        printf("│ {C}%s{0} {Y}0x%016llx{0}\n", title,
+               (unsigned long long)address);
+        printf("└─┐ Matches: %zu\n", matches);
+    }
+}
+
+local void end_query(struct dump* dump) {
+    if (!dump->records) {
+        printf("┌─┘\n");
+    }
+}
+
+local int is_symbol_query(const struct dump_options* options) {
+    return options->symbol || options->prefix || options->find_address;
+}
 
-    for (uint32_t i = 0; i < header->ncmds; i++) {
-        S(load_command*) load_command = READ(sizeof(*load_command));
-        CONSUME(load_command->cmdsize - sizeof(*load_command));
-        dump_load_command(buffer, load_command);
+// Answers --symbol, --prefix and --addr from an index over the symbol table
+// instead of printing every nlist_64.
+local void dump_symbol_queries(struct dump* dump) {
+    const struct dump_options* options = dump->options;
+    struct image_command* symtab = dump->image->symtab;
+    if (!symtab) {
+        if (!dump->records) {
+            printf("│ {C}Symbol Query{0}: no symbol table\n");
+        }
+        return;
+    }
+    if (parse_symbols(dump, symtab) != ImageOk) {
+        if (!dump->records) {
+            printf("│ {C}Symbol Query{0}: {R+}Symbol or string table out "
+                   "of bounds{0}\n");
+        }
+        return;
+    }
+    struct symbol_index index;
+    const S(symtab_command*) symt = (const void*)symtab->header;
+    symbol_index_build(&index, symtab->nlist, symtab->nsyms, symtab->strings,
+                       symt->strsize);
+
+    if (options->symbol) {
+        size_t matches = 0, cursor = 0;
+        while (symbol_index_find(&index, options->symbol, &cursor)
+               != SYMBOL_NONE) {
+            matches++;
+        }
+        begin_query(dump, "symbol", "Symbols Named", options->symbol, 0,
+                    matches);
+        cursor = 0;
+        uint32_t i;
+        while ((i = symbol_index_find(&index, options->symbol, &cursor))
+               != SYMBOL_NONE) {
+            dump_query_symbol(dump, symtab, i);
+        }
+        end_query(dump);
+    }
+    if (options->prefix) {
+        size_t first;
+        const size_t matches = symbol_index_prefix(&index, options->prefix,
+                                                   &first);
+        begin_query(dump, "prefix", "Symbols Starting With", options->prefix,
+                    0, matches);
+        for (size_t i = first; i < first + matches; i++) {
+            dump_query_symbol(dump, symtab, index.by_name[i].index);
+        }
+        end_query(dump);
+    }
+    if (options->find_address) {
+        const uint32_t i = symbol_index_containing(&index, options->address);
+        begin_query(dump, "address", "Symbol Containing", NULL,
+                    options->address, i != SYMBOL_NONE);
+        if (i != SYMBOL_NONE) {
+            dump_query_symbol(dump, symtab, i);
+        }
+        end_query(dump);
+    }
+    symbol_index_free(&index);
+}
+
+// --strings lists the symbol string table and every S_CSTRING_LITERALS
+// section, one line per string.
+#define STRINGS_LONGEST 5
+
+struct string_region {
+    char name[34];
+    uint64_t offset;
+    const char* bytes;
+    uint64_t size;
+};
+
+struct string_scan {
+    struct dump* dump;
+    const struct string_region* region;
+    // Distinct strings, kept for --strings=unique and summaries.
+    struct cstring_set* set;
+    // Whether this pass tallies strings, prints them, or both. With
+    // --strings=unique, a first pass tallies and a second prints each
+    // string once, at its first occurrence.
+    int collect;
+    int print;
+    int unique;
+    // Lines printed for the current region.
+    uint64_t printed;
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t unterminated;
+    struct cstring_entry longest[STRINGS_LONGEST];
+    // The fixed text of each line, resolved once.
+    const char* open;
+    size_t open_length;
+    const char* close;
+    size_t close_length;
+};
+
+local char* put_hex64(char* p, uint64_t value) {
+    static const char digits[16] = "0123456789abcdef";
+    for (int shift = 60; shift >= 0; shift -= 4) {
+        *p++ = digits[(value >> shift) & 0xf];
+    }
+    return p;
+}
+
+// Writes `length` bytes between quotes, escaping anything unprintable.
+local void put_quoted(struct output* out, const char* string, size_t length) {
+    output_char(out, '"');
+    size_t run = 0;
+    for (size_t i = 0; i < length; i++) {
+        const unsigned char c = (unsigned char)string[i];
+        if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\') {
+            continue;
+        }
+        output_write(out, string + run, i - run);
+        char escape[4] = { '\\', (char)c, 0, 0 };
+        size_t n = 2;
+        if (c == '\n') escape[1] = 'n';
+        else if (c == '\t') escape[1] = 't';
+        else if (c == '\r') escape[1] = 'r';
+        else if (c != '"' && c != '\\') {
+            escape[1] = 'x';
+            escape[2] = "0123456789abcdef"[c >> 4];
+            escape[3] = "0123456789abcdef"[c & 0xf];
+            n = 4;
+        }
+        output_write(out, escape, n);
+        run = i + 1;
+    }
+    output_write(out, string + run, length - run);
+    output_char(out, '"');
+}
+
+local void put_string(struct string_scan* scan, uint64_t offset,
+                      const char* string, size_t length, uint64_t count) {
+    struct dump* dump = scan->dump;
+    if (dump->records) {
+        record_begin(dump->records, "string");
+        record_uint(dump->records, "offset", offset);
+        record_string_n(dump->records, "value", string, length);
+        if (count > 0) {
+            record_uint(dump->records, "count", count);
+        }
+        record_end(dump->records);
+        return;
+    }
+    char hex[16];
+    put_hex64(hex, offset);
+    output_write(dump->out, scan->open, scan->open_length);
+    output_write(dump->out, hex, sizeof(hex));
+    output_write(dump->out, scan->close, scan->close_length);
+    put_quoted(dump->out, string, length);
+    if (count > 1) {
+        printf(" (%llu times)", (unsigned long long)count);
+    }
+    output_char(dump->out, '\n');
+}
+
+local void note_longest(struct string_scan* scan, const char* string,
+                        size_t length, uint64_t offset) {
+    struct cstring_entry* longest = scan->longest;
+    if (length <= longest[STRINGS_LONGEST - 1].length) {
+        return;
+    }
+    size_t i = STRINGS_LONGEST - 1;
+    for (; i > 0 && longest[i - 1].length < length; i--) {
+        longest[i] = longest[i - 1];
+    }
+    longest[i].string = string;
+    longest[i].length = length;
+    longest[i].offset = offset;
+    longest[i].count = 1;
+}
+
+local void visit_string(void* context, const char* string, size_t offset,
+                        size_t length, int terminated) {
+    struct string_scan* scan = context;
+    const uint64_t at = scan->region->offset + offset;
+    if (scan->collect) {
+        scan->count++;
+        scan->bytes += length + (terminated ? 1 : 0);
+        scan->unterminated += !terminated;
+        note_longest(scan, string, length, at);
+        if (scan->set) {
+            cstring_set_add(scan->set, string, length, at);
+        }
+    }
+    if (!scan->print) {
+        return;
+    } else if (scan->unique) {
+        const struct cstring_entry* entry = cstring_set_find(scan->set,
+                                                             string, length);
+        if (entry->offset != at) {
+            return;
+        }
+        put_string(scan, at, string, length, entry->count);
+    } else {
+        put_string(scan, at, string, length, 0);
+    }
+    scan->printed++;
+}
+
+// Gathers the regions --strings scans: the string table, unless sections
+// were picked with --section, and every cstring literal section.
+local size_t string_regions(struct dump* dump, struct arena* arena,
+                            struct string_region** regions) {
+    const struct image* image = dump->image;
+    const struct dump_options* options = dump->options;
+    size_t capacity = 1;
+    for (uint32_t i = 0; i < image->ncmds; i++) {
+        capacity += image->commands[i].nsects;
+    }
+    *regions = arena_alloc(arena, sizeof(**regions) * capacity);
+    size_t count = 0;
+    if (image->symtab && options->section_count == 0) {
+        const S(symtab_command*) symt = (const void*)image->symtab->header;
+        struct string_region* region = &(*regions)[count];
+        strcpy(region->name, "String Table");
+        region->offset = symt->stroff;
+        region->size = symt->strsize;
+        region->bytes = source_read(dump->source, symt->stroff,
+                                    symt->strsize);
+        if (region->bytes) {
+            count++;
+        } else if (!dump->records) {
+            printf("│ {C}Strings{0}: String Table {R+}out of bounds{0}\n");
+        }
+    }
+    for (uint32_t i = 0; i < image->ncmds; i++) {
+        const struct image_command* command = &image->commands[i];
+        for (uint32_t j = 0; j < command->nsects; j++) {
+            const S(section_64*) sec64 = command->sections[j].header;
+            if ((sec64->flags & SECTION_TYPE) != S_CSTRING_LITERALS
+                || command->sections[j].contents != ContentsInFile
+                || (options->section_count > 0
+                    && !section_selected(options, sec64))) {
+                continue;
+            }
+            struct string_region* region = &(*regions)[count];
+            snprintf(region->name, sizeof(region->name), "%.16s,%.16s",
+                     sec64->segname, sec64->sectname);
+            region->offset = sec64->offset;
+            region->size = sec64->size;
+            region->bytes = source_read(dump->source, sec64->offset,
+                                        sec64->size);
+            if (region->bytes) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+local void scan_regions(struct string_scan* scan,
+                        const struct string_region* regions, size_t count) {
+    struct dump* dump = scan->dump;
+    for (size_t i = 0; i < count; i++) {
+        const struct string_region* region = &regions[i];
+        scan->region = region;
+        scan->printed = 0;
+        if (scan->print && dump->records) {
+            record_begin(dump->records, "strings");
+            record_string(dump->records, "region", region->name);
+            record_uint(dump->records, "offset", region->offset);
+            record_uint(dump->records, "size", region->size);
+            record_end(dump->records);
+        } else if (scan->print) {
+            printf("│ {C}Strings{0}: %s\n", region->name);
+            printf("└─┐ File Offset: {Y}0x%016llx{0}\n",
+                   (unsigned long long)region->offset);
+            printf("  │ Size: %llu byte(s)\n",
+                   (unsigned long long)region->size);
+        }
+        cstrings_scan(region->bytes, region->size, visit_string, scan);
+        if (scan->print && !dump->records) {
+            printf("┌─┘ %llu %sstring(s)\n", (unsigned long long)scan->printed,
+                   scan->unique ? "unique " : "");
+        }
+    }
+}
+
+local void dump_string_summary(struct dump* dump,
+                               const struct string_scan* scan) {
+    const struct cstring_set* set = scan->set;
+    uint64_t duplicates = 0, wasted = 0;
+    for (size_t i = 0; i <= set->mask; i++) {
+        const struct cstring_entry* entry = &set->entries[i];
+        if (entry->string && entry->count > 1) {
+            duplicates += entry->count - 1;
+            wasted += (entry->count - 1) * (entry->length + 1);
+        }
+    }
+    if (dump->records) {
+        record_begin(dump->records, "strings_summary");
+        record_uint(dump->records, "strings", scan->count);
+        record_uint(dump->records, "bytes", scan->bytes);
+        record_uint(dump->records, "unique", set->count);
+        record_uint(dump->records, "duplicates", duplicates);
+        record_uint(dump->records, "duplicate_bytes", wasted);
+        record_uint(dump->records, "unterminated", scan->unterminated);
+        record_end(dump->records);
+        for (size_t i = 0; i < STRINGS_LONGEST; i++) {
+            const struct cstring_entry* entry = &scan->longest[i];
+            if (!entry->string) {
+                break;
+            }
+            record_begin(dump->records, "longest_string");
+            record_uint(dump->records, "offset", entry->offset);
+            record_uint(dump->records, "length", entry->length);
+            record_string_n(dump->records, "value", entry->string,
+                            entry->length);
+            record_end(dump->records);
+        }
+        return;
+    }
+    printf("│ {C}String Summary{0}\n");
+    printf("└─┐ Strings: %llu, %llu byte(s)\n",
+           (unsigned long long)scan->count, (unsigned long long)scan->bytes);
+    printf("  │ Unique strings: %zu\n", set->count);
+    printf("  │ Duplicates: %llu, %llu byte(s)\n",
+           (unsigned long long)duplicates, (unsigned long long)wasted);
+    printf("  │ Unterminated: %llu\n", (unsigned long long)scan->unterminated);
+    printf("  │ Longest strings:\n");
+    for (size_t i = 0; i < STRINGS_LONGEST; i++) {
+        const struct cstring_entry* entry = &scan->longest[i];
+        if (!entry->string) {
+            break;
+        }
+        printf("  │   {Y}0x%016llx{0}: %zu byte(s): ",
+               (unsigned long long)entry->offset, entry->length);
+        // Long strings are cut short; the offset leads to the rest.
+        put_quoted(dump->out, entry->string,
+                   entry->length < 64 ? entry->length : 64);
+        printf(entry->length > 64 ? "...\n" : "\n");
+    }
+    printf("┌─┘\n");
+}
+
+local void dump_strings(struct dump* dump, struct arena* arena) {
+    const struct dump_options* options = dump->options;
+    struct string_region* regions;
+    const size_t count = string_regions(dump, arena, &regions);
+    struct string_scan scan;
+    memset(&scan, 0, sizeof(scan));
+    scan.dump = dump;
+    scan.open = output_markup(dump->out, "  │ {Y}0x", &scan.open_length);
+    scan.close = output_markup(dump->out, "{0}: ", &scan.close_length);
+
+    const int summary = options->strings == StringsSummary
+        || options->summary;
+    struct cstring_set set;
+    if (summary || options->strings == StringsUnique) {
+        cstring_set_init(&set);
+        scan.set = &set;
+    }
+    scan.collect = 1;
+    if (options->strings == StringsUnique) {
+        scan_regions(&scan, regions, count);
+        scan.collect = 0;
+        scan.unique = 1;
+    }
+    scan.print = options->strings != StringsSummary;
+    if (scan.print || scan.collect) {
+        scan_regions(&scan, regions, count);
+    }
+    if (summary) {
+        dump_string_summary(dump, &scan);
+    }
+    if (scan.set) {
+        cstring_set_free(&set);
+    }
+}
+
+// With --hash, each region is hashed as a job of its own, largest first, so
+// one large section does not leave the other threads idle at the end.
+// Regions are read on the calling thread; the jobs only touch memory.
+#define HASH_NAME_MAX 40
+
+struct hash_item {
+    const char* kind;
+    char name[HASH_NAME_MAX];
+    uint64_t offset;
+    uint64_t size;
+    const void* bytes;
+    // Whether the item is folded into the semantic digest. Segments are
+    // listed but overlap their sections and, in linked images, the header.
+    int digested;
+    uint64_t xxh64;
+    unsigned char sha256[SHA256_SIZE];
+};
+
+struct hashes {
+    struct hash_item* items;
+    size_t count;
+    // The items from largest to smallest, in the order they are hashed.
+    struct hash_item** order;
+    int sha256;
+};
+
+local int compare_hash_sizes(const void* lhs, const void* rhs) {
+    const uint64_t a = (*(struct hash_item* const*)lhs)->size;
+    const uint64_t b = (*(struct hash_item* const*)rhs)->size;
+    return a < b ? 1 : a > b ? -1 : 0;
+}
+
+local int hash_job(void* context, size_t index, struct output* out,
+                   struct output* err) {
+    (void)out;
+    (void)err;
+    const struct hashes* hashes = context;
+    struct hash_item* item = hashes->order[index];
+    item->xxh64 = hash64(item->bytes, item->size, 0);
+    if (hashes->sha256) {
+        sha256(item->bytes, item->size, item->sha256);
+    }
+    return 0;
+}
+
+local struct hash_item* add_hash_item(struct hashes* hashes,
+                                      const char* kind, uint64_t offset,
+                                      uint64_t size, const void* bytes,
+                                      int digested) {
+    struct hash_item* item = &hashes->items[hashes->count++];
+    memset(item, 0, sizeof(*item));
+    item->kind = kind;
+    item->offset = offset;
+    item->size = size;
+    item->bytes = bytes;
+    item->digested = digested;
+    return item;
+}
+
+local void add_hash_region(struct dump* dump, struct hashes* hashes,
+                           const char* kind, uint64_t offset, uint64_t size,
+                           int digested, const char* name) {
+    const void* bytes = source_read(dump->source, offset, size);
+    if (bytes) {
+        struct hash_item* item = add_hash_item(hashes, kind, offset, size,
+                                               bytes, digested);
+        snprintf(item->name, sizeof(item->name), "%s", name);
+    }
+}
+
+local int is_dylib_command(uint32_t cmd) {
+    return cmd == LC_LOAD_DYLIB || cmd == LC_ID_DYLIB
+        || cmd == LC_LOAD_WEAK_DYLIB || cmd == LC_REEXPORT_DYLIB
+        || cmd == LC_LAZY_LOAD_DYLIB || cmd == LC_LOAD_UPWARD_DYLIB;
+}
+
+// Commands left out of the semantic digest: LC_UUID and the code signature
+// differ between otherwise identical builds, and so does anything named
+// with --hash-exclude. Naming a command with --cmd puts it back.
+local int hash_excluded(const struct dump_options* options, uint32_t cmd) {
+    for (size_t i = 0; i < options->command_count; i++) {
+        if (options->commands[i] == cmd) {
+            return 0;
+        }
+    }
+    for (size_t i = 0; i < options->hash_exclude_count; i++) {
+        if (options->hash_excludes[i] == cmd) {
+            return 1;
+        }
+    }
+    return cmd == LC_UUID || cmd == LC_CODE_SIGNATURE;
+}
+
+// Copies the header and the digested load commands into one block, with
+// the link-time timestamps of dylib commands cleared.
+// The header and commands are hashed as stored, not as the image converted
+// them, so 32-bit and byte-swapped files hash every byte they hold.
+local void add_hash_commands(struct dump* dump, struct hashes* hashes,
+                             struct arena* arena) {
+    struct image* image = dump->image;
+    const size_t header_size = image->header_size;
+    char* block = arena_alloc(arena, header_size
+                                     + image->header->sizeofcmds);
+    const void* header = source_read(dump->source, 0, header_size);
+    if (!header) {
+        image_add_error(image, ImageReadFailed, 0, 0);
+        return;
+    }
+    memcpy(block, header, header_size);
+    size_t size = header_size;
+    for (uint32_t i = 0; i < image->ncmds; i++) {
+        const struct image_command* command = &image->commands[i];
+        const S(load_command*) load_command = command->header;
+        if (!command_selected(dump->options, command)
+            || hash_excluded(dump->options, load_command->cmd)) {
+            continue;
+        }
+        const void* raw = source_read(dump->source, command->offset,
+                                      load_command->cmdsize);
+        if (!raw) {
+            image_add_error(image, ImageReadFailed, i, command->offset);
+            continue;
+        }
+        char* copy = block + size;
+        memcpy(copy, raw, load_command->cmdsize);
+        size += load_command->cmdsize;
+        if (is_dylib_command(load_command->cmd)
+            && load_command->cmdsize >= sizeof(S(dylib_command))) {
+            memset(copy + offsetof(S(dylib_command), dylib.timestamp), 0,
+                   sizeof(uint32_t));
+        }
+    }
+    add_hash_item(hashes, "commands", 0, size, block, 1);
+}
+
+local void add_hash_segment(struct dump* dump, struct hashes* hashes,
+                            const struct image_command* command) {
+    const S(segment_command_64*) seg64 = (const void*)command->header;
+    char name[HASH_NAME_MAX];
+    snprintf(name, sizeof(name), "%.16s", seg64->segname);
+    if (seg64->filesize > 0) {
+        add_hash_region(dump, hashes, "segment", seg64->fileoff,
+                        seg64->filesize, 0, name);
+    }
+    for (uint32_t i = 0; i < command->nsects; i++) {
+        const S(section_64*) sec64 = command->sections[i].header;
+        if (command->sections[i].contents == ContentsInFile
+            && section_selected(dump->options, sec64)) {
+            snprintf(name, sizeof(name), "%.16s,%.16s", sec64->segname,
+                     sec64->sectname);
+            add_hash_region(dump, hashes, "section", sec64->offset,
+                            sec64->size, 1, name);
+        }
+    }
+}
+
+local void add_hash_linkedit(struct dump* dump, struct hashes* hashes,
+                             const struct image_command* command) {
+    const S(load_command*) load_command = command->header;
+    const struct load_command_decoder* decoder =
+        find_decoder(load_command->cmd);
+    char name[HASH_NAME_MAX];
+    if (load_command->cmd == LC_SYMTAB) {
+        const S(symtab_command*) symt = (const void*)load_command;
+        add_hash_region(dump, hashes, "linkedit", symt->symoff,
+                        (uint64_t)symt->nsyms * image_nlist_size(dump->image),
+                        1, "LC_SYMTAB symbols");
+        add_hash_region(dump, hashes, "linkedit", symt->stroff,
+                        symt->strsize, 1, "LC_SYMTAB strings");
+    } else if (decoder && decoder->extent == linkedit_data_extent) {
+        const S(linkedit_data_command*) data = (const void*)load_command;
+        snprintf(name, sizeof(name), "%s", decoder->name);
+        add_hash_region(dump, hashes, "linkedit", data->dataoff,
+                        data->datasize, 1, name);
+    } else if (decoder && decoder->extent == dyld_info_extent) {
+        const S(dyld_info_command*) info = (const void*)load_command;
+        const struct {
+            const char* name;
+            uint32_t offset, size;
+        } regions[] = {
+            { "rebase", info->rebase_off, info->rebase_size },
+            { "bind", info->bind_off, info->bind_size },
+            { "weak bind", info->weak_bind_off, info->weak_bind_size },
+            { "lazy bind", info->lazy_bind_off, info->lazy_bind_size },
+            { "export", info->export_off, info->export_size },
+        };
+        for (size_t i = 0; i < sizeof(regions) / sizeof(*regions); i++) {
+            snprintf(name, sizeof(name), "%s %s", decoder->name,
+                     regions[i].name);
+            add_hash_region(dump, hashes, "linkedit", regions[i].offset,
+                            regions[i].size, 1, name);
+        }
+    }
+}
+
+local void put_hex(char* out, const unsigned char* bytes, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        sprintf(out + 2 * i, "%02x", bytes[i]);
+    }
+}
+
+local void print_hash(struct dump* dump, const struct hashes* hashes,
+                      const char* kind, const char* name, uint64_t offset,
+                      uint64_t size, uint64_t xxh64,
+                      const unsigned char* digest, int last) {
+    char sha[2 * SHA256_SIZE + 1] = "";
+    if (hashes->sha256) {
+        put_hex(sha, digest, SHA256_SIZE);
+    }
+    if (dump->records) {
+        char fast[17];
+        snprintf(fast, sizeof(fast), "%016llx", (unsigned long long)xxh64);
+        record_begin(dump->records, last ? "digest" : "hash");
+        if (!last) {
+            record_string(dump->records, "kind", kind);
+            record_string(dump->records, "name", name);
+            record_uint(dump->records, "offset", offset);
+        }
+        record_uint(dump->records, last ? "items" : "size", size);
+        record_string(dump->records, "xxh64", fast);
+        if (hashes->sha256) {
+            record_string(dump->records, "sha256", sha);
+        }
+        record_end(dump->records);
+        return;
+    }
+    printf("  │ %s%s%s: %llu %s\n", kind, *name ? " " : "", name,
+           (unsigned long long)size, last ? "item(s)" : "byte(s)");
+    printf("%s   XXH64: {Y}%016llx{0}\n",
+           last && !hashes->sha256 ? "┌─┘" : "  │",
+           (unsigned long long)xxh64);
+    if (hashes->sha256) {
+        printf("%s   SHA-256: {Y}%s{0}\n", last ? "┌─┘" : "  │", sha);
+    }
+}
+
+local const char* hash_label(const char* kind) {
+    return strcmp(kind, "commands") == 0 ? "Load Commands"
+         : strcmp(kind, "segment") == 0 ? "Segment"
+         : strcmp(kind, "section") == 0 ? "Section"
+         : "Linkedit";
+}
+
+// Hashes the header and load commands, each segment and section, and the
+// symbol table and linkedit data, then combines the digested ones, with
+// their names, into a semantic digest. --section and --cmd narrow all of
+// these down as they do the dump; with only --section, the digest covers
+// just those sections.
+local void dump_hashes(struct dump* dump, struct arena* arena) {
+    const struct dump_options* options = dump->options;
+    struct image* image = dump->image;
+    struct hashes hashes;
+    memset(&hashes, 0, sizeof(hashes));
+    hashes.sha256 = options->hash == HashSha256;
+    // No command has more regions than LC_DYLD_INFO's five, besides the
+    // sections of segments.
+    size_t most = 1;
+    for (uint32_t i = 0; i < image->ncmds; i++) {
+        most += 5 + image->commands[i].nsects;
+    }
+    hashes.items = arena_alloc(arena, sizeof(*hashes.items) * most);
+
+    if (options->section_count == 0 || options->command_count > 0) {
+        add_hash_commands(dump, &hashes, arena);
+    }
+    for (uint32_t i = 0; i < image->ncmds; i++) {
+        const struct image_command* command = &image->commands[i];
+        if (command->truncated || !command_selected(options, command)
+            || hash_excluded(options, command->header->cmd)) {
+            continue;
+        } else if (image_is_segment(command->header->cmd)) {
+            add_hash_segment(dump, &hashes, command);
+        } else if (options->section_count == 0
+                   || options->command_count > 0) {
+            add_hash_linkedit(dump, &hashes, command);
+        }
+    }
+
+    hashes.order = arena_alloc(arena, sizeof(*hashes.order)
+                                      * (hashes.count + 1));
+    for (size_t i = 0; i < hashes.count; i++) {
+        hashes.order[i] = &hashes.items[i];
+    }
+    qsort(hashes.order, hashes.count, sizeof(*hashes.order),
+          compare_hash_sizes);
+    jobs_run(hashes.count, dump->jobs, hash_job, &hashes, dump->out,
+             dump->out);
+
+    // The digest is taken over each item's name and hash, not its bytes,
+    // so it costs nothing next to the hashing itself.
+    const size_t entry = HASH_NAME_MAX + 8 + SHA256_SIZE;
+    unsigned char* names = arena_alloc(arena, entry * (hashes.count + 1));
+    unsigned char* digests = arena_alloc(arena, entry * (hashes.count + 1));
+    size_t fast = 0, slow = 0;
+    uint64_t digested = 0;
+    if (!dump->records) {
+        printf("│ {C}Hashes{0}\n");
+        printf("└─┐ %s\n", hashes.sha256 ? "XXH64 and SHA-256"
+                                         : "XXH64");
+    }
+    for (size_t i = 0; i < hashes.count; i++) {
+        const struct hash_item* item = &hashes.items[i];
+        print_hash(dump, &hashes, dump->records ? item->kind
+                                                : hash_label(item->kind),
+                   item->name, item->offset, item->size, item->xxh64,
+                   item->sha256, 0);
+        if (!item->digested) {
+            continue;
+        }
+        digested++;
+        const size_t length = strlen(item->name) + 1;
+        memcpy(names + fast, item->name, length);
+        for (int b = 0; b < 8; b++) {
+            names[fast + length + b] = (unsigned char)(item->xxh64 >> 8 * b);
+        }
+        fast += length + 8;
+        memcpy(digests + slow, item->name, length);
+        memcpy(digests + slow + length, item->sha256, SHA256_SIZE);
+        slow += length + SHA256_SIZE;
+    }
+    unsigned char digest[SHA256_SIZE];
+    if (hashes.sha256) {
+        sha256(digests, slow, digest);
+    }
+    print_hash(dump, &hashes, "Semantic Digest", "", 0, digested,
+               hash64(names, fast, 0), digest, 1);
+}
+
+// --fixups lists what dyld does to an image as it loads it: each rebase,
+// bind and export in LC_DYLD_INFO, LC_DYLD_CHAINED_FIXUPS and
+// LC_DYLD_EXPORTS_TRIE, one line or record apiece. The decoders in dyld.c
+// hand them over in batches as they go, so nothing is kept per fixup.
+struct fixups {
+    struct dump* dump;
+    struct dyld_segment* segments;
+    const char** segnames;
+    uint32_t nsegments;
+    // Install names of the dylib commands, by ordinal counting from 1.
+    const char** dylibs;
+    uint32_t ndylibs;
+    // Whether --dylib picks each ordinal, from -3 (weak lookup) up.
+    unsigned char* selected;
+    // The address of the Mach-O header, which exports are relative to.
+    uint64_t base;
+    int chained;
+    uint64_t counts[4];
+    uint64_t exports;
+};
+
+static const char* const fixup_kinds[4] = {
+    [DyldRebase] = "rebase",
+    [DyldBind] = "bind",
+    [DyldWeakBind] = "weak bind",
+    [DyldLazyBind] = "lazy bind",
+};
+
+static const char* const fixup_records[4] = {
+    [DyldRebase] = "rebase",
+    [DyldBind] = "bind",
+    [DyldWeakBind] = "weak_bind",
+    [DyldLazyBind] = "lazy_bind",
+};
+
+#define FIXUP_ORDINAL_MIN BIND_SPECIAL_DYLIB_WEAK_LOOKUP
+
+// Returns the install name of a dylib command, or NULL if it does not lie
+// within the command.
+local const char* dylib_path(const S(load_command*) load_command) {
+    const S(dylib_command*) dylib = (const void*)load_command;
+    if (load_command->cmdsize < sizeof(*dylib)) {
+        return NULL;
+    }
+    const uint32_t offset = dylib->dylib.name.offset;
+    const char* bytes = (const char*)load_command;
+    return offset < load_command->cmdsize
+           && memchr(bytes + offset, '\0', load_command->cmdsize - offset)
+        ? bytes + offset
+        : NULL;
+}
+
+// Returns what a dylib ordinal refers to, or NULL if it is out of range.
+local const char* ordinal_name(const struct fixups* fixups, int64_t ordinal) {
+    switch (ordinal) {
+        case BIND_SPECIAL_DYLIB_SELF: return "this-image";
+        case BIND_SPECIAL_DYLIB_MAIN_EXECUTABLE: return "main-executable";
+        case BIND_SPECIAL_DYLIB_FLAT_LOOKUP: return "flat-namespace";
+        case BIND_SPECIAL_DYLIB_WEAK_LOOKUP: return "weak";
+    }
+    return ordinal > 0 && ordinal <= fixups->ndylibs
+        ? fixups->dylibs[ordinal - 1]
+        : NULL;
+}
+
+local const char* leaf_name(const char* path) {
+    const char* slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+// --dylib matches an install name or its last component.
+local int ordinal_selected(const struct fixups* fixups, int64_t ordinal) {
+    return !fixups->selected
+        || (ordinal >= FIXUP_ORDINAL_MIN && ordinal <= fixups->ndylibs
+            && fixups->selected[ordinal - FIXUP_ORDINAL_MIN]);
+}
+
+local int fixup_symbol_selected(const struct dump_options* options,
+                                const char* symbol) {
+    if (!options->symbol && !options->prefix) {
+        return 1;
+    }
+    return symbol
+        && (!options->symbol || strcmp(symbol, options->symbol) == 0)
+        && (!options->prefix || strncmp(symbol, options->prefix,
+                                        strlen(options->prefix)) == 0);
+}
+
+local void find_fixup_targets(struct fixups* fixups, int contents) {
+    struct dump* dump = fixups->dump;
+    const struct image* image = dump->image;
+    for (uint32_t i = 0; i < image->ncmds; i++) {
+        const uint32_t cmd = image->commands[i].header->cmd;
+        fixups->nsegments += image_is_segment(cmd);
+        fixups->ndylibs += is_dylib_command(cmd) && cmd != LC_ID_DYLIB;
+    }
+    fixups->segments = arena_alloc(dump->arena, sizeof(*fixups->segments)
+                                                * fixups->nsegments);
+    fixups->segnames = arena_alloc(dump->arena, sizeof(*fixups->segnames)
+                                                * fixups->nsegments);
+    fixups->dylibs = arena_alloc(dump->arena, sizeof(*fixups->dylibs)
+                                              * fixups->ndylibs);
+    uint32_t segment = 0;
+    uint32_t dylib = 0;
+    for (uint32_t i = 0; i < image->ncmds; i++) {
+        const struct image_command* command = &image->commands[i];
+        const uint32_t cmd = command->header->cmd;
+        if (is_dylib_command(cmd) && cmd != LC_ID_DYLIB) {
+            fixups->dylibs[dylib++] = dylib_path(command->header);
+        }
+        if (!image_is_segment(cmd)) {
+            continue;
+        }
+        struct dyld_segment* target = &fixups->segments[segment];
+        memset(target, 0, sizeof(*target));
+        fixups->segnames[segment++] = "";
+        if (command->truncated) {
+            continue;
+        }
+        const S(segment_command_64*) seg64 = (const void*)command->header;
+        fixups->segnames[segment - 1] = seg64->segname;
+        target->vmaddr = seg64->vmaddr;
+        target->vmsize = seg64->vmsize;
+        if (contents && seg64->filesize > 0) {
+            target->bytes = source_read(dump->source, seg64->fileoff,
+                                        seg64->filesize);
+            target->filesize = target->bytes ? seg64->filesize : 0;
+        }
+        if (seg64->fileoff == 0 && seg64->filesize > 0 && !fixups->base) {
+            fixups->base = seg64->vmaddr;
+        }
+    }
+
+    const char* wanted = dump->options->dylib;
+    if (!wanted) {
+        return;
+    }
+    const size_t count = (size_t)fixups->ndylibs + 1 - FIXUP_ORDINAL_MIN;
+    fixups->selected = arena_alloc(dump->arena, count);
+    for (size_t i = 0; i < count; i++) {
+        const char* name = ordinal_name(fixups,
+                                        (int64_t)i + FIXUP_ORDINAL_MIN);
+        fixups->selected[i] = name && (strcmp(name, wanted) == 0
+                                       || strcmp(leaf_name(name),
+                                                 wanted) == 0);
+    }
+}
+
+local void put_fixup(struct fixups* fixups, const struct dyld_fixup* fixup) {
+    struct dump* dump = fixups->dump;
+    const uint64_t address = fixups->segments[fixup->segment].vmaddr
+                             + fixup->offset;
+    const char* segname = fixups->segnames[fixup->segment];
+    const char* dylib = fixup->kind == DyldRebase
+        ? NULL : ordinal_name(fixups, fixup->ordinal);
+    if (dump->records) {
+        struct record_writer* records = dump->records;
+        record_begin(records, "fixup");
+        record_string(records, "kind", fixup_records[fixup->kind]);
+        record_string_n(records, "segname", segname, 16);
+        record_uint(records, "address", address);
+        record_uint(records, "fixup_type", fixup->type);
+        if (fixup->kind != DyldRebase) {
+            record_string(records, "symbol", fixup->symbol
+                                             ? fixup->symbol : "");
+            record_int(records, "ordinal", fixup->ordinal);
+            record_string(records, "dylib", dylib ? dylib : "");
+            record_int(records, "addend", fixup->addend);
+            record_uint(records, "flags", fixup->flags);
+        } else if (fixups->chained) {
+            record_uint(records, "target", fixup->target);
+        }
+        if (fixups->chained) {
+            record_uint(records, "auth", fixup->auth);
+        }
+        record_end(records);
+        return;
+    }
+    printf("  │ {Y}0x%016llx{0}: %s %.16s", (unsigned long long)address,
+           fixup_kinds[fixup->kind], segname);
+    if (fixup->kind == DyldRebase) {
+        if (fixups->chained) {
+            printf(" -> {Y}0x%llx{0}", (unsigned long long)fixup->target);
+        }
+        if (fixup->type == REBASE_TYPE_TEXT_ABSOLUTE32) {
+            printf(" {+}REBASE_TYPE_TEXT_ABSOLUTE32{0}");
+        } else if (fixup->type == REBASE_TYPE_TEXT_PCREL32) {
+            printf(" {+}REBASE_TYPE_TEXT_PCREL32{0}");
+        }
+    } else {
+        printf(" %s", fixup->symbol ? fixup->symbol : "<no symbol>");
+        // Weak binds are looked up in every image, not in one dylib.
+        if (fixup->kind != DyldWeakBind && dylib) {
+            printf(" from %s", leaf_name(dylib));
+        } else if (fixup->kind != DyldWeakBind) {
+            printf(" from {R+}ordinal %lld (invalid){0}",
+                   (long long)fixup->ordinal);
+        }
+        if (fixup->addend != 0) {
+            const uint64_t magnitude = fixup->addend < 0
+                ? 0 - (uint64_t)fixup->addend : (uint64_t)fixup->addend;
+            printf(" %c 0x%llx", fixup->addend < 0 ? '-' : '+',
+                   (unsigned long long)magnitude);
+        }
+        PRINT_FLAG(fixup->flags, BIND_SYMBOL_FLAGS_WEAK_IMPORT);
+        PRINT_FLAG(fixup->flags, BIND_SYMBOL_FLAGS_NON_WEAK_DEFINITION);
+    }
+    if (fixup->auth) {
+        printf(" (auth)");
+    }
+    printf("\n");
+}
+
+local void visit_fixups(void* context, const struct dyld_fixup* batch,
+                        size_t count) {
+    struct fixups* fixups = context;
+    const struct dump_options* options = fixups->dump->options;
+    for (size_t i = 0; i < count; i++) {
+        const struct dyld_fixup* fixup = &batch[i];
+        if (fixup->kind == DyldRebase
+            ? options->dylib || options->symbol || options->prefix
+            : !ordinal_selected(fixups, fixup->ordinal)
+              || !fixup_symbol_selected(options, fixup->symbol)) {
+            continue;
+        }
+        fixups->counts[fixup->kind]++;
+        put_fixup(fixups, fixup);
+    }
+}
+
+local void visit_export(void* context, const struct dyld_export* entry) {
+    struct fixups* fixups = context;
+    struct dump* dump = fixups->dump;
+    const int reexport = (entry->flags & EXPORT_SYMBOL_FLAGS_REEXPORT) != 0;
+    if (!fixup_symbol_selected(dump->options, entry->name)
+        || (dump->options->dylib
+            && (!reexport || !ordinal_selected(fixups,
+                                               (int64_t)entry->other)))) {
+        return;
+    }
+    fixups->exports++;
+    const uint64_t kind = entry->flags & EXPORT_SYMBOL_FLAGS_KIND_MASK;
+    const uint64_t address = kind == EXPORT_SYMBOL_FLAGS_KIND_ABSOLUTE
+        ? entry->address : fixups->base + entry->address;
+    const char* dylib = reexport
+        ? ordinal_name(fixups, (int64_t)entry->other) : NULL;
+    const char* import = reexport && *entry->import_name
+        ? entry->import_name : entry->name;
+    if (dump->records) {
+        struct record_writer* records = dump->records;
+        record_begin(records, "export");
+        record_string_n(records, "name", entry->name, entry->length);
+        record_uint(records, "flags", entry->flags);
+        if (reexport) {
+            record_uint(records, "ordinal", entry->other);
+            record_string(records, "dylib", dylib ? dylib : "");
+            record_string(records, "import", import);
+        } else {
+            record_uint(records, "address", address);
+        }
+        if (entry->flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER) {
+            record_uint(records, "resolver", fixups->base + entry->other);
+        }
+        record_end(records);
+        return;
+    }
+    if (reexport) {
+        printf("  │ %20sexport %s -> %s from ", "", entry->name, import);
+        if (dylib) {
+            printf("%s", leaf_name(dylib));
+        } else {
+            printf("{R+}ordinal %llu (invalid){0}",
+                   (unsigned long long)entry->other);
+        }
+    } else {
+        printf("  │ {Y}0x%016llx{0}: export %s", (unsigned long long)address,
+               entry->name);
+    }
+    PRINT_FLAG(kind, EXPORT_SYMBOL_FLAGS_KIND_THREAD_LOCAL);
+    PRINT_FLAG(kind, EXPORT_SYMBOL_FLAGS_KIND_ABSOLUTE);
+    PRINT_FLAG(entry->flags, EXPORT_SYMBOL_FLAGS_WEAK_DEFINITION);
+    if (entry->flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER) {
+        printf(" {+}EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER{0} {Y}0x%llx{0}",
+               (unsigned long long)(fixups->base + entry->other));
+    }
+    printf("\n");
+}
+
+// Reads one region of fixup data, recording an error if it is not all in
+// the file.
+local const uint8_t* fixup_region(struct dump* dump, uint32_t index,
+                                  uint32_t offset, uint32_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+    const uint8_t* bytes = source_read(dump->source, offset, size);
+    if (!bytes) {
+        image_add_error(dump->image, ImageFixupsOutOfBounds, index, offset);
+    }
+    return bytes;
+}
+
+local void check_fixups(struct dump* dump, uint32_t index, uint32_t offset,
+                        enum image_status status, size_t stop) {
+    if (status != ImageOk) {
+        image_add_error(dump->image, status, index, (uint64_t)offset + stop);
+    }
+}
+
+local void decode_dyld_info(struct fixups* fixups, uint32_t index,
+                            const S(dyld_info_command*) info) {
+    struct dump* dump = fixups->dump;
+    const struct {
+        enum dyld_fixup_kind kind;
+        uint32_t offset, size;
+    } streams[] = {
+        { DyldRebase, info->rebase_off, info->rebase_size },
+        { DyldBind, info->bind_off, info->bind_size },
+        { DyldWeakBind, info->weak_bind_off, info->weak_bind_size },
+        { DyldLazyBind, info->lazy_bind_off, info->lazy_bind_size },
+    };
+    size_t stop;
+    for (size_t i = 0; i < sizeof(streams) / sizeof(*streams); i++) {
+        const uint8_t* bytes = fixup_region(dump, index, streams[i].offset,
+                                            streams[i].size);
+        if (!bytes) {
+            continue;
+        }
+        const unsigned pointer_size = dump->image->wide ? 8 : 4;
+        const enum image_status status = streams[i].kind == DyldRebase
+            ? dyld_rebases(bytes, streams[i].size, fixups->segments,
+                           fixups->nsegments, pointer_size, visit_fixups,
+                           fixups, &stop)
+            : dyld_binds(streams[i].kind, bytes, streams[i].size,
+                         fixups->segments, fixups->nsegments, pointer_size,
+                         visit_fixups, fixups, &stop);
+        check_fixups(dump, index, streams[i].offset, status, stop);
+    }
+    const uint8_t* bytes = fixup_region(dump, index, info->export_off,
+                                        info->export_size);
+    if (bytes) {
+        check_fixups(dump, index, info->export_off,
+                     dyld_exports(bytes, info->export_size, visit_export,
+                                  fixups, &stop), stop);
+    }
+}
+
+local void decode_linkedit_fixups(struct fixups* fixups, uint32_t index,
+                                  const S(linkedit_data_command*) data) {
+    struct dump* dump = fixups->dump;
+    const uint8_t* bytes = fixup_region(dump, index, data->dataoff,
+                                        data->datasize);
+    if (!bytes) {
+        return;
+    }
+    size_t stop;
+    const enum image_status status = data->cmd == LC_DYLD_CHAINED_FIXUPS
+        ? dyld_chained_fixups(bytes, data->datasize, fixups->segments,
+                              fixups->nsegments, visit_fixups, fixups, &stop)
+        : dyld_exports(bytes, data->datasize, visit_export, fixups, &stop);
+    check_fixups(dump, index, data->dataoff, status, stop);
+}
+
+local int has_fixups(const struct image_command* command) {
+    const uint32_t cmd = command->header->cmd;
+    return !command->truncated
+        && (cmd == LC_DYLD_INFO || cmd == LC_DYLD_INFO_ONLY
+            || cmd == LC_DYLD_CHAINED_FIXUPS || cmd == LC_DYLD_EXPORTS_TRIE);
+}
+
+local void dump_fixups_of(struct fixups* fixups,
+                          const struct image_command* command,
+                          uint32_t index) {
+    struct dump* dump = fixups->dump;
+    const S(load_command*) load_command = command->header;
+    const struct load_command_decoder* decoder =
+        find_decoder(load_command->cmd);
+    memset(fixups->counts, 0, sizeof(fixups->counts));
+    fixups->exports = 0;
+    fixups->chained = load_command->cmd == LC_DYLD_CHAINED_FIXUPS;
+    if (!dump->records) {
+        printf("│ {C}Fixups{0} from {+}%s{0}\n", decoder->name);
+        printf("└─┐ Data: %llu byte(s)\n",
+               (unsigned long long)decoder->extent(dump->image,
+                                                  load_command));
+    }
+    if (decoder->extent == dyld_info_extent) {
+        decode_dyld_info(fixups, index, (const void*)load_command);
+    } else {
+        decode_linkedit_fixups(fixups, index, (const void*)load_command);
+    }
+    const uint64_t* counts = fixups->counts;
+    if (dump->records) {
+        record_begin(dump->records, "fixups");
+        record_string(dump->records, "command", decoder->name);
+        record_uint(dump->records, "rebases", counts[DyldRebase]);
+        record_uint(dump->records, "binds", counts[DyldBind]);
+        record_uint(dump->records, "weak_binds", counts[DyldWeakBind]);
+        record_uint(dump->records, "lazy_binds", counts[DyldLazyBind]);
+        record_uint(dump->records, "exports", fixups->exports);
+        record_end(dump->records);
+    } else if (decoder->extent == dyld_info_extent) {
+        printf("┌─┘ Rebases: %llu, binds: %llu, weak binds: %llu, "
+               "lazy binds: %llu, exports: %llu\n",
+               (unsigned long long)counts[DyldRebase],
+               (unsigned long long)counts[DyldBind],
+               (unsigned long long)counts[DyldWeakBind],
+               (unsigned long long)counts[DyldLazyBind],
+               (unsigned long long)fixups->exports);
+    } else if (fixups->chained) {
+        printf("┌─┘ Rebases: %llu, binds: %llu\n",
+               (unsigned long long)counts[DyldRebase],
+               (unsigned long long)counts[DyldBind]);
+    } else {
+        printf("┌─┘ Exports: %llu\n", (unsigned long long)fixups->exports);
+    }
+}
+
+// Lists the fixups of every command that has them, in load command order.
+// Segments are only read when there are chained fixups to follow.
+local void dump_fixups(struct dump* dump) {
+    const struct image* image = dump->image;
+    struct fixups fixups;
+    memset(&fixups, 0, sizeof(fixups));
+    fixups.dump = dump;
+    int any = 0;
+    int chained = 0;
+    for (uint32_t i = 0; i < image->ncmds; i++) {
+        const struct image_command* command = &image->commands[i];
+        if (has_fixups(command) && command_selected(dump->options, command)) {
+            any = 1;
+            chained |= command->header->cmd == LC_DYLD_CHAINED_FIXUPS;
+        }
+    }
+    if (!any) {
+        return;
+    }
+    find_fixup_targets(&fixups, chained);
+    for (uint32_t i = 0; i < image->ncmds; i++) {
+        const struct image_command* command = &image->commands[i];
+        if (has_fixups(command) && command_selected(dump->options, command)) {
+            dump_fixups_of(&fixups, command, i);
+        }
+    }
+}
+
+// Reports the problems found while parsing, as error records as well when
+// writing records. Returns -1 if there were any.
+local int report_errors(struct dump* dump, struct output* err) {
+    const struct image* image = dump->image;
+    for (const struct image_error* error = image->errors; error;
+         error = error->next) {
+        const char* message = image_status_message(error->status);
+        if (dump->records) {
+            record_begin(dump->records, "error");
+            record_string(dump->records, "message", message);
+            record_uint(dump->records, "command", error->command);
+            record_uint(dump->records, "offset", error->offset);
+            record_end(dump->records);
+        }
+        output_printf(err, "machdump: {R+}error:{0} %s (load command %u, "
+                      "offset 0x%llx)\n", message, error->command,
+                      (unsigned long long)error->offset);
+    }
+    if (image->error_count > IMAGE_ERROR_MAX) {
+        output_printf(err, "machdump: {R+}error:{0} %zu more error(s) "
+                      "omitted\n", image->error_count - IMAGE_ERROR_MAX);
+    }
+    return image->error_count > 0 ? -1 : 0;
+}
+
+local int dump_file(struct dump* dump, struct arena* arena,
+                    struct output* err) {
+    struct image* image = arena_alloc(arena, sizeof(*image));
+    const uint64_t start = dump->stats ? stats_now() : 0;
+    const enum image_status status = image_parse(image, dump->source, arena);
+    if (dump->stats) {
+        dump->stats->parse_ns += stats_now() - start;
+    }
+    if (status != ImageOk) {
+        output_printf(err, "machdump: {R+}error:{0} %s\n",
+                      image_status_message(status));
+        return -1;
+    }
+    dump->image = image;
+    const S(mach_header_64*) header = image->header;
+    const struct arch* arch = dump->options->arch;
+    if (arch && !arch_matches(arch, header->cputype, header->cpusubtype)) {
+        output_printf(err, "machdump: {R+}error:{0} File does not contain "
+                      "architecture %s\n", arch->name);
+        return -1;
+    }
+
+    const struct dump_options* options = dump->options;
+    if (options->fixups) {
+        dump_fixups(dump);
+        return report_errors(dump, err);
+    }
+    if (is_symbol_query(options)) {
+        dump_symbol_queries(dump);
+        return report_errors(dump, err);
+    }
+    if (options->strings != StringsNone) {
+        dump_strings(dump, arena);
+        return report_errors(dump, err);
+    }
+    if (options->hash != HashNone) {
+        dump_hashes(dump, arena);
+        return report_errors(dump, err);
+    }
+    if (options->relocs == RelocsSummary) {
+        dump_reloc_summary(dump);
+        return report_errors(dump, err);
+    }
+    render_image(dump);
+    if (options->header_only) {
+        return 0;
+    }
+    if (options->summary) {
+        dump_summary(dump);
+        if (options->relocs == RelocsAll) {
+            dump_reloc_summary(dump);
+        }
+    }
+    return report_errors(dump, err);
+}
+
+// Fat headers and their arch tables are stored big-endian.
+local uint32_t big32(const void* bytes) {
+    const unsigned char* b = bytes;
+    return (uint32_t)b[0] << 24 | (uint32_t)b[1] << 16
+        | (uint32_t)b[2] << 8 | (uint32_t)b[3];
+}
+
+local uint64_t big64(const void* bytes) {
+    return (uint64_t)big32(bytes) << 32 | big32((const char*)bytes + 4);
+}
+
+// Larger counts are taken to mean the file is not a fat binary; Java class
+// files share FAT_MAGIC and store their version (45 and up) in its place.
+#define FAT_ARCH_MAX 32
+
+struct slice {
+    int32_t cputype;
+    int32_t cpusubtype;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t align;
+};
+
+struct fat {
+    struct source* source;
+    const struct dump_options* options;
+    int is_64;
+    struct slice* slices;
+    // Shared by the slices when they are dumped one after another, and NULL
+    // when they run concurrently and each needs its own.
+    struct arena* arena;
+    // One per slice with --stats, merged once all slices are done.
+    struct stats* stats;
+};
+
+local void dump_fat_header(struct dump* dump, uint32_t magic,
+                           uint32_t nfat_arch) {
+    if (dump->records) {
+        record_begin(dump->records, "fat_header");
+        record_uint(dump->records, "magic", magic);
+        record_uint(dump->records, "nfat_arch", nfat_arch);
+        record_end(dump->records);
+        return;
+    }
+    printf("│ {C}Header{0}: {M+}struct {0}fat_header\n");
+    printf("└─┐ Magic: {Y}0x%08x{0}\n", magic);
+    printf("┌─┘ Number of architectures: %u\n", nfat_arch);
+}
+
+local void dump_slice(struct dump* dump, const struct fat* fat,
+                      const struct slice* slice) {
+    const struct arch* arch = arch_from_cpu(slice->cputype,
+                                            slice->cpusubtype);
+    if (dump->records) {
+        record_begin(dump->records, "arch");
+        record_string(dump->records, "name", arch ? arch->name : "unknown");
+        record_int(dump->records, "cputype", slice->cputype);
+        record_int(dump->records, "cpusubtype", slice->cpusubtype);
+        record_uint(dump->records, "offset", slice->offset);
+        record_uint(dump->records, "size", slice->size);
+        record_uint(dump->records, "align", slice->align);
+        record_end(dump->records);
+        return;
+    }
+    printf("│ {C}Architecture{0}: {M+}struct {0}%s\n",
+           fat->is_64 ? "fat_arch_64" : "fat_arch");
+    printf("└─┐ CPU Type: {Y}0x%08x{0}: %s\n", (uint32_t)slice->cputype,
+           arch ? arch->name : "unknown");
+    printf("  │ CPU Subtype: {Y}0x%08x{0}\n", (uint32_t)slice->cpusubtype);
+    printf("  │ File Offset: {Y}0x%016llx{0}\n",
+           (unsigned long long)slice->offset);
+    printf("  │ Size: %llu byte(s)\n", (unsigned long long)slice->size);
+    printf("┌─┘ Alignment: 2**%u\n", slice->align);
+}
+
+// Adds what was parsed to the counts and charges the time spent in
+// dump_file, less parsing and writing, to rendering.
+local void count_image(struct dump* dump, uint64_t elapsed,
+                       uint64_t parse_ns, uint64_t write_ns) {
+    struct stats* stats = dump->stats;
+    stats->render_ns += elapsed - parse_ns - write_ns;
+    const struct image* image = dump->image;
+    if (!image) {
+        return;
+    }
+    stats->commands += image->ncmds;
+    for (uint32_t i = 0; i < image->ncmds; i++) {
+        stats->sections += image->commands[i].nsects;
+        stats->symbols += image->commands[i].nsyms;
+    }
+}
+
+local int dump_image(struct dump* dump, struct arena* arena,
+                     struct output* err) {
+    struct stats* stats = dump->stats;
+    if (!stats) {
+        return dump_file(dump, arena, err);
+    }
+    const uint64_t start = stats_now();
+    const uint64_t parse_ns = stats->parse_ns;
+    const uint64_t write_ns = dump->out->write_ns;
+    const int status = dump_file(dump, arena, err);
+    count_image(dump, stats_now() - start, stats->parse_ns - parse_ns,
+                dump->out->write_ns - write_ns);
+    return status;
+}
+
+local struct dump* new_dump(struct source* source,
+                            const struct dump_options* options,
+                            struct arena* arena, struct output* out,
+                            struct record_writer* records,
+                            struct stats* stats) {
+    struct dump* dump = arena_alloc(arena, sizeof(*dump));
+    memset(dump, 0, sizeof(*dump));
+    dump->source = source;
+    dump->options = options;
+    dump->out = out;
+    dump->stats = stats;
+    dump->jobs = options->jobs;
+    dump->arena = arena;
+    if (options->format != DumpText) {
+        record_writer_init(records, out, options->format == DumpJson
+                                         ? RecordJson : RecordBinary);
+        dump->records = records;
+    }
+    return dump;
+}
+
+local void free_dump(struct dump* dump) {
+    if (dump->records) {
+        record_writer_free(dump->records);
+    }
+}
+
+struct members {
+    struct source* source;
+    const struct dump_options* options;
+    const struct archive_member** selected;
+    // Shared by the members when they are dumped one after another and
+    // reset after each, or NULL when they run concurrently.
+    struct arena* arena;
+    // One per selected member with --stats, merged once all are done.
+    struct stats* stats;
+    // Threads each member may use for itself.
+    unsigned jobs;
+};
+
+local void dump_archive_header(struct dump* dump,
+                               const struct archive* archive) {
+    const char* symdef = archive->symdef ? archive->symdef->name : NULL;
+    if (dump->records) {
+        record_begin(dump->records, "archive");
+        record_uint(dump->records, "members", archive->nmembers);
+        if (symdef) {
+            record_string(dump->records, "symdef", symdef);
+        }
+        record_uint(dump->records, "symbols", archive->nsymbols);
+        record_end(dump->records);
+        return;
+    }
+    printf("│ {C}Archive{0}: !<arch>\n");
+    printf("└─┐ Number of members: %zu\n", archive->nmembers);
+    if (symdef) {
+        printf("┌─┘ Symbol Index: %s: %zu symbol(s)\n", symdef,
+               archive->nsymbols);
+    } else {
+        printf("┌─┘ Symbol Index: None\n");
+    }
+}
+
+local void dump_archive_symbols(struct dump* dump,
+                                const struct archive* archive) {
+    if (dump->records) {
+        for (size_t i = 0; i < archive->nsymbols; i++) {
+            const struct archive_symbol* symbol = &archive->symbols[i];
+            record_begin(dump->records, "archive_symbol");
+            if (symbol->name) {
+                record_string(dump->records, "name", symbol->name);
+            }
+            record_uint(dump->records, "header", symbol->header);
+            if (symbol->member) {
+                record_string(dump->records, "member", symbol->member->name);
+            }
+            record_end(dump->records);
+        }
+        return;
+    }
+    printf("│ {C}Symbol Index{0}: {M+}struct {0}%s\n",
+           archive->symdef_64 ? "ranlib_64" : "ranlib");
+    printf("└─┐ Number of symbols: %zu\n", archive->nsymbols);
+    for (size_t i = 0; i < archive->nsymbols; i++) {
+        const struct archive_symbol* symbol = &archive->symbols[i];
+        printf("  │ {/}%s{0}: ", symbol->name ? symbol->name
+                                             : "<invalid name>");
+        if (symbol->member) {
+            printf("%s\n", symbol->member->name);
+        } else {
+            printf("{R+}no member at offset 0x%llx{0}\n",
+                   (unsigned long long)symbol->header);
+        }
+    }
+    printf("┌─┘\n");
+}
+
+local void dump_member(struct dump* dump,
+                       const struct archive_member* member) {
+    if (dump->records) {
+        record_begin(dump->records, "member");
+        record_string(dump->records, "name", member->name);
+        record_uint(dump->records, "header", member->header);
+        record_uint(dump->records, "offset", member->offset);
+        record_uint(dump->records, "size", member->size);
+        record_uint(dump->records, "date", member->date);
+        record_uint(dump->records, "uid", member->uid);
+        record_uint(dump->records, "gid", member->gid);
+        record_uint(dump->records, "mode", member->mode);
+        record_end(dump->records);
+        return;
+    }
+    printf("│ {C}Archive Member{0}: %s\n", member->name);
+    printf("└─┐ Header Offset: {Y}0x%016llx{0}\n",
+           (unsigned long long)member->header);
+    printf("  │ Size: %llu byte(s)\n", (unsigned long long)member->size);
+    printf("  │ Modification Time: %llu\n",
+           (unsigned long long)member->date);
+    printf("  │ User ID: %u\n", member->uid);
+    printf("  │ Group ID: %u\n", member->gid);
+    printf("┌─┘ Mode: 0%o\n", member->mode);
+}
+
+local int dump_member_job(void* context, size_t index, struct output* out,
+                          struct output* err) {
+    const struct members* members = context;
+    const struct archive_member* member = members->selected[index];
+    struct source view;
+    source_slice(&view, members->source, member->offset, member->size);
+    struct arena own;
+    struct arena* arena = members->arena;
+    if (!arena) {
+        arena_init(&own);
+        arena = &own;
+    }
+    struct stats* stats = members->stats ? &members->stats[index] : NULL;
+    struct record_writer records;
+    struct dump* dump = new_dump(&view, members->options, arena, out,
+                                 &records, stats);
+    dump->jobs = members->jobs;
+    dump_member(dump, member);
+    const int status = dump_image(dump, arena, err);
+    free_dump(dump);
+    if (stats) {
+        stats->bytes_read += view.bytes_read;
+    }
+    if (arena == &own) {
+        arena_free(&own);
+    } else {
+        arena_reset(arena);
+    }
+    source_close(&view);
+    return status;
+}
+
+local int member_selected(const struct dump_options* options,
+                          const struct archive_member* member,
+                          int* found) {
+    if (options->member_count == 0) {
+        return 1;
+    }
+    int selected = 0;
+    for (size_t i = 0; i < options->member_count; i++) {
+        if (strcmp(options->members[i], member->name) == 0) {
+            found[i] = 1;
+            selected = 1;
+        }
+    }
+    return selected;
+}
+
+// Dumps each member of a static library as a slice of the archive. Only the
+// member headers are read up front; members left out by --member are never
+// touched, and the rest may be dumped concurrently on `jobs` threads.
+local int dump_archive(struct dump* dump, struct arena* arena,
+                       struct output* err, unsigned jobs) {
+    const struct dump_options* options = dump->options;
+    struct archive archive;
+    archive_parse(&archive, dump->source, arena);
+    const int filtered = options->member_count > 0
+        || options->command_count > 0 || options->section_count > 0
+        || is_symbol_query(options) || options->strings != StringsNone
+        || options->hash != HashNone || options->relocs == RelocsSummary
+        || options->fixups;
+    if (!filtered) {
+        dump_archive_header(dump, &archive);
+        if (archive.nsymbols > 0 && !options->header_only) {
+            dump_archive_symbols(dump, &archive);
+        }
+    }
+
+    int* found = arena_alloc(arena, sizeof(*found) * options->member_count);
+    memset(found, 0, sizeof(*found) * options->member_count);
+    struct members members = { dump->source, options, NULL, NULL, NULL, 1 };
+    members.selected = arena_alloc(arena, sizeof(*members.selected)
+                                          * archive.nmembers);
+    size_t count = 0;
+    for (size_t i = 0; i < archive.nmembers; i++) {
+        if (member_selected(options, &archive.members[i], found)) {
+            members.selected[count++] = &archive.members[i];
+        }
+    }
+
+    int status = 0;
+    for (size_t i = 0; i < options->member_count; i++) {
+        if (!found[i]) {
+            output_printf(err, "machdump: {R+}error:{0} Archive does not "
+                          "contain member %s\n", options->members[i]);
+            status = -1;
+        }
+    }
+    struct arena shared;
+    if (jobs <= 1 || count == 1) {
+        arena_init(&shared);
+        members.arena = &shared;
+        members.jobs = jobs;
+    }
+    if (dump->stats) {
+        members.stats = arena_alloc(arena, sizeof(*members.stats) * count);
+        memset(members.stats, 0, sizeof(*members.stats) * count);
+    }
+    if (jobs_run(count, jobs, dump_member_job, &members, dump->out,
+                 err) > 0) {
+        status = -1;
+    }
+    if (members.arena) {
+        arena_free(&shared);
+    }
+    for (size_t i = 0; dump->stats && i < count; i++) {
+        stats_merge(dump->stats, &members.stats[i]);
+    }
+
+    if (archive.status != ArchiveOk) {
+        const char* message = archive_status_message(archive.status);
+        if (dump->records) {
+            record_begin(dump->records, "error");
+            record_string(dump->records, "message", message);
+            record_uint(dump->records, "offset", archive.error_offset);
+            record_end(dump->records);
+        }
+        output_printf(err, "machdump: {R+}error:{0} %s (offset 0x%llx)\n",
+                      message, (unsigned long long)archive.error_offset);
+        status = -1;
+    }
+    return status;
+}
+
+local int dump_source(struct source* source,
+                      const struct dump_options* options,
+                      struct arena* arena, struct output* out,
+                      struct output* err, const struct fat* fat,
+                      const struct slice* slice, struct stats* stats) {
+    struct record_writer records;
+    struct dump* dump = new_dump(source, options, arena, out, &records,
+                                 stats);
+    if (slice) {
+        dump_slice(dump, fat, slice);
+    }
+    // Slices dumped concurrently already use the spare threads.
+    if (fat && !fat->arena) {
+        dump->jobs = 1;
+    }
+    int status;
+    if (archive_is(source)) {
+        status = dump_archive(dump, arena, err, dump->jobs);
+    } else {
+        status = dump_image(dump, arena, err);
+    }
+    free_dump(dump);
+    return status;
+}
+
+local int dump_slice_job(void* context, size_t index, struct output* out,
+                         struct output* err) {
+    const struct fat* fat = context;
+    const struct slice* slice = &fat->slices[index];
+    struct source view;
+    if (source_slice(&view, fat->source, slice->offset, slice->size) != 0) {
+        output_printf(err, "machdump: {R+}error:{0} Architecture at offset "
+                      "0x%llx extends past end of file\n",
+                      (unsigned long long)slice->offset);
+        return -1;
+    }
+    struct arena own;
+    struct arena* arena = fat->arena;
+    if (!arena) {
+        arena_init(&own);
+        arena = &own;
+    }
+    struct stats* stats = fat->stats ? &fat->stats[index] : NULL;
+    const int status = dump_source(&view, fat->options, arena, out, err,
+                                   fat, slice, stats);
+    if (arena == &own) {
+        arena_free(&own);
+    }
+    if (stats) {
+        stats->bytes_read += view.bytes_read;
+    }
+    source_close(&view);
+    return status;
+}
+
+// Dumps each architecture of a fat binary as a slice of the file. Only the
+// fat header and arch table are read here; slices filtered out by --arch are
+// never touched, and the rest may be dumped concurrently.
+local int dump_fat(struct source* source, const struct dump_options* options,
+                   struct arena* arena, struct output* out,
+                   struct output* err, struct stats* stats) {
+    const unsigned char* header = source_read(source, 0,
+                                              sizeof(S(fat_header)));
+    const uint32_t magic = big32(header);
+    const uint32_t nfat_arch = big32(header + 4);
+    struct fat fat = { source, options, magic == FAT_MAGIC_64, NULL, NULL,
+                       NULL };
+    const size_t entry = fat.is_64 ? sizeof(S(fat_arch_64))
+                                   : sizeof(S(fat_arch));
+    const unsigned char* table = source_read(source, sizeof(S(fat_header)),
+                                             nfat_arch * entry);
+    if (!table) {
+        output_printf(err, "machdump: {R+}error:{0} Fat arch table extends "
+                      "past end of file\n");
+        return -1;
+    }
+
+    fat.slices = arena_alloc(arena, sizeof(*fat.slices) * nfat_arch);
+    size_t count = 0;
+    for (uint32_t i = 0; i < nfat_arch; i++) {
+        const unsigned char* arch = table + i * entry;
+        struct slice* slice = &fat.slices[count];
+        slice->cputype = (int32_t)big32(arch);
+        slice->cpusubtype = (int32_t)big32(arch + 4);
+        if (fat.is_64) {
+            slice->offset = big64(arch + 8);
+            slice->size = big64(arch + 16);
+            slice->align = big32(arch + 24);
+        } else {
+            slice->offset = big32(arch + 8);
+            slice->size = big32(arch + 12);
+            slice->align = big32(arch + 16);
+        }
+        if (!options->arch || arch_matches(options->arch, slice->cputype,
+                                           slice->cpusubtype)) {
+            count++;
+        }
+    }
+
+    int status = 0;
+    if (count == 0 && options->arch) {
+        output_printf(err, "machdump: {R+}error:{0} File does not contain "
+                      "architecture %s\n", options->arch->name);
+        status = -1;
+    } else {
+        struct dump dump;
+        struct record_writer records;
+        memset(&dump, 0, sizeof(dump));
+        dump.out = out;
+        if (options->format != DumpText) {
+            record_writer_init(&records, out, options->format == DumpJson
+                                              ? RecordJson : RecordBinary);
+            dump.records = &records;
+        }
+        dump_fat_header(&dump, magic, nfat_arch);
+        if (dump.records) {
+            record_writer_free(dump.records);
+        }
+        if (options->jobs <= 1 || count == 1) {
+            fat.arena = arena;
+        }
+        if (stats) {
+            fat.stats = arena_alloc(arena, sizeof(*fat.stats) * count);
+            memset(fat.stats, 0, sizeof(*fat.stats) * count);
+        }
+        if (jobs_run(count, options->jobs, dump_slice_job, &fat, out,
+                     err) > 0) {
+            status = -1;
+        }
+        for (size_t i = 0; stats && i < count; i++) {
+            stats_merge(stats, &fat.stats[i]);
+        }
+    }
+    return status;
+}
+
+local int is_fat(struct source* source) {
+    const unsigned char* header = source_read(source, 0,
+                                              sizeof(S(fat_header)));
+    if (!header) {
+        return 0;
+    }
+    const uint32_t magic = big32(header);
+    return (magic == FAT_MAGIC || magic == FAT_MAGIC_64)
+        && big32(header + 4) <= FAT_ARCH_MAX;
+}
+
+void mach_dump(void* buffer, const size_t length) {
+    struct source source;
+    struct output out, err;
+    source_from_memory(&source, buffer, length);
+    output_open(&out, STDOUT_FILENO, output_default_color(STDOUT_FILENO));
+    output_open(&err, STDERR_FILENO, output_default_color(STDERR_FILENO));
+    mach_dump_source(&source, NULL, NULL, &out, &err, NULL);
+    output_close(&out);
+    output_close(&err);
+    source_close(&source);
+}
+
+int mach_dump_source(struct source* source,
+                     const struct dump_options* options, struct arena* arena,
+                     struct output* out, struct output* err,
+                     struct stats* stats) {
+    static const struct dump_options defaults;
+    if (!options) {
+        options = &defaults;
+    }
+    struct arena own;
+    if (!arena) {
+        arena_init(&own);
+        arena = &own;
+    }
+    const uint64_t bytes_read = source->bytes_read;
+    const int status = is_fat(source)
+        ? dump_fat(source, options, arena, out, err, stats)
+        : dump_source(source, options, arena, out, err, NULL, NULL, stats);
+    if (arena == &own) {
+        arena_free(&own);
+    }
+    if (stats) {
+        stats->bytes_read += source->bytes_read - bytes_read;
     }
+    return status;
 }
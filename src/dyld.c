@@ -0,0 +1,656 @@
+// src/dyld.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#include "dyld.h"
+#include "leb.h"
+#include <stddef.h>
+#include <string.h>
+#include <mach-o/loader.h>
+#include <mach-o/fixup-chains.h>
+
+#define S(...) struct __VA_ARGS__
+
+// Entries are handed to the visitor DYLD_BATCH at a time.
+#define DYLD_BATCH 256
+// The chained fixup formats supported all have 64-bit pointers.
+#define CHAINED_POINTER_SIZE 8
+
+struct batch {
+    struct dyld_fixup fixups[DYLD_BATCH];
+    size_t count;
+    dyld_fixup_visitor visit;
+    void* context;
+};
+
+static void flush(struct batch* batch) {
+    if (batch->count > 0) {
+        batch->visit(batch->context, batch->fixups, batch->count);
+        batch->count = 0;
+    }
+}
+
+static void add(struct batch* batch, const struct dyld_fixup* fixup) {
+    batch->fixups[batch->count++] = *fixup;
+    if (batch->count == DYLD_BATCH) {
+        flush(batch);
+    }
+}
+
+// The state of an opcode stream: the fixup the next DO_* opcode adds, and
+// where the opcode being run started.
+struct stream {
+    const uint8_t* p;
+    const uint8_t* end;
+    const uint8_t* opcode;
+    const struct dyld_segment* segments;
+    uint32_t nsegments;
+    unsigned pointer_size;
+    int has_segment;
+    struct dyld_fixup fixup;
+    struct batch batch;
+};
+
+static void stream_init(struct stream* stream, enum dyld_fixup_kind kind,
+                        const uint8_t* bytes, size_t size,
+                        const struct dyld_segment* segments,
+                        uint32_t nsegments, unsigned pointer_size,
+                        dyld_fixup_visitor visit, void* context) {
+    memset(&stream->fixup, 0, sizeof(stream->fixup));
+    stream->p = bytes;
+    stream->end = bytes + size;
+    stream->opcode = bytes;
+    stream->segments = segments;
+    stream->nsegments = nsegments;
+    stream->pointer_size = pointer_size;
+    stream->has_segment = 0;
+    stream->fixup.kind = kind;
+    stream->batch.count = 0;
+    stream->batch.visit = visit;
+    stream->batch.context = context;
+}
+
+// Offsets move forward past each fixup without wrapping, so a repeated
+// opcode with a huge count or skip runs out of its segment rather than
+// circling back into it. Only ADD_ADDR opcodes may wrap, to move backwards.
+static void advance(uint64_t* offset, uint64_t delta) {
+    *offset = delta > UINT64_MAX - *offset ? UINT64_MAX : *offset + delta;
+}
+
+static enum image_status emit(struct stream* stream) {
+    if (!stream->has_segment) {
+        return ImageBadFixupSegment;
+    }
+    const struct dyld_segment* segment =
+        &stream->segments[stream->fixup.segment];
+    if (stream->fixup.offset >= segment->vmsize) {
+        return ImageBadFixupAddress;
+    }
+    add(&stream->batch, &stream->fixup);
+    return ImageOk;
+}
+
+// Adds `count` fixups `skip` bytes apart, not counting the pointers.
+static enum image_status emit_times(struct stream* stream, uint64_t count,
+                                    uint64_t skip) {
+    for (uint64_t i = 0; i < count; i++) {
+        const enum image_status status = emit(stream);
+        if (status != ImageOk) {
+            return status;
+        }
+        advance(&stream->fixup.offset, skip);
+        advance(&stream->fixup.offset, stream->pointer_size);
+    }
+    return ImageOk;
+}
+
+static enum image_status set_segment(struct stream* stream,
+                                     uint8_t immediate) {
+    if (immediate >= stream->nsegments) {
+        return ImageBadFixupSegment;
+    }
+    stream->fixup.segment = immediate;
+    stream->has_segment = 1;
+    stream->p = uleb128(stream->p, stream->end, &stream->fixup.offset);
+    return stream->p ? ImageOk : ImageTruncatedFixups;
+}
+
+static enum image_status finish(struct stream* stream,
+                                enum image_status status,
+                                const uint8_t* bytes, size_t* stop) {
+    flush(&stream->batch);
+    if (status != ImageOk) {
+        *stop = (size_t)(stream->opcode - bytes);
+    }
+    return status;
+}
+
+static enum image_status rebase_opcode(struct stream* stream, int* done) {
+    const uint8_t opcode = *stream->p & REBASE_OPCODE_MASK;
+    const uint8_t immediate = *stream->p++ & REBASE_IMMEDIATE_MASK;
+    uint64_t values[2];
+    switch (opcode) {
+        case REBASE_OPCODE_DONE:
+            *done = 1;
+            return ImageOk;
+        case REBASE_OPCODE_SET_TYPE_IMM:
+            stream->fixup.type = immediate;
+            return ImageOk;
+        case REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
+            return set_segment(stream, immediate);
+        case REBASE_OPCODE_ADD_ADDR_ULEB:
+            if (!(stream->p = uleb128(stream->p, stream->end, values))) {
+                return ImageTruncatedFixups;
+            }
+            stream->fixup.offset += values[0];
+            return ImageOk;
+        case REBASE_OPCODE_ADD_ADDR_IMM_SCALED:
+            stream->fixup.offset += (uint64_t)immediate * stream->pointer_size;
+            return ImageOk;
+        case REBASE_OPCODE_DO_REBASE_IMM_TIMES:
+            return emit_times(stream, immediate, 0);
+        case REBASE_OPCODE_DO_REBASE_ULEB_TIMES:
+            if (!(stream->p = uleb128(stream->p, stream->end, values))) {
+                return ImageTruncatedFixups;
+            }
+            return emit_times(stream, values[0], 0);
+        case REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB:
+            if (!(stream->p = uleb128(stream->p, stream->end, values))) {
+                return ImageTruncatedFixups;
+            }
+            return emit_times(stream, 1, values[0]);
+        case REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB:
+            if (!(stream->p = uleb128_n(stream->p, stream->end, values, 2))) {
+                return ImageTruncatedFixups;
+            }
+            return emit_times(stream, values[0], values[1]);
+    }
+    return ImageBadFixupOpcode;
+}
+
+enum image_status dyld_rebases(const uint8_t* bytes, size_t size,
+                               const struct dyld_segment* segments,
+                               uint32_t nsegments, unsigned pointer_size,
+                               dyld_fixup_visitor visit, void* context,
+                               size_t* stop) {
+    struct stream stream;
+    stream_init(&stream, DyldRebase, bytes, size, segments, nsegments,
+                pointer_size, visit, context);
+    enum image_status status = ImageOk;
+    int done = 0;
+    while (status == ImageOk && !done && stream.p < stream.end) {
+        stream.opcode = stream.p;
+        status = rebase_opcode(&stream, &done);
+    }
+    return finish(&stream, status, bytes, stop);
+}
+
+static enum image_status bind_opcode(struct stream* stream, int* done) {
+    const uint8_t opcode = *stream->p & BIND_OPCODE_MASK;
+    const uint8_t immediate = *stream->p++ & BIND_IMMEDIATE_MASK;
+    struct dyld_fixup* fixup = &stream->fixup;
+    uint64_t values[2];
+    const uint8_t* name;
+    switch (opcode) {
+        case BIND_OPCODE_DONE:
+            // Lazy binds are each ended with DONE, so only the end of the
+            // stream ends them all.
+            *done = fixup->kind != DyldLazyBind;
+            return ImageOk;
+        case BIND_OPCODE_SET_DYLIB_ORDINAL_IMM:
+            fixup->ordinal = immediate;
+            return ImageOk;
+        case BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB:
+            if (!(stream->p = uleb128(stream->p, stream->end, values))) {
+                return ImageTruncatedFixups;
+            }
+            fixup->ordinal = (int64_t)values[0];
+            return ImageOk;
+        case BIND_OPCODE_SET_DYLIB_SPECIAL_IMM:
+            // The special ordinals are small negative numbers stored in
+            // the immediate's four bits.
+            fixup->ordinal = immediate == 0
+                ? 0 : (int8_t)(BIND_OPCODE_MASK | immediate);
+            return ImageOk;
+        case BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM:
+            name = stream->p;
+            stream->p = memchr(name, '\0', (size_t)(stream->end - name));
+            if (!stream->p) {
+                return ImageTruncatedFixups;
+            }
+            stream->p++;
+            fixup->symbol = (const char*)name;
+            fixup->flags = immediate;
+            return ImageOk;
+        case BIND_OPCODE_SET_TYPE_IMM:
+            fixup->type = immediate;
+            return ImageOk;
+        case BIND_OPCODE_SET_ADDEND_SLEB:
+            stream->p = sleb128(stream->p, stream->end, &fixup->addend);
+            return stream->p ? ImageOk : ImageTruncatedFixups;
+        case BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
+            return set_segment(stream, immediate);
+        case BIND_OPCODE_ADD_ADDR_ULEB:
+            if (!(stream->p = uleb128(stream->p, stream->end, values))) {
+                return ImageTruncatedFixups;
+            }
+            fixup->offset += values[0];
+            return ImageOk;
+        case BIND_OPCODE_DO_BIND:
+            return emit_times(stream, 1, 0);
+        case BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB:
+            if (!(stream->p = uleb128(stream->p, stream->end, values))) {
+                return ImageTruncatedFixups;
+            }
+            return emit_times(stream, 1, values[0]);
+        case BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED:
+            return emit_times(stream, 1,
+                              (uint64_t)immediate * stream->pointer_size);
+        case BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB:
+            if (!(stream->p = uleb128_n(stream->p, stream->end, values, 2))) {
+                return ImageTruncatedFixups;
+            }
+            return emit_times(stream, values[0], values[1]);
+        case BIND_OPCODE_THREADED:
+            return ImageUnsupportedFixups;
+    }
+    return ImageBadFixupOpcode;
+}
+
+enum image_status dyld_binds(enum dyld_fixup_kind kind, const uint8_t* bytes,
+                             size_t size, const struct dyld_segment* segments,
+                             uint32_t nsegments, unsigned pointer_size,
+                             dyld_fixup_visitor visit, void* context,
+                             size_t* stop) {
+    struct stream stream;
+    stream_init(&stream, kind, bytes, size, segments, nsegments, pointer_size,
+                visit, context);
+    // Weak binds coalesce with definitions in every image, so they have no
+    // dylib of their own.
+    if (kind == DyldWeakBind) {
+        stream.fixup.ordinal = BIND_SPECIAL_DYLIB_WEAK_LOOKUP;
+    }
+    enum image_status status = ImageOk;
+    int done = 0;
+    while (status == ImageOk && !done && stream.p < stream.end) {
+        stream.opcode = stream.p;
+        status = bind_opcode(&stream, &done);
+    }
+    return finish(&stream, status, bytes, stop);
+}
+
+// Chained fixups. Each page of a segment with fixups has the offset of its
+// first pointer; each pointer holds its own target and the distance to the
+// next one, in strides of 4 or 8 bytes depending on the pointer format.
+struct chains {
+    const uint8_t* bytes;
+    size_t size;
+    S(dyld_chained_fixups_header) header;
+    size_t import_size;
+    const struct dyld_segment* segment;
+    uint16_t format;
+    struct batch batch;
+};
+
+static uint16_t read16(const uint8_t* bytes) {
+    uint16_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static uint32_t read32(const uint8_t* bytes) {
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static uint64_t read64(const uint8_t* bytes) {
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+// Whether `count` items of `size` bytes at `offset` lie within `limit`.
+static int fits(uint64_t offset, uint64_t count, uint64_t size,
+                uint64_t limit) {
+    return offset <= limit && (size == 0 || count <= (limit - offset) / size);
+}
+
+// Fills in a bind's dylib, symbol and addend from its entry in the imports
+// table.
+static enum image_status resolve_import(const struct chains* chains,
+                                        uint32_t index,
+                                        struct dyld_fixup* fixup) {
+    const S(dyld_chained_fixups_header*) header = &chains->header;
+    if (index >= header->imports_count) {
+        return ImageBadChainedFixups;
+    }
+    const uint8_t* entry = chains->bytes + header->imports_offset
+                           + (size_t)index * chains->import_size;
+    const uint32_t word = read32(entry);
+    uint32_t name;
+    if (header->imports_format == DYLD_CHAINED_IMPORT_ADDEND64) {
+        fixup->ordinal = (int16_t)(word & 0xffff);
+        fixup->flags = (word >> 16) & 1 ? BIND_SYMBOL_FLAGS_WEAK_IMPORT : 0;
+        name = read32(entry + 4);
+        fixup->addend += (int64_t)read64(entry + 8);
+    } else {
+        fixup->ordinal = (int8_t)(word & 0xff);
+        fixup->flags = (word >> 8) & 1 ? BIND_SYMBOL_FLAGS_WEAK_IMPORT : 0;
+        name = word >> 9;
+        if (header->imports_format == DYLD_CHAINED_IMPORT_ADDEND) {
+            fixup->addend += (int32_t)read32(entry + 4);
+        }
+    }
+    const size_t symbols = header->symbols_offset;
+    if (name >= chains->size - symbols
+        || !memchr(chains->bytes + symbols + name, '\0',
+                   chains->size - symbols - name)) {
+        return ImageBadChainedFixups;
+    }
+    fixup->symbol = (const char*)chains->bytes + symbols + name;
+    return ImageOk;
+}
+
+// Unpacks one pointer into `fixup`. Returns the distance to the next one in
+// strides, or 0 at the end of the chain.
+static uint64_t decode_pointer(uint16_t format, uint64_t raw,
+                               uint32_t* import, struct dyld_fixup* fixup) {
+    int bind;
+    uint64_t next;
+    if (format == DYLD_CHAINED_PTR_64
+        || format == DYLD_CHAINED_PTR_64_OFFSET) {
+        bind = (int)(raw >> 63);
+        next = (raw >> 51) & 0xfff;
+        if (bind) {
+            *import = raw & 0xffffff;
+            fixup->addend = (raw >> 24) & 0xff;
+        } else {
+            fixup->target = (raw & 0xfffffffffull)
+                            | ((raw >> 36) & 0xff) << 56;
+        }
+    } else {
+        fixup->auth = (uint8_t)(raw >> 63);
+        bind = (raw >> 62) & 1;
+        next = (raw >> 51) & 0x7ff;
+        if (bind) {
+            *import = raw & (format == DYLD_CHAINED_PTR_ARM64E_USERLAND24
+                             ? 0xffffff : 0xffff);
+            // The 19-bit addend is signed; authenticated binds have none.
+            const uint64_t addend = (raw >> 32) & 0x7ffff;
+            fixup->addend = fixup->auth ? 0
+                : (int64_t)(addend ^ 0x40000) - 0x40000;
+        } else if (fixup->auth) {
+            fixup->target = raw & 0xffffffff;
+        } else {
+            fixup->target = (raw & 0x7ffffffffffull)
+                            | ((raw >> 43) & 0xff) << 56;
+        }
+    }
+    fixup->kind = bind ? DyldBind : DyldRebase;
+    return next;
+}
+
+static enum image_status walk_chain(struct chains* chains, uint32_t segment,
+                                    uint64_t offset, uint64_t stride) {
+    const struct dyld_segment* bounds = chains->segment;
+    for (;;) {
+        if (!fits(offset, 1, CHAINED_POINTER_SIZE, bounds->filesize)
+            || !fits(offset, 1, CHAINED_POINTER_SIZE, bounds->vmsize)) {
+            return ImageBadFixupAddress;
+        }
+        struct dyld_fixup fixup;
+        memset(&fixup, 0, sizeof(fixup));
+        uint32_t import = 0;
+        const uint64_t next = decode_pointer(chains->format,
+                                             read64(bounds->bytes + offset),
+                                             &import, &fixup);
+        fixup.type = REBASE_TYPE_POINTER;
+        fixup.segment = segment;
+        fixup.offset = offset;
+        if (fixup.kind == DyldBind) {
+            const enum image_status status = resolve_import(chains, import,
+                                                            &fixup);
+            if (status != ImageOk) {
+                return status;
+            }
+        }
+        add(&chains->batch, &fixup);
+        if (next == 0) {
+            return ImageOk;
+        }
+        offset += next * stride;
+    }
+}
+
+static enum image_status walk_segment(struct chains* chains,
+                                      uint32_t segment, size_t start) {
+    const size_t pages = offsetof(S(dyld_chained_starts_in_segment),
+                                  page_start);
+    if (!fits(start, 1, pages, chains->size)) {
+        return ImageTruncatedFixups;
+    }
+    const uint8_t* info = chains->bytes + start;
+    const uint16_t page_size = read16(info + offsetof(
+        S(dyld_chained_starts_in_segment), page_size));
+    const uint16_t page_count = read16(info + offsetof(
+        S(dyld_chained_starts_in_segment), page_count));
+    chains->format = read16(info + offsetof(
+        S(dyld_chained_starts_in_segment), pointer_format));
+    if (!fits(start + pages, page_count, sizeof(uint16_t), chains->size)) {
+        return ImageTruncatedFixups;
+    }
+    uint64_t stride;
+    switch (chains->format) {
+        case DYLD_CHAINED_PTR_64:
+        case DYLD_CHAINED_PTR_64_OFFSET:
+            stride = 4;
+            break;
+        case DYLD_CHAINED_PTR_ARM64E:
+        case DYLD_CHAINED_PTR_ARM64E_USERLAND:
+        case DYLD_CHAINED_PTR_ARM64E_USERLAND24:
+            stride = 8;
+            break;
+        default:
+            return ImageUnsupportedFixups;
+    }
+    for (uint32_t page = 0; page < page_count; page++) {
+        const uint16_t first = read16(info + pages
+                                      + page * sizeof(uint16_t));
+        if (first == DYLD_CHAINED_PTR_START_NONE) {
+            continue;
+        } else if (first & DYLD_CHAINED_PTR_START_MULTI) {
+            // Pages with several chains only occur in 32-bit formats.
+            return ImageBadChainedFixups;
+        }
+        const enum image_status status = walk_chain(
+            chains, segment, (uint64_t)page * page_size + first, stride);
+        if (status != ImageOk) {
+            return status;
+        }
+    }
+    return ImageOk;
+}
+
+enum image_status dyld_chained_fixups(const uint8_t* bytes, size_t size,
+                                      const struct dyld_segment* segments,
+                                      uint32_t nsegments,
+                                      dyld_fixup_visitor visit, void* context,
+                                      size_t* stop) {
+    struct chains chains;
+    S(dyld_chained_fixups_header)* header = &chains.header;
+    chains.bytes = bytes;
+    chains.size = size;
+    chains.batch.count = 0;
+    chains.batch.visit = visit;
+    chains.batch.context = context;
+    *stop = 0;
+    if (size < sizeof(*header)) {
+        return ImageTruncatedFixups;
+    }
+    memcpy(header, bytes, sizeof(*header));
+    switch (header->imports_format) {
+        case DYLD_CHAINED_IMPORT: chains.import_size = 4; break;
+        case DYLD_CHAINED_IMPORT_ADDEND: chains.import_size = 8; break;
+        case DYLD_CHAINED_IMPORT_ADDEND64: chains.import_size = 16; break;
+        default: return ImageUnsupportedFixups;
+    }
+    // Compressed symbol names (symbols_format 1) are not supported.
+    if (header->fixups_version != 0 || header->symbols_format != 0) {
+        return ImageUnsupportedFixups;
+    }
+    if (!fits(header->imports_offset, header->imports_count,
+              chains.import_size, size)
+        || header->symbols_offset > size
+        || !fits(header->starts_offset, 1, sizeof(uint32_t), size)) {
+        return ImageBadChainedFixups;
+    }
+    const size_t starts = header->starts_offset;
+    const uint32_t count = read32(bytes + starts);
+    if (!fits(starts + sizeof(uint32_t), count, sizeof(uint32_t), size)) {
+        *stop = starts;
+        return ImageTruncatedFixups;
+    }
+    enum image_status status = ImageOk;
+    for (uint32_t i = 0; i < count && status == ImageOk; i++) {
+        const uint32_t offset = read32(bytes + starts + sizeof(uint32_t)
+                                       * (i + 1));
+        if (offset == 0) {
+            continue;
+        }
+        *stop = starts + offset;
+        if (i >= nsegments) {
+            status = ImageBadFixupSegment;
+        } else {
+            chains.segment = &segments[i];
+            status = walk_segment(&chains, i, starts + offset);
+        }
+    }
+    flush(&chains.batch);
+    return status;
+}
+
+// The export trie is walked depth first with an explicit stack, building
+// each name in one buffer as edges are followed, so its depth is bounded
+// and the names are not copied per node.
+struct frame {
+    const uint8_t* edge;
+    uint8_t remaining;
+    size_t length;
+};
+
+struct trie {
+    const uint8_t* bytes;
+    const uint8_t* end;
+    struct frame stack[DYLD_EXPORT_DEPTH_MAX];
+    size_t depth;
+    char name[DYLD_EXPORT_NAME_MAX];
+    const uint8_t* at;
+};
+
+static enum image_status visit_node(struct trie* trie, uint64_t offset,
+                                    size_t length, dyld_export_visitor visit,
+                                    void* context) {
+    const uint8_t* end = trie->end;
+    const uint8_t* p = trie->bytes + offset;
+    uint64_t terminal;
+    trie->at = p;
+    if (!(p = uleb128(p, end, &terminal))) {
+        return ImageTruncatedFixups;
+    } else if (terminal > (uint64_t)(end - p)) {
+        return ImageBadExportTrie;
+    }
+    const uint8_t* children = p + terminal;
+    if (terminal > 0) {
+        struct dyld_export entry;
+        memset(&entry, 0, sizeof(entry));
+        trie->name[length] = '\0';
+        entry.name = trie->name;
+        entry.length = length;
+        if (!(p = uleb128(p, children, &entry.flags))) {
+            return ImageBadExportTrie;
+        }
+        if (entry.flags & EXPORT_SYMBOL_FLAGS_REEXPORT) {
+            const uint8_t* import = uleb128(p, children, &entry.other);
+            if (!import || !memchr(import, '\0', (size_t)(children - import))) {
+                return ImageBadExportTrie;
+            }
+            entry.import_name = (const char*)import;
+        } else {
+            if (!(p = uleb128(p, children, &entry.address))) {
+                return ImageBadExportTrie;
+            }
+            if ((entry.flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER)
+                && !uleb128(p, children, &entry.other)) {
+                return ImageBadExportTrie;
+            }
+        }
+        visit(context, &entry);
+    }
+    if (children == end) {
+        return ImageTruncatedFixups;
+    } else if (trie->depth == DYLD_EXPORT_DEPTH_MAX) {
+        return ImageBadExportTrie;
+    }
+    struct frame* frame = &trie->stack[trie->depth++];
+    frame->remaining = *children;
+    frame->edge = children + 1;
+    frame->length = length;
+    return ImageOk;
+}
+
+enum image_status dyld_exports(const uint8_t* bytes, size_t size,
+                               dyld_export_visitor visit, void* context,
+                               size_t* stop) {
+    struct trie trie;
+    trie.bytes = bytes;
+    trie.end = bytes + size;
+    trie.depth = 0;
+    trie.at = bytes;
+    if (size == 0) {
+        return ImageOk;
+    }
+    // Every node takes at least two bytes, so a walk that visits more nodes
+    // than there are bytes has met a cycle.
+    size_t visits = 0;
+    enum image_status status = visit_node(&trie, 0, 0, visit, context);
+    while (status == ImageOk && trie.depth > 0) {
+        struct frame* frame = &trie.stack[trie.depth - 1];
+        if (frame->remaining == 0) {
+            trie.depth--;
+            continue;
+        }
+        const uint8_t* edge = frame->edge;
+        trie.at = edge;
+        const uint8_t* nul = memchr(edge, '\0', (size_t)(trie.end - edge));
+        uint64_t child;
+        if (!nul || !(frame->edge = uleb128(nul + 1, trie.end, &child))) {
+            status = ImageTruncatedFixups;
+        } else if ((size_t)(nul - edge) >= DYLD_EXPORT_NAME_MAX
+                   - frame->length || child >= size || ++visits > size) {
+            status = ImageBadExportTrie;
+        } else {
+            memcpy(trie.name + frame->length, edge, (size_t)(nul - edge));
+            frame->remaining--;
+            status = visit_node(&trie, child,
+                                frame->length + (size_t)(nul - edge), visit,
+                                context);
+        }
+    }
+    if (status != ImageOk) {
+        *stop = (size_t)(trie.at - bytes);
+    }
+    return status;
+}
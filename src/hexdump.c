@@ -0,0 +1,137 @@
+// src/hexdump.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#include "hexdump.h"
+#include "output.h"
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#define ROW 16
+
+static const char digits[16] = "0123456789abcdef";
+
+// Converts 16 bytes to 32 hex digits, high nibble first, and to their ASCII
+// column.
+static void format_row(const unsigned char* in, char* hex, char* ascii) {
+#if defined(__SSE2__)
+    const __m128i v = _mm_loadu_si128((const __m128i*)in);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i letters = _mm_set1_epi8('a' - '0' - 10);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+    __m128i lo = _mm_and_si128(v, mask);
+    hi = _mm_add_epi8(_mm_add_epi8(hi, zero),
+                      _mm_and_si128(_mm_cmpgt_epi8(hi, nine), letters));
+    lo = _mm_add_epi8(_mm_add_epi8(lo, zero),
+                      _mm_and_si128(_mm_cmpgt_epi8(lo, nine), letters));
+    _mm_storeu_si128((__m128i*)hex, _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128((__m128i*)(hex + 16), _mm_unpackhi_epi8(hi, lo));
+
+    // SSE2 only compares signed bytes, so the range check is done with
+    // unsigned min and max instead.
+    const __m128i low = _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(0x20)),
+                                       v);
+    const __m128i high = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x7e)),
+                                        v);
+    const __m128i printable = _mm_and_si128(low, high);
+    _mm_storeu_si128((__m128i*)ascii,
+                     _mm_or_si128(_mm_and_si128(printable, v),
+                                  _mm_andnot_si128(printable,
+                                                   _mm_set1_epi8('.'))));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t v = vld1q_u8(in);
+    const uint8x16_t table = vld1q_u8((const uint8_t*)digits);
+    uint8x16x2_t pairs;
+    pairs.val[0] = vqtbl1q_u8(table, vshrq_n_u8(v, 4));
+    pairs.val[1] = vqtbl1q_u8(table, vandq_u8(v, vdupq_n_u8(0x0f)));
+    vst2q_u8((uint8_t*)hex, pairs);
+
+    const uint8x16_t printable = vandq_u8(vcgeq_u8(v, vdupq_n_u8(0x20)),
+                                          vcleq_u8(v, vdupq_n_u8(0x7e)));
+    vst1q_u8((uint8_t*)ascii, vbslq_u8(printable, v, vdupq_n_u8('.')));
+#else
+    for (size_t i = 0; i < ROW; i++) {
+        hex[2 * i] = digits[in[i] >> 4];
+        hex[2 * i + 1] = digits[in[i] & 0x0f];
+        ascii[i] = in[i] >= 0x20 && in[i] <= 0x7e ? (char)in[i] : '.';
+    }
+#endif
+}
+
+static char* put_row(char* p, const char* prefix, size_t prefix_length,
+                     uint64_t offset, int width, const unsigned char* in,
+                     size_t count) {
+    char hex[2 * ROW];
+    char ascii[ROW];
+    format_row(in, hex, ascii);
+
+    memcpy(p, prefix, prefix_length);
+    p += prefix_length;
+    for (int shift = (width - 1) * 4; shift >= 0; shift -= 4) {
+        *p++ = digits[(offset >> shift) & 0x0f];
+    }
+    *p++ = ' ';
+    for (size_t i = 0; i < ROW; i++) {
+        if (i % 8 == 0) {
+            *p++ = ' ';
+        }
+        if (i < count) {
+            p[0] = hex[2 * i];
+            p[1] = hex[2 * i + 1];
+        } else {
+            p[0] = p[1] = ' ';
+        }
+        p[2] = ' ';
+        p += 3;
+    }
+    *p++ = ' ';
+    *p++ = '|';
+    memcpy(p, ascii, count);
+    p += count;
+    *p++ = '|';
+    *p++ = '\n';
+    return p;
+}
+
+void hexdump(struct output* out, const char* prefix, const void* bytes,
+             size_t length, uint64_t offset) {
+    const unsigned char* in = bytes;
+    const size_t prefix_length = strlen(prefix);
+    const int width = offset + length > UINT32_MAX ? 16 : 8;
+    // Prefix, offset, two spaces, 16 bytes of "xx ", the gap between the
+    // groups, " |", the ASCII column and "|\n".
+    const size_t row_length = prefix_length + (size_t)width + 2 + 3 * ROW + 1
+        + 2 + ROW + 2;
+
+    size_t done = 0;
+    for (; length - done >= ROW; done += ROW) {
+        put_row(output_claim(out, row_length), prefix, prefix_length,
+                offset + done, width, in + done, ROW);
+    }
+    if (done < length) {
+        unsigned char last[ROW] = {0};
+        const size_t count = length - done;
+        memcpy(last, in + done, count);
+        put_row(output_claim(out, row_length - (ROW - count)), prefix,
+                prefix_length, offset + done, width, last, count);
+    }
+}
@@ -0,0 +1,465 @@
+// src/image.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#include "image.h"
+#include "arena.h"
+#include "source.h"
+#include <string.h>
+#include <mach-o/loader.h>
+#include <mach-o/nlist.h>
+#include <mach-o/reloc.h>
+
+#define S(...) struct __VA_ARGS__
+
+static void add_error(struct image* image, enum image_status status,
+                      uint32_t command, uint64_t offset) {
+    if (status == ImageOutOfMemory) {
+        image->out_of_memory = 1;
+    }
+    if (image->error_count++ >= IMAGE_ERROR_MAX) {
+        return;
+    }
+    struct image_error* error = arena_try_alloc(image->arena,
+                                                sizeof(*error));
+    if (!error) {
+        image->out_of_memory = 1;
+        return;
+    }
+    error->next = NULL;
+    error->status = status;
+    error->command = command;
+    error->offset = offset;
+    *image->tail = error;
+    image->tail = &error->next;
+}
+
+static int in_file(const struct image* image, uint64_t offset,
+                   uint64_t size) {
+    const uint64_t length = image->source->length;
+    return offset <= length && size <= length - offset;
+}
+
+// The smallest `cmdsize` the renderers can decode a command from.
+static uint32_t command_minimum(uint32_t cmd) {
+    switch (cmd) {
+        case LC_SYMTAB: return sizeof(S(symtab_command));
+        case LC_DYSYMTAB: return sizeof(S(dysymtab_command));
+        case LC_BUILD_VERSION: return sizeof(S(build_version_command));
+        case LC_DYLD_INFO:
+        case LC_DYLD_INFO_ONLY: return sizeof(S(dyld_info_command));
+        case LC_FUNCTION_STARTS:
+        case LC_DATA_IN_CODE:
+        case LC_DYLD_EXPORTS_TRIE:
+        case LC_DYLD_CHAINED_FIXUPS:
+        case LC_CODE_SIGNATURE: return sizeof(S(linkedit_data_command));
+        default: return sizeof(S(load_command));
+    }
+}
+
+static int is_zerofill(const S(section_64*) sec64) {
+    const uint32_t type = sec64->flags & SECTION_TYPE;
+    return type == S_ZEROFILL || type == S_GB_ZEROFILL
+        || type == S_THREAD_LOCAL_ZEROFILL;
+}
+
+// Sets up the sections of a segment already in the 64-bit layout, `room`
+// being how many fit within the command as stored.
+static void parse_segment(struct image* image, struct image_command* command,
+                          uint32_t index, uint32_t room) {
+    const S(segment_command_64*) seg64 = (const void*)command->header;
+    if (!in_file(image, seg64->fileoff, seg64->filesize)) {
+        add_error(image, ImageSegmentOutOfBounds, index, seg64->fileoff);
+    }
+
+    command->nsects = seg64->nsects;
+    if (seg64->nsects > room) {
+        add_error(image, ImageTooManySections, index, command->offset);
+        command->nsects = room;
+    }
+    command->sections = arena_try_alloc(image->arena,
+                                        sizeof(struct image_section)
+                                        * command->nsects);
+    if (!command->sections) {
+        add_error(image, ImageOutOfMemory, index, command->offset);
+        command->nsects = 0;
+        return;
+    }
+    const S(section_64*) headers = (const void*)(seg64 + 1);
+    for (uint32_t i = 0; i < command->nsects; i++) {
+        struct image_section* section = &command->sections[i];
+        section->header = &headers[i];
+        if (is_zerofill(&headers[i])) {
+            section->contents = ContentsZeroFill;
+        } else if (in_file(image, headers[i].offset, headers[i].size)) {
+            section->contents = ContentsInFile;
+        } else {
+            section->contents = ContentsOutOfBounds;
+            add_error(image, ImageSectionOutOfBounds, index,
+                      headers[i].offset);
+        }
+        const uint64_t relocs = (uint64_t)headers[i].nreloc
+                                * sizeof(S(relocation_info));
+        if (relocs == 0 || in_file(image, headers[i].reloff, relocs)) {
+            section->nreloc = headers[i].nreloc;
+        } else {
+            section->nreloc = 0;
+            add_error(image, ImageRelocationsOutOfBounds, index,
+                      headers[i].reloff);
+        }
+    }
+}
+
+static uint16_t swap16(uint16_t x) {
+    return (uint16_t)(x >> 8 | x << 8);
+}
+
+static uint32_t swap32(uint32_t x) {
+    return x >> 24 | (x >> 8 & 0xff00) | (x << 8 & 0xff0000) | x << 24;
+}
+
+static uint64_t swap64(uint64_t x) {
+    return (uint64_t)swap32((uint32_t)x) << 32 | swap32((uint32_t)(x >> 32));
+}
+
+static void swap_words(void* bytes, size_t count) {
+    uint32_t* words = bytes;
+    for (size_t i = 0; i < count; i++) {
+        words[i] = swap32(words[i]);
+    }
+}
+
+static void swap_doubles(void* bytes, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint64_t value;
+        memcpy(&value, (char*)bytes + i * sizeof(value), sizeof(value));
+        value = swap64(value);
+        memcpy((char*)bytes + i * sizeof(value), &value, sizeof(value));
+    }
+}
+
+// The number of 32-bit fields at the start of each command, which is all of
+// the fixed part of most of them. Anything not listed here has only `cmd`
+// and `cmdsize` swapped.
+static size_t command_words(uint32_t cmd) {
+    switch (cmd) {
+        case LC_SYMTAB: return sizeof(S(symtab_command)) / 4;
+        case LC_DYSYMTAB: return sizeof(S(dysymtab_command)) / 4;
+        case LC_DYLD_INFO:
+        case LC_DYLD_INFO_ONLY: return sizeof(S(dyld_info_command)) / 4;
+        case LC_FUNCTION_STARTS:
+        case LC_DATA_IN_CODE:
+        case LC_CODE_SIGNATURE:
+        case LC_SEGMENT_SPLIT_INFO:
+        case LC_DYLIB_CODE_SIGN_DRS:
+        case LC_LINKER_OPTIMIZATION_HINT:
+        case LC_DYLD_EXPORTS_TRIE:
+        case LC_DYLD_CHAINED_FIXUPS:
+            return sizeof(S(linkedit_data_command)) / 4;
+        case LC_LOAD_DYLIB:
+        case LC_LOAD_WEAK_DYLIB:
+        case LC_REEXPORT_DYLIB:
+        case LC_LOAD_UPWARD_DYLIB:
+        case LC_LAZY_LOAD_DYLIB:
+        case LC_ID_DYLIB: return sizeof(S(dylib_command)) / 4;
+        case LC_LOAD_DYLINKER:
+        case LC_ID_DYLINKER:
+        case LC_DYLD_ENVIRONMENT:
+        case LC_RPATH:
+        case LC_SUB_FRAMEWORK:
+        case LC_SUB_UMBRELLA:
+        case LC_SUB_CLIENT:
+        case LC_SUB_LIBRARY: return sizeof(S(dylinker_command)) / 4;
+        case LC_VERSION_MIN_MACOSX:
+        case LC_VERSION_MIN_IPHONEOS:
+        case LC_VERSION_MIN_TVOS:
+        case LC_VERSION_MIN_WATCHOS:
+            return sizeof(S(version_min_command)) / 4;
+        case LC_BUILD_VERSION: return sizeof(S(build_version_command)) / 4;
+        default: return sizeof(S(load_command)) / 4;
+    }
+}
+
+// Copies a command of a byte-swapped file into the arena in host order.
+// Returns NULL if memory is exhausted.
+static const S(load_command*) swap_command(struct image* image,
+                                           const void* bytes, uint32_t cmd,
+                                           uint32_t cmdsize) {
+    void* copy = arena_try_alloc(image->arena, cmdsize);
+    if (!copy) {
+        return NULL;
+    }
+    memcpy(copy, bytes, cmdsize);
+    const size_t words = command_words(cmd);
+    swap_words(copy, words < cmdsize / 4 ? words : cmdsize / 4);
+    if (cmd == LC_BUILD_VERSION
+        && cmdsize >= sizeof(S(build_version_command))) {
+        const S(build_version_command*) bver = copy;
+        const size_t room = (cmdsize - sizeof(*bver))
+                            / sizeof(S(build_tool_version));
+        swap_words((char*)copy + sizeof(*bver), 2 * (bver->ntools < room
+                                                     ? bver->ntools : room));
+    } else if (cmd == LC_MAIN
+               && cmdsize >= sizeof(S(entry_point_command))) {
+        swap_doubles((char*)copy + sizeof(S(load_command)), 2);
+    } else if (cmd == LC_SOURCE_VERSION
+               && cmdsize >= sizeof(S(source_version_command))) {
+        swap_doubles((char*)copy + sizeof(S(load_command)), 1);
+    }
+    return copy;
+}
+
+// Big-endian files pack the fields of relocation_info from the top of the
+// second word down, so besides swapping, non-scattered entries are
+// repacked into the little-endian layout. Scattered ones already match once
+// swapped.
+static const void* swap_relocations(struct image* image, const void* bytes,
+                                    uint32_t count) {
+    uint32_t* words = arena_try_alloc(image->arena,
+                                      sizeof(*words) * 2 * count);
+    if (!words) {
+        return NULL;
+    }
+    memcpy(words, bytes, sizeof(*words) * 2 * count);
+    swap_words(words, 2 * (size_t)count);
+    for (uint32_t i = 0; i < count; i++) {
+        const uint32_t info = words[2 * i + 1];
+        if (!(words[2 * i] & R_SCATTERED)) {
+            words[2 * i + 1] = info >> 8 | (info >> 7 & 1) << 24
+                               | (info >> 5 & 3) << 25
+                               | (info >> 4 & 1) << 27 | (info & 0xf) << 28;
+        }
+    }
+    return words;
+}
+
+struct image_variant {
+    int wide;
+    int swapped;
+    size_t nlist_size;
+    enum image_status (*parse)(struct image* image);
+    const S(nlist_64*) (*nlist)(struct image* image, const void* bytes,
+                                uint32_t count);
+    const void* (*relocations)(struct image* image, const void* bytes,
+                               uint32_t count);
+    const uint32_t* (*indirect_symbols)(struct image* image,
+                                        const void* bytes, uint32_t count);
+};
+
+#define VARIANT(name) native64_##name
+#define VARIANT_WIDE 1
+#define VARIANT_SWAPPED 0
+#include "image_variant.h"
+#undef VARIANT
+#undef VARIANT_WIDE
+#undef VARIANT_SWAPPED
+
+#define VARIANT(name) swapped64_##name
+#define VARIANT_WIDE 1
+#define VARIANT_SWAPPED 1
+#include "image_variant.h"
+#undef VARIANT
+#undef VARIANT_WIDE
+#undef VARIANT_SWAPPED
+
+#define VARIANT(name) native32_##name
+#define VARIANT_WIDE 0
+#define VARIANT_SWAPPED 0
+#include "image_variant.h"
+#undef VARIANT
+#undef VARIANT_WIDE
+#undef VARIANT_SWAPPED
+
+#define VARIANT(name) swapped32_##name
+#define VARIANT_WIDE 0
+#define VARIANT_SWAPPED 1
+#include "image_variant.h"
+#undef VARIANT
+#undef VARIANT_WIDE
+#undef VARIANT_SWAPPED
+
+enum image_status image_parse(struct image* image, struct source* source,
+                              struct arena* arena) {
+    memset(image, 0, sizeof(*image));
+    image->source = source;
+    image->arena = arena;
+    image->tail = &image->errors;
+
+    const uint32_t* magic = source_read(source, 0, sizeof(*magic));
+    if (!magic) {
+        return ImageNotMachO;
+    }
+    switch (*magic) {
+        case MH_MAGIC_64: image->variant = &native64_variant; break;
+        case MH_CIGAM_64: image->variant = &swapped64_variant; break;
+        case MH_MAGIC: image->variant = &native32_variant; break;
+        case MH_CIGAM: image->variant = &swapped32_variant; break;
+        default: return ImageNotMachO;
+    }
+    image->wide = image->variant->wide;
+    image->swapped = image->variant->swapped;
+    return image->variant->parse(image);
+}
+
+enum image_status image_symbols(struct image* image,
+                                struct image_command* command) {
+    if (command->symbols_parsed) {
+        return command->symbols_status;
+    }
+    command->symbols_parsed = 1;
+    const uint32_t index = (uint32_t)(command - image->commands);
+    const S(symtab_command*) symt = (const void*)command->header;
+    enum image_status status = ImageOk;
+    const size_t size = image->variant->nlist_size;
+    const void* raw = NULL;
+    const char* strings = NULL;
+    if (!in_file(image, symt->symoff, (uint64_t)symt->nsyms * size)) {
+        status = ImageSymbolsOutOfBounds;
+        add_error(image, status, index, symt->symoff);
+    } else if (!in_file(image, symt->stroff, symt->strsize)) {
+        status = ImageStringsOutOfBounds;
+        add_error(image, status, index, symt->stroff);
+    } else if (!(raw = source_read(image->source, symt->symoff,
+                                   symt->nsyms * size))
+               || !(strings = source_read(image->source, symt->stroff,
+                                          symt->strsize))) {
+        status = ImageReadFailed;
+        add_error(image, status, index, symt->symoff);
+    }
+    command->symbols_status = status;
+    if (status != ImageOk) {
+        return status;
+    }
+
+    const S(nlist_64*) nlist = image->variant->nlist(image, raw, symt->nsyms);
+    struct image_symbol* symbols = arena_try_alloc(image->arena,
+                                                   sizeof(*symbols)
+                                                   * symt->nsyms);
+    if (!nlist || !symbols) {
+        command->symbols_status = ImageOutOfMemory;
+        add_error(image, ImageOutOfMemory, index, symt->symoff);
+        return ImageOutOfMemory;
+    }
+    command->nsyms = symt->nsyms;
+    command->nlist = nlist;
+    command->strings = strings;
+    command->symbols = symbols;
+    for (uint32_t i = 0; i < symt->nsyms; i++) {
+        struct image_symbol* symbol = &command->symbols[i];
+        const uint32_t strx = nlist[i].n_un.n_strx;
+        symbol->nlist = &nlist[i];
+        symbol->name = strx < symt->strsize
+                       && memchr(strings + strx, '\0', symt->strsize - strx)
+            ? strings + strx
+            : NULL;
+        if (!symbol->name) {
+            add_error(image, ImageBadStringIndex, index,
+                      (uint64_t)symt->stroff + strx);
+        }
+    }
+    return ImageOk;
+}
+
+const struct relocation_info* image_relocations(
+    struct image* image, const struct image_section* section) {
+    const void* bytes = source_read(image->source, section->header->reloff,
+                                    (size_t)section->nreloc
+                                    * sizeof(S(relocation_info)));
+    if (!bytes) {
+        return NULL;
+    }
+    const S(relocation_info*) relocs =
+        image->variant->relocations(image, bytes, section->nreloc);
+    image->out_of_memory |= !relocs;
+    return relocs;
+}
+
+const uint32_t* image_indirect_symbols(struct image* image,
+                                       const struct image_command* command) {
+    const S(dysymtab_command*) dsymt = (const void*)command->header;
+    const void* bytes = source_read(image->source, dsymt->indirectsymoff,
+                                    (size_t)dsymt->nindirectsyms
+                                    * sizeof(uint32_t));
+    if (!bytes) {
+        return NULL;
+    }
+    const uint32_t* symbols =
+        image->variant->indirect_symbols(image, bytes, dsymt->nindirectsyms);
+    image->out_of_memory |= !symbols;
+    return symbols;
+}
+
+size_t image_nlist_size(const struct image* image) {
+    return image->variant->nlist_size;
+}
+
+int image_is_segment(uint32_t cmd) {
+    return cmd == LC_SEGMENT_64 || cmd == LC_SEGMENT;
+}
+
+void image_add_error(struct image* image, enum image_status status,
+                     uint32_t command, uint64_t offset) {
+    add_error(image, status, command, offset);
+}
+
+const char* image_status_message(enum image_status status) {
+    switch (status) {
+        case ImageOk: return "No error";
+        case ImageNotMachO: return "Expected mach-o file";
+        case ImageCommandsOutOfBounds:
+            return "Load commands extend past end of file";
+        case ImageBadCommandSize:
+            return "Load command size is invalid; later commands skipped";
+        case ImageTruncatedCommand:
+            return "Load command is too small for its type";
+        case ImageBadSegmentWidth:
+            return "Segment command does not match the file's width";
+        case ImageTooManySections:
+            return "Segment has more sections than fit in the command";
+        case ImageSegmentOutOfBounds:
+            return "Segment extends past end of file";
+        case ImageSectionOutOfBounds:
+            return "Section contents extend past end of file";
+        case ImageSymbolsOutOfBounds:
+            return "Symbol table extends past end of file";
+        case ImageStringsOutOfBounds:
+            return "String table extends past end of file";
+        case ImageBadStringIndex:
+            return "Symbol name lies outside the string table";
+        case ImageRelocationsOutOfBounds:
+            return "Relocation entries extend past end of file";
+        case ImageIndirectSymbolsOutOfBounds:
+            return "Indirect symbol table extends past end of file";
+        case ImageBadSymbolRanges:
+            return "Symbol ranges lie outside the symbol table";
+        case ImageBadIndirectRange:
+            return "Section's indirect symbols lie outside their table";
+        case ImageFixupsOutOfBounds:
+            return "Fixup data extends past end of file";
+        case ImageTruncatedFixups:
+            return "Fixup data ends in the middle of an entry";
+        case ImageBadFixupOpcode: return "Unknown opcode in dyld info";
+        case ImageBadFixupSegment:
+            return "Fixup refers to a segment that does not exist";
+        case ImageBadFixupAddress: return "Fixup lies outside its segment";
+        case ImageBadChainedFixups: return "Chained fixups are malformed";
+        case ImageBadExportTrie: return "Export trie is malformed";
+        case ImageUnsupportedFixups:
+            return "Fixup format is not supported";
+        case ImageReadFailed: return "Could not read from file";
+        case ImageOutOfMemory: return "Out of memory";
+    }
+    return "Unknown error";
+}
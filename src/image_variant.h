@@ -0,0 +1,292 @@
+// src/image_variant.h
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+// One variant of the image parser, for the width and byte order given by
+// VARIANT_WIDE and VARIANT_SWAPPED. image.c includes this once for each of
+// the four kinds of Mach-O file, with VARIANT(name) giving the functions of
+// each their own names. Every variant hands out the layout of native 64-bit
+// files: the native 64-bit one returns pointers into the source as they are,
+// and the others convert what they parse into the arena, so swapping and
+// widening cost nothing for native 64-bit files and are done only once for
+// the rest.
+
+#if VARIANT_SWAPPED
+#define LOAD16(x) swap16(x)
+#define LOAD32(x) swap32(x)
+#define LOAD64(x) swap64(x)
+#else
+#define LOAD16(x) (x)
+#define LOAD32(x) (x)
+#define LOAD64(x) (x)
+#endif
+
+#if VARIANT_WIDE
+#define HEADER_T S(mach_header_64)
+#define SEGMENT_T S(segment_command_64)
+#define SECTION_T S(section_64)
+#define NLIST_T S(nlist_64)
+#define LC_SEGMENT_T LC_SEGMENT_64
+#define LC_SEGMENT_OTHER LC_SEGMENT
+#define LOADW(x) LOAD64(x)
+#else
+#define HEADER_T S(mach_header)
+#define SEGMENT_T S(segment_command)
+#define SECTION_T S(section)
+#define NLIST_T S(nlist)
+#define LC_SEGMENT_T LC_SEGMENT
+#define LC_SEGMENT_OTHER LC_SEGMENT_64
+#define LOADW(x) LOAD32(x)
+#endif
+
+#define VARIANT_CONVERTS (VARIANT_SWAPPED || !VARIANT_WIDE)
+
+#if VARIANT_CONVERTS
+static const S(mach_header_64*) VARIANT(header)(struct image* image,
+                                                const HEADER_T* raw) {
+    S(mach_header_64)* header = arena_try_alloc(image->arena,
+                                                sizeof(*header));
+    if (!header) {
+        return NULL;
+    }
+    // The magic is kept as stored, so dumps show what the file holds.
+    header->magic = raw->magic;
+    header->cputype = (int32_t)LOAD32((uint32_t)raw->cputype);
+    header->cpusubtype = (int32_t)LOAD32((uint32_t)raw->cpusubtype);
+    header->filetype = LOAD32(raw->filetype);
+    header->ncmds = LOAD32(raw->ncmds);
+    header->sizeofcmds = LOAD32(raw->sizeofcmds);
+    header->flags = LOAD32(raw->flags);
+#if VARIANT_WIDE
+    header->reserved = LOAD32(raw->reserved);
+#else
+    header->reserved = 0;
+#endif
+    return header;
+}
+
+// Converts a segment and the first `nsects` of its sections.
+static const S(load_command*) VARIANT(segment)(struct image* image,
+                                               const SEGMENT_T* raw,
+                                               uint32_t nsects) {
+    S(segment_command_64)* seg64 = arena_try_alloc(image->arena,
+                                                   sizeof(*seg64)
+                                                   + sizeof(S(section_64))
+                                                     * nsects);
+    if (!seg64) {
+        return NULL;
+    }
+    seg64->cmd = LOAD32(raw->cmd);
+    seg64->cmdsize = LOAD32(raw->cmdsize);
+    memcpy(seg64->segname, raw->segname, sizeof(seg64->segname));
+    seg64->vmaddr = LOADW(raw->vmaddr);
+    seg64->vmsize = LOADW(raw->vmsize);
+    seg64->fileoff = LOADW(raw->fileoff);
+    seg64->filesize = LOADW(raw->filesize);
+    seg64->maxprot = (int32_t)LOAD32((uint32_t)raw->maxprot);
+    seg64->initprot = (int32_t)LOAD32((uint32_t)raw->initprot);
+    seg64->nsects = LOAD32(raw->nsects);
+    seg64->flags = LOAD32(raw->flags);
+    const SECTION_T* sections = (const void*)(raw + 1);
+    S(section_64)* sec64 = (void*)(seg64 + 1);
+    for (uint32_t i = 0; i < nsects; i++) {
+        memcpy(sec64[i].sectname, sections[i].sectname,
+               sizeof(sec64[i].sectname));
+        memcpy(sec64[i].segname, sections[i].segname,
+               sizeof(sec64[i].segname));
+        sec64[i].addr = LOADW(sections[i].addr);
+        sec64[i].size = LOADW(sections[i].size);
+        sec64[i].offset = LOAD32(sections[i].offset);
+        sec64[i].align = LOAD32(sections[i].align);
+        sec64[i].reloff = LOAD32(sections[i].reloff);
+        sec64[i].nreloc = LOAD32(sections[i].nreloc);
+        sec64[i].flags = LOAD32(sections[i].flags);
+        sec64[i].reserved1 = LOAD32(sections[i].reserved1);
+        sec64[i].reserved2 = LOAD32(sections[i].reserved2);
+#if VARIANT_WIDE
+        sec64[i].reserved3 = LOAD32(sections[i].reserved3);
+#else
+        sec64[i].reserved3 = 0;
+#endif
+    }
+    return (const void*)seg64;
+}
+#endif
+
+static enum image_status VARIANT(parse)(struct image* image) {
+    const HEADER_T* raw = source_read(image->source, 0, sizeof(*raw));
+    if (!raw) {
+        return ImageNotMachO;
+    }
+#if VARIANT_CONVERTS
+    image->header = VARIANT(header)(image, raw);
+    if (!image->header) {
+        return ImageOutOfMemory;
+    }
+#else
+    image->header = raw;
+#endif
+    image->header_size = sizeof(*raw);
+
+    // The load commands are the only region every dump needs, so they are
+    // read as one block and everything else is fetched on demand.
+    const size_t length = image->header->sizeofcmds;
+    const char* buffer = source_read(image->source, sizeof(*raw), length);
+    if (!buffer) {
+        return ImageCommandsOutOfBounds;
+    }
+
+    // Every command takes at least 8 bytes, which bounds a corrupt ncmds.
+    const size_t most = length / sizeof(S(load_command));
+    const size_t ncmds = image->header->ncmds < most ? image->header->ncmds
+                                                     : most;
+    image->commands = arena_try_alloc(image->arena,
+                                      sizeof(struct image_command) * ncmds);
+    if (!image->commands) {
+        return ImageOutOfMemory;
+    }
+    size_t cursor = 0;
+    for (uint32_t i = 0; i < image->header->ncmds; i++) {
+        const S(load_command*) load_command = (const void*)(buffer + cursor);
+        const uint32_t cmdsize = length - cursor < sizeof(*load_command)
+            ? 0 : LOAD32(load_command->cmdsize);
+        if (cmdsize < sizeof(*load_command) || cmdsize > length - cursor) {
+            add_error(image, ImageBadCommandSize, i, sizeof(*raw) + cursor);
+            break;
+        }
+        const uint32_t cmd = LOAD32(load_command->cmd);
+        struct image_command* command = &image->commands[image->ncmds++];
+        memset(command, 0, sizeof(*command));
+        command->offset = sizeof(*raw) + cursor;
+        command->header = load_command;
+        cursor += cmdsize;
+
+#if VARIANT_SWAPPED
+        if (cmd != LC_SEGMENT_T || cmdsize < sizeof(SEGMENT_T)) {
+            command->header = swap_command(image, load_command, cmd,
+                                           cmdsize);
+            if (!command->header) {
+                return ImageOutOfMemory;
+            }
+        }
+#endif
+        if (cmd == LC_SEGMENT_OTHER) {
+            command->truncated = 1;
+            add_error(image, ImageBadSegmentWidth, i, command->offset);
+        } else if (cmd == LC_SEGMENT_T && cmdsize < sizeof(SEGMENT_T)) {
+            command->truncated = 1;
+            add_error(image, ImageTruncatedCommand, i, command->offset);
+        } else if (cmd == LC_SEGMENT_T) {
+            const SEGMENT_T* segment = (const void*)load_command;
+            const uint32_t room = (uint32_t)((cmdsize - sizeof(*segment))
+                                             / sizeof(SECTION_T));
+#if VARIANT_CONVERTS
+            const uint32_t nsects = LOAD32(segment->nsects);
+            command->header = VARIANT(segment)(image, segment,
+                                               nsects < room ? nsects : room);
+            if (!command->header) {
+                return ImageOutOfMemory;
+            }
+#endif
+            parse_segment(image, command, i, room);
+        } else if (cmdsize < command_minimum(cmd)) {
+            command->truncated = 1;
+            add_error(image, ImageTruncatedCommand, i, command->offset);
+        } else if (cmd == LC_SYMTAB && !image->symtab) {
+            image->symtab = command;
+        }
+    }
+    return ImageOk;
+}
+
+static const S(nlist_64*) VARIANT(nlist)(struct image* image,
+                                         const void* bytes, uint32_t count) {
+#if VARIANT_CONVERTS
+    const NLIST_T* raw = bytes;
+    S(nlist_64)* nlist = arena_try_alloc(image->arena,
+                                         sizeof(*nlist) * count);
+    if (!nlist) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        nlist[i].n_un.n_strx = LOAD32(raw[i].n_un.n_strx);
+        nlist[i].n_type = raw[i].n_type;
+        nlist[i].n_sect = raw[i].n_sect;
+        nlist[i].n_desc = LOAD16((uint16_t)raw[i].n_desc);
+        nlist[i].n_value = LOADW(raw[i].n_value);
+    }
+    return nlist;
+#else
+    (void)image;
+    (void)count;
+    return bytes;
+#endif
+}
+
+// Relocation entries and indirect symbols are the same size in 32-bit and
+// 64-bit files, so only their byte order matters.
+static const void* VARIANT(relocations)(struct image* image,
+                                        const void* bytes, uint32_t count) {
+#if VARIANT_SWAPPED
+    return swap_relocations(image, bytes, count);
+#else
+    (void)image;
+    (void)count;
+    return bytes;
+#endif
+}
+
+static const uint32_t* VARIANT(indirect_symbols)(struct image* image,
+                                                 const void* bytes,
+                                                 uint32_t count) {
+#if VARIANT_SWAPPED
+    uint32_t* symbols = arena_try_alloc(image->arena,
+                                        sizeof(*symbols) * count);
+    if (!symbols) {
+        return NULL;
+    }
+    memcpy(symbols, bytes, sizeof(*symbols) * count);
+    for (uint32_t i = 0; i < count; i++) {
+        symbols[i] = swap32(symbols[i]);
+    }
+    return symbols;
+#else
+    (void)image;
+    (void)count;
+    return bytes;
+#endif
+}
+
+static const struct image_variant VARIANT(variant) = {
+    VARIANT_WIDE,
+    VARIANT_SWAPPED,
+    sizeof(NLIST_T),
+    VARIANT(parse),
+    VARIANT(nlist),
+    VARIANT(relocations),
+    VARIANT(indirect_symbols)
+};
+
+#undef LOAD16
+#undef LOAD32
+#undef LOAD64
+#undef HEADER_T
+#undef SEGMENT_T
+#undef SECTION_T
+#undef NLIST_T
+#undef LC_SEGMENT_T
+#undef LC_SEGMENT_OTHER
+#undef LOADW
+#undef VARIANT_CONVERTS
@@ -0,0 +1,343 @@
+// src/jobs.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#define _POSIX_C_SOURCE 200809L
+#define _DARWIN_C_SOURCE
+
+#include "jobs.h"
+#include "output.h"
+#include "safe.h"
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+// Workers may run at most this many jobs per thread ahead of the job being
+// flushed, which bounds how much rendered output is held in memory.
+#define WINDOW_PER_THREAD 4
+
+struct slot {
+    struct output out;
+    struct output err;
+    int status;
+    int done;
+};
+
+struct pool {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_cond_t room;
+    size_t count;
+    size_t next;
+    size_t flushed;
+    size_t window;
+    struct slot* slots;
+    job_func func;
+    void* context;
+    // For jobs_stream: `input` serializes calls to `next`, and `ended` is
+    // set, with `count` the number of jobs, once it reports the end.
+    pthread_mutex_t input;
+    job_next next_job;
+    int ended;
+    int color;
+    int err_color;
+};
+
+// Slots form a ring of `window` entries whose buffers are opened once and
+// reused by every job that lands in them.
+static void open_slots(struct pool* pool) {
+    pool->slots = xmalloc(sizeof(*pool->slots) * pool->window);
+    memset(pool->slots, 0, sizeof(*pool->slots) * pool->window);
+    for (size_t i = 0; i < pool->window; i++) {
+        output_open_memory(&pool->slots[i].out, pool->color);
+        output_open_memory(&pool->slots[i].err, pool->err_color);
+    }
+}
+
+static void close_slots(struct pool* pool) {
+    for (size_t i = 0; i < pool->window; i++) {
+        output_close(&pool->slots[i].out);
+        output_close(&pool->slots[i].err);
+    }
+    xfree(pool->slots);
+}
+
+static void run_slot(struct pool* pool, struct slot* slot, size_t index) {
+    slot->status = pool->func(pool->context, index, &slot->out, &slot->err);
+}
+
+static void* worker(void* arg) {
+    struct pool* pool = arg;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->next < pool->count
+               && pool->next >= pool->flushed + pool->window) {
+            pthread_cond_wait(&pool->room, &pool->lock);
+        }
+        if (pool->next >= pool->count) {
+            break;
+        }
+        const size_t index = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        struct slot* slot = &pool->slots[index % pool->window];
+        run_slot(pool, slot, index);
+
+        pthread_mutex_lock(&pool->lock);
+        slot->done = 1;
+        pthread_cond_broadcast(&pool->ready);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// A stream job is only fetched once the job `window` places before it has
+// been flushed from its slot.
+static void* stream_worker(void* arg) {
+    struct pool* pool = arg;
+    pthread_mutex_lock(&pool->input);
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->ended && pool->next >= pool->flushed + pool->window) {
+            pthread_cond_wait(&pool->room, &pool->lock);
+        }
+        const size_t index = pool->next;
+        const int ended = pool->ended;
+        pthread_mutex_unlock(&pool->lock);
+        if (ended) {
+            break;
+        }
+
+        const int fetched = pool->next_job(pool->context, index) == 0;
+
+        pthread_mutex_lock(&pool->lock);
+        if (!fetched) {
+            pool->ended = 1;
+            pool->count = index;
+            pthread_cond_broadcast(&pool->ready);
+            pthread_cond_broadcast(&pool->room);
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        pool->next = index + 1;
+        pthread_mutex_unlock(&pool->lock);
+        pthread_mutex_unlock(&pool->input);
+
+        struct slot* slot = &pool->slots[index % pool->window];
+        run_slot(pool, slot, index);
+
+        pthread_mutex_lock(&pool->lock);
+        slot->done = 1;
+        pthread_cond_broadcast(&pool->ready);
+        pthread_mutex_unlock(&pool->lock);
+        pthread_mutex_lock(&pool->input);
+    }
+    pthread_mutex_unlock(&pool->input);
+    return NULL;
+}
+
+// Diagnostics are flushed after each job, behind that job's output, so they
+// appear next to the file they concern.
+static void flush_diagnostics(struct output* out, struct output* err) {
+    if (err->length > 0) {
+        output_flush(out);
+        output_flush(err);
+    }
+}
+
+static size_t run_serial(size_t count, job_func func, void* context,
+                         struct output* out, struct output* err) {
+    size_t failures = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (func(context, i, out, err) != 0) {
+            failures++;
+        }
+        flush_diagnostics(out, err);
+    }
+    return failures;
+}
+
+// Writes out a finished slot and empties its buffers. Returns its status.
+static int collect(struct slot* slot, struct output* out,
+                   struct output* err) {
+    output_write(out, slot->out.data, slot->out.length);
+    output_write(err, slot->err.data, slot->err.length);
+    flush_diagnostics(out, err);
+    output_reset(&slot->out);
+    output_reset(&slot->err);
+    return slot->status;
+}
+
+size_t jobs_run(size_t count, unsigned threads, job_func func, void* context,
+                struct output* out, struct output* err) {
+    if (threads > count) {
+        threads = (unsigned)count;
+    }
+    if (threads <= 1) {
+        return run_serial(count, func, context, out, err);
+    }
+
+    struct pool pool;
+    memset(&pool, 0, sizeof(pool));
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.ready, NULL);
+    pthread_cond_init(&pool.room, NULL);
+    pool.count = count;
+    pool.window = jobs_window(threads);
+    if (pool.window > count) {
+        pool.window = count;
+    }
+    pool.func = func;
+    pool.context = context;
+    pool.color = out->color;
+    pool.err_color = err->color;
+    open_slots(&pool);
+
+    pthread_t* workers = xmalloc(sizeof(*workers) * threads);
+    unsigned started = 0;
+    for (; started < threads; started++) {
+        if (pthread_create(&workers[started], NULL, worker, &pool) != 0) {
+            break;
+        }
+    }
+    if (started == 0) {
+        xfree(workers);
+        close_slots(&pool);
+        return run_serial(count, func, context, out, err);
+    }
+
+    size_t failures = 0;
+    for (size_t i = 0; i < count; i++) {
+        struct slot* slot = &pool.slots[i % pool.window];
+        pthread_mutex_lock(&pool.lock);
+        while (!slot->done) {
+            pthread_cond_wait(&pool.ready, &pool.lock);
+        }
+        pthread_mutex_unlock(&pool.lock);
+
+        if (collect(slot, out, err) != 0) {
+            failures++;
+        }
+
+        pthread_mutex_lock(&pool.lock);
+        slot->done = 0;
+        pool.flushed = i + 1;
+        pthread_cond_broadcast(&pool.room);
+        pthread_mutex_unlock(&pool.lock);
+    }
+
+    for (unsigned i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    xfree(workers);
+    close_slots(&pool);
+    pthread_cond_destroy(&pool.room);
+    pthread_cond_destroy(&pool.ready);
+    pthread_mutex_destroy(&pool.lock);
+    return failures;
+}
+
+static size_t stream_serial(job_next next, job_func func, void* context,
+                            struct output* out, struct output* err) {
+    size_t failures = 0;
+    for (size_t i = 0; next(context, i) == 0; i++) {
+        if (func(context, i, out, err) != 0) {
+            failures++;
+        }
+        output_flush(out);
+        output_flush(err);
+    }
+    return failures;
+}
+
+size_t jobs_stream(unsigned threads, job_next next, job_func func,
+                   void* context, struct output* out, struct output* err) {
+    if (threads <= 1) {
+        return stream_serial(next, func, context, out, err);
+    }
+
+    struct pool pool;
+    memset(&pool, 0, sizeof(pool));
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_mutex_init(&pool.input, NULL);
+    pthread_cond_init(&pool.ready, NULL);
+    pthread_cond_init(&pool.room, NULL);
+    pool.window = jobs_window(threads);
+    pool.func = func;
+    pool.context = context;
+    pool.next_job = next;
+    pool.color = out->color;
+    pool.err_color = err->color;
+    open_slots(&pool);
+
+    pthread_t* workers = xmalloc(sizeof(*workers) * threads);
+    unsigned started = 0;
+    for (; started < threads; started++) {
+        if (pthread_create(&workers[started], NULL, stream_worker, &pool)
+            != 0) {
+            break;
+        }
+    }
+    if (started == 0) {
+        xfree(workers);
+        close_slots(&pool);
+        return stream_serial(next, func, context, out, err);
+    }
+
+    size_t failures = 0;
+    for (size_t i = 0;; i++) {
+        struct slot* slot = &pool.slots[i % pool.window];
+        pthread_mutex_lock(&pool.lock);
+        while (!slot->done && !(pool.ended && i >= pool.count)) {
+            pthread_cond_wait(&pool.ready, &pool.lock);
+        }
+        const int done = slot->done;
+        pthread_mutex_unlock(&pool.lock);
+        if (!done) {
+            break;
+        }
+
+        if (collect(slot, out, err) != 0) {
+            failures++;
+        }
+        output_flush(out);
+
+        pthread_mutex_lock(&pool.lock);
+        slot->done = 0;
+        pool.flushed = i + 1;
+        pthread_cond_broadcast(&pool.room);
+        pthread_mutex_unlock(&pool.lock);
+    }
+
+    for (unsigned i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    xfree(workers);
+    close_slots(&pool);
+    pthread_cond_destroy(&pool.room);
+    pthread_cond_destroy(&pool.ready);
+    pthread_mutex_destroy(&pool.input);
+    pthread_mutex_destroy(&pool.lock);
+    return failures;
+}
+
+size_t jobs_window(unsigned threads) {
+    return (size_t)(threads > 1 ? threads : 1) * WINDOW_PER_THREAD;
+}
+
+unsigned jobs_default_threads(void) {
+    const long online = sysconf(_SC_NPROCESSORS_ONLN);
+    return online > 0 ? (unsigned)online : 1;
+}
@@ -0,0 +1,131 @@
+// src/leb.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#include "leb.h"
+#include <string.h>
+
+#define CONTINUATION 0x8080808080808080ull
+
+// Returns the number of bytes in the value starting in `word`, or 0 if all
+// 8 bytes have the continuation bit set.
+static unsigned encoded_length(uint64_t word) {
+    const uint64_t stops = ~word & CONTINUATION;
+    if (stops == 0) {
+        return 0;
+    }
+    #if defined(__GNUC__)
+    return (unsigned)__builtin_ctzll(stops) / 8 + 1;
+    #else
+    unsigned length = 1;
+    while (!(stops & (0x80ull << (8 * (length - 1))))) {
+        length++;
+    }
+    return length;
+    #endif
+}
+
+// Packs the low 7 bits of each of the first `length` bytes of `word` into
+// one value, pairing neighbours at each step instead of looping over bytes.
+static uint64_t pack(uint64_t word, unsigned length) {
+    if (length < 8) {
+        word &= (1ull << (8 * length)) - 1;
+    }
+    word &= ~CONTINUATION;
+    word = (word & 0x007f007f007f007full) | ((word & 0x7f007f007f007f00ull)
+                                             >> 1);
+    word = (word & 0x00003fff00003fffull) | ((word & 0x3fff00003fff0000ull)
+                                             >> 2);
+    return (word & 0x000000000fffffffull) | ((word & 0x0fffffff00000000ull)
+                                             >> 4);
+}
+
+// Reads a whole value a byte at a time: used near the end of the buffer
+// and for values longer than 8 bytes. Unsigned values whose bits do not fit
+// in 64 are rejected; the sign extension of long signed ones is dropped.
+static const uint8_t* decode_bytes(const uint8_t* p, const uint8_t* end,
+                                   uint64_t* value, unsigned* shift,
+                                   int is_signed) {
+    uint64_t result = 0;
+    unsigned bits = 0;
+    for (;;) {
+        if (p == end) {
+            return NULL;
+        }
+        const uint64_t byte = *p++;
+        const uint64_t slice = byte & 0x7f;
+        if (!is_signed && (bits >= 64 ? slice != 0
+                                      : (slice << bits) >> bits != slice)) {
+            return NULL;
+        }
+        if (bits < 64) {
+            result |= slice << bits;
+        }
+        bits += 7;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    *value = result;
+    *shift = bits;
+    return p;
+}
+
+static const uint8_t* decode(const uint8_t* p, const uint8_t* end,
+                             uint64_t* value, unsigned* shift,
+                             int is_signed) {
+    if (p < end && !(*p & 0x80)) {
+        *value = *p;
+        *shift = 7;
+        return p + 1;
+    }
+    if (end - p >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        const unsigned length = encoded_length(word);
+        if (length != 0) {
+            *value = pack(word, length);
+            *shift = 7 * length;
+            return p + length;
+        }
+    }
+    return decode_bytes(p, end, value, shift, is_signed);
+}
+
+const uint8_t* uleb128(const uint8_t* p, const uint8_t* end,
+                       uint64_t* value) {
+    unsigned shift;
+    return decode(p, end, value, &shift, 0);
+}
+
+const uint8_t* sleb128(const uint8_t* p, const uint8_t* end, int64_t* value) {
+    uint64_t bits;
+    unsigned shift;
+    p = decode(p, end, &bits, &shift, 1);
+    if (p && shift < 64 && (p[-1] & 0x40)) {
+        bits |= ~0ull << shift;
+    }
+    *value = (int64_t)bits;
+    return p;
+}
+
+const uint8_t* uleb128_n(const uint8_t* p, const uint8_t* end,
+                         uint64_t* values, size_t count) {
+    unsigned shift;
+    for (size_t i = 0; i < count && p; i++) {
+        p = decode(p, end, &values[i], &shift, 0);
+    }
+    return p;
+}
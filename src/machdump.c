@@ -0,0 +1,305 @@
+// src/machdump.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#include "machdump.h"
+#include "arena.h"
+#include "image.h"
+#include "relocs.h"
+#include "source.h"
+#include <mach-o/loader.h>
+#include <mach-o/nlist.h>
+#include <mach-o/reloc.h>
+#include <string.h>
+
+#define S(...) struct __VA_ARGS__
+
+#define local static inline
+
+// Calls `callback` if the visitor has it, continuing past missing ones.
+#define VISIT(visitor, callback, ...) \
+    ((visitor)->callback ? (visitor)->callback(__VA_ARGS__) : MachdumpContinue)
+
+// The public structures are filled in on the stack from the image as the
+// walk reaches each part, so callers never see the image's own.
+local void fill_header(struct machdump_header* header,
+                       const struct image* image) {
+    header->magic = image->header->magic;
+    header->cputype = image->header->cputype;
+    header->cpusubtype = image->header->cpusubtype;
+    header->filetype = image->header->filetype;
+    header->ncmds = image->header->ncmds;
+    header->sizeofcmds = image->header->sizeofcmds;
+    header->flags = image->header->flags;
+    header->wide = image->wide;
+    header->swapped = image->swapped;
+}
+
+local void fill_command(struct machdump_command* command,
+                        const struct image_command* from, uint32_t index) {
+    command->index = index;
+    command->cmd = from->header->cmd;
+    command->cmdsize = from->header->cmdsize;
+    command->offset = from->offset;
+    command->truncated = from->truncated;
+    command->data = from->header;
+}
+
+local void fill_segment(struct machdump_segment* segment,
+                        const struct image_command* from) {
+    const S(segment_command_64*) seg64 = (const void*)from->header;
+    memcpy(segment->segname, seg64->segname, sizeof(segment->segname));
+    segment->vmaddr = seg64->vmaddr;
+    segment->vmsize = seg64->vmsize;
+    segment->fileoff = seg64->fileoff;
+    segment->filesize = seg64->filesize;
+    segment->maxprot = seg64->maxprot;
+    segment->initprot = seg64->initprot;
+    segment->nsects = seg64->nsects;
+    segment->flags = seg64->flags;
+}
+
+local void fill_section(struct machdump_section* section,
+                        const struct image_section* from, uint32_t index) {
+    const S(section_64*) sec64 = from->header;
+    section->index = index;
+    memcpy(section->sectname, sec64->sectname, sizeof(section->sectname));
+    memcpy(section->segname, sec64->segname, sizeof(section->segname));
+    section->addr = sec64->addr;
+    section->size = sec64->size;
+    section->offset = sec64->offset;
+    section->align = sec64->align;
+    section->reloff = sec64->reloff;
+    section->nreloc = from->nreloc;
+    section->flags = sec64->flags;
+    section->reserved1 = sec64->reserved1;
+    section->reserved2 = sec64->reserved2;
+    section->reserved3 = sec64->reserved3;
+    switch (from->contents) {
+        case ContentsInFile:
+            section->contents = MachdumpContentsInFile;
+            break;
+        case ContentsZeroFill:
+            section->contents = MachdumpContentsZeroFill;
+            break;
+        case ContentsOutOfBounds:
+            section->contents = MachdumpContentsOutOfBounds;
+            break;
+    }
+}
+
+// Hands a section's relocations to the visitor a batch at a time, unpacked
+// into a buffer on the stack.
+local enum machdump_step visit_relocations(
+    struct image* image, const struct machdump_visitor* visitor,
+    void* context, const struct image_section* from,
+    const struct machdump_section* section) {
+    const unsigned char* bytes = (const void*)image_relocations(image, from);
+    if (!bytes) {
+        return MachdumpContinue;
+    }
+    struct machdump_relocation relocs[MACHDUMP_RELOCATION_BATCH];
+    for (uint32_t i = 0; i < from->nreloc; i += MACHDUMP_RELOCATION_BATCH) {
+        const uint32_t count = from->nreloc - i < MACHDUMP_RELOCATION_BATCH
+            ? from->nreloc - i : MACHDUMP_RELOCATION_BATCH;
+        relocs_decode(bytes + (size_t)i * sizeof(S(relocation_info)), count,
+                      relocs);
+        const enum machdump_step step = visitor->relocations(context, section,
+                                                             relocs, count);
+        if (step != MachdumpContinue) {
+            return step;
+        }
+    }
+    return MachdumpContinue;
+}
+
+local enum machdump_step visit_section(struct image* image,
+                                       const struct machdump_visitor* visitor,
+                                       void* context,
+                                       const struct machdump_command* command,
+                                       const struct image_section* from,
+                                       uint32_t index) {
+    struct machdump_section section;
+    fill_section(&section, from, index);
+    const enum machdump_step step = VISIT(visitor, section, context, command,
+                                          &section);
+    if (step != MachdumpContinue) {
+        return step;
+    }
+    if (visitor->relocations && from->nreloc > 0
+        && visit_relocations(image, visitor, context, from, &section)
+           == MachdumpStop) {
+        return MachdumpStop;
+    }
+    return VISIT(visitor, end_section, context, command, &section);
+}
+
+local enum machdump_step visit_segment(struct image* image,
+                                       const struct machdump_visitor* visitor,
+                                       void* context,
+                                       const struct machdump_command* command,
+                                       const struct image_command* from) {
+    if (visitor->segment) {
+        struct machdump_segment segment;
+        fill_segment(&segment, from);
+        const enum machdump_step step = visitor->segment(context, command,
+                                                         &segment);
+        if (step != MachdumpContinue) {
+            return step;
+        }
+    }
+    for (uint32_t i = 0; i < from->nsects; i++) {
+        if (visit_section(image, visitor, context, command,
+                          &from->sections[i], i) == MachdumpStop) {
+            return MachdumpStop;
+        }
+    }
+    return MachdumpContinue;
+}
+
+local enum machdump_step visit_symbols(struct image* image,
+                                       const struct machdump_visitor* visitor,
+                                       void* context,
+                                       const struct machdump_command* command,
+                                       struct image_command* from) {
+    if (!visitor->symbol || image_symbols(image, from) != ImageOk) {
+        return MachdumpContinue;
+    }
+    for (uint32_t i = 0; i < from->nsyms; i++) {
+        const S(nlist_64*) nlist = from->symbols[i].nlist;
+        const struct machdump_symbol symbol = {
+            i, from->symbols[i].name, nlist->n_type, nlist->n_sect,
+            nlist->n_desc, nlist->n_value
+        };
+        if (visitor->symbol(context, command, &symbol) == MachdumpStop) {
+            return MachdumpStop;
+        }
+    }
+    return MachdumpContinue;
+}
+
+// Visits what lies inside a load command: the sections of a segment or the
+// symbols of a symbol table.
+local enum machdump_step visit_contents(struct image* image,
+                                        const struct machdump_visitor* visitor,
+                                        void* context,
+                                        const struct machdump_command* command,
+                                        struct image_command* from) {
+    if (command->truncated) {
+        return MachdumpContinue;
+    } else if (image_is_segment(command->cmd)) {
+        return visit_segment(image, visitor, context, command, from);
+    } else if (command->cmd == LC_SYMTAB) {
+        return visit_symbols(image, visitor, context, command, from);
+    }
+    return MachdumpContinue;
+}
+
+local enum machdump_step visit_commands(struct image* image,
+                                        const struct machdump_visitor* visitor,
+                                        void* context) {
+    if (visitor->header) {
+        struct machdump_header header;
+        fill_header(&header, image);
+        if (visitor->header(context, &header) == MachdumpStop) {
+            return MachdumpStop;
+        }
+    }
+    for (uint32_t i = 0; i < image->ncmds; i++) {
+        struct image_command* from = &image->commands[i];
+        struct machdump_command command;
+        fill_command(&command, from, i);
+        const enum machdump_step step = VISIT(visitor, load_command, context,
+                                              &command);
+        if (step == MachdumpStop) {
+            return MachdumpStop;
+        } else if (step == MachdumpSkip) {
+            continue;
+        }
+        if (visit_contents(image, visitor, context, &command, from)
+            == MachdumpStop
+            || VISIT(visitor, end_command, context, &command)
+               == MachdumpStop) {
+            return MachdumpStop;
+        }
+    }
+    return MachdumpContinue;
+}
+
+local void visit_errors(const struct image* image,
+                        const struct machdump_visitor* visitor,
+                        void* context) {
+    for (const struct image_error* from = image->errors; from;
+         from = from->next) {
+        const struct machdump_error error = {
+            image_status_message(from->status), from->command, from->offset
+        };
+        visitor->error(context, &error);
+    }
+}
+
+enum machdump_status machdump_visit_image(
+    struct image* image, const struct machdump_visitor* visitor,
+    void* context) {
+    const enum machdump_step step = visit_commands(image, visitor, context);
+    if (visitor->error) {
+        visit_errors(image, visitor, context);
+    }
+    if (step == MachdumpStop) {
+        return MachdumpStopped;
+    } else if (image->out_of_memory) {
+        return MachdumpOutOfMemory;
+    }
+    return image->error_count > 0 ? MachdumpMalformed : MachdumpOk;
+}
+
+local enum machdump_status parse_status(enum image_status status) {
+    switch (status) {
+        case ImageOk: return MachdumpOk;
+        case ImageNotMachO: return MachdumpNotMachO;
+        case ImageReadFailed: return MachdumpReadFailed;
+        case ImageOutOfMemory: return MachdumpOutOfMemory;
+        default: return MachdumpMalformed;
+    }
+}
+
+enum machdump_status machdump_visit(const void* data, size_t size,
+                                    const struct machdump_visitor* visitor,
+                                    void* context) {
+    struct source source;
+    struct arena arena;
+    struct image image;
+    source_from_memory(&source, data, size);
+    arena_init(&arena);
+    const enum image_status parsed = image_parse(&image, &source, &arena);
+    const enum machdump_status status = parsed == ImageOk
+        ? machdump_visit_image(&image, visitor, context)
+        : parse_status(parsed);
+    arena_free(&arena);
+    source_close(&source);
+    return status;
+}
+
+const char* machdump_status_message(enum machdump_status status) {
+    switch (status) {
+        case MachdumpOk: return "No error";
+        case MachdumpStopped: return "Stopped by the visitor";
+        case MachdumpMalformed: return "File is malformed";
+        case MachdumpNotMachO: return "Expected mach-o file";
+        case MachdumpOutOfMemory: return "Out of memory";
+        case MachdumpReadFailed: return "Could not read from file";
+    }
+    return "Unknown error";
+}
@@ -0,0 +1,320 @@
+// src/output.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "output.h"
+#include "safe.h"
+#include "stats.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define OUTPUT_BUFFER (1024 * 1024)
+#define MEMORY_BUFFER (64 * 1024)
+#define MARKUP_MAX 4
+
+struct output_format {
+    const char* key;
+    int literal;
+    char* text[2];
+    size_t length[2];
+};
+
+// Compiled formats are shared by every output and every thread. Each output
+// keeps a small direct-mapped cache in front of this table so that the lock
+// is only taken the first time an output sees a format.
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct output_format** registry;
+static size_t registry_capacity;
+static size_t registry_count;
+
+static size_t hash_pointer(const void* pointer) {
+    uintptr_t value = (uintptr_t)pointer;
+    value ^= value >> 17;
+    value *= 0x9e3779b1u;
+    return (size_t)(value ^ (value >> 15));
+}
+
+static int markup_code(char c) {
+    static const char colors[] = "KRGYBMCW";
+    const char* color = strchr(colors, c);
+    if (c != '\0' && color) {
+        return 30 + (int)(color - colors);
+    }
+    switch (c) {
+        case '+': return 1;
+        case '/': return 3;
+        case '_': return 4;
+        case '0': return 0;
+        default: return -1;
+    }
+}
+
+// Appends the escape sequence for the markup at `start` (just past the
+// opening brace) to `out`, or returns 0 if it is not valid markup.
+static size_t compile_markup(const char* start, char* out, int color) {
+    const char* end = start;
+    while (*end && *end != '}' && end - start < MARKUP_MAX) {
+        if (markup_code(*end) < 0) {
+            return 0;
+        }
+        end++;
+    }
+    if (*end != '}' || end == start) {
+        return 0;
+    }
+    if (color) {
+        char* cursor = out;
+        cursor += sprintf(cursor, "\x1b[");
+        for (const char* c = start; c < end; c++) {
+            cursor += sprintf(cursor, c == start ? "%d" : ";%d",
+                              markup_code(*c));
+        }
+        sprintf(cursor, "m");
+    } else {
+        out[0] = '\0';
+    }
+    return (size_t)(end - start) + 2;
+}
+
+static char* compile(const char* format, int color, size_t* length) {
+    // Every markup expands to at most 4 codes of 3 bytes each plus "\x1b[m".
+    const size_t original = strlen(format);
+    char* text = xmalloc(original * 4 + 1);
+    char* out = text;
+    const char* in = format;
+    while (*in) {
+        char escape[MARKUP_MAX * 3 + 4];
+        size_t consumed;
+        if (*in == '{' && (consumed = compile_markup(in + 1, escape, color))) {
+            const size_t n = strlen(escape);
+            memcpy(out, escape, n);
+            out += n;
+            in += consumed;
+        } else {
+            *out++ = *in++;
+        }
+    }
+    *out = '\0';
+    *length = (size_t)(out - text);
+    return text;
+}
+
+static struct output_format* registry_insert(const char* key) {
+    if ((registry_count + 1) * 2 > registry_capacity) {
+        const size_t capacity = registry_capacity ? registry_capacity * 2 : 256;
+        struct output_format** table = xmalloc(sizeof(*table) * capacity);
+        memset(table, 0, sizeof(*table) * capacity);
+        for (size_t i = 0; i < registry_capacity; i++) {
+            if (registry[i]) {
+                size_t slot = hash_pointer(registry[i]->key) & (capacity - 1);
+                while (table[slot]) slot = (slot + 1) & (capacity - 1);
+                table[slot] = registry[i];
+            }
+        }
+        xfree(registry);
+        registry = table;
+        registry_capacity = capacity;
+    }
+
+    size_t slot = hash_pointer(key) & (registry_capacity - 1);
+    while (registry[slot]) {
+        if (registry[slot]->key == key) {
+            return registry[slot];
+        }
+        slot = (slot + 1) & (registry_capacity - 1);
+    }
+    struct output_format* format = xmalloc(sizeof(*format));
+    format->key = key;
+    format->literal = strchr(key, '%') == NULL;
+    format->text[0] = compile(key, 0, &format->length[0]);
+    format->text[1] = compile(key, 1, &format->length[1]);
+    registry[slot] = format;
+    registry_count++;
+    return format;
+}
+
+static const struct output_format* lookup(struct output* output,
+                                          const char* key) {
+    const size_t slot = hash_pointer(key) % OUTPUT_CACHE_SIZE;
+    const struct output_format* format = output->cache[slot];
+    if (format && format->key == key) {
+        return format;
+    }
+    pthread_mutex_lock(&registry_lock);
+    format = registry_insert(key);
+    pthread_mutex_unlock(&registry_lock);
+    output->cache[slot] = format;
+    return format;
+}
+
+static void write_all(struct output* output, const char* bytes,
+                      size_t length) {
+    if (length == 0) {
+        return;
+    }
+    const uint64_t start = stats_now();
+    output->flushed += length;
+    while (length > 0 && !output->failed) {
+        const ssize_t count = write(output->fd, bytes, length);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        } else if (count <= 0) {
+            output->failed = 1;
+            break;
+        }
+        bytes += count;
+        length -= (size_t)count;
+    }
+    output->write_ns += stats_now() - start;
+}
+
+// Makes room for `extra` more bytes, flushing file outputs when possible and
+// growing the buffer otherwise.
+static void reserve(struct output* output, size_t extra) {
+    if (output->capacity - output->length >= extra) {
+        return;
+    }
+    if (output->fd >= 0) {
+        output_flush(output);
+        if (output->capacity >= extra) {
+            return;
+        }
+    }
+    size_t capacity = output->capacity ? output->capacity : MEMORY_BUFFER;
+    while (capacity - output->length < extra) {
+        capacity *= 2;
+    }
+    char* data = xmalloc(capacity);
+    memcpy(data, output->data, output->length);
+    xfree(output->data);
+    output->data = data;
+    output->capacity = capacity;
+}
+
+static void open_common(struct output* output, int fd, int color,
+                        size_t capacity) {
+    memset(output, 0, sizeof(*output));
+    output->fd = fd;
+    output->color = color != 0;
+    output->data = xmalloc(capacity);
+    output->capacity = capacity;
+}
+
+void output_open(struct output* output, int fd, int color) {
+    open_common(output, fd, color, OUTPUT_BUFFER);
+}
+
+void output_open_memory(struct output* output, int color) {
+    open_common(output, -1, color, MEMORY_BUFFER);
+}
+
+int output_default_color(int fd) {
+    return isatty(fd) && !getenv("NO_COLOR");
+}
+
+void output_vprintf(struct output* output, const char* format,
+                    va_list args) {
+    const struct output_format* compiled = lookup(output, format);
+    const char* text = compiled->text[output->color];
+    if (compiled->literal) {
+        output_write(output, text, compiled->length[output->color]);
+        return;
+    }
+    reserve(output, compiled->length[output->color] + 64);
+    for (;;) {
+        const size_t room = output->capacity - output->length;
+        va_list copy;
+        va_copy(copy, args);
+        const int count = vsnprintf(output->data + output->length, room,
+                                    text, copy);
+        va_end(copy);
+        if (count < 0) {
+            return;
+        } else if ((size_t)count < room) {
+            output->length += (size_t)count;
+            return;
+        }
+        reserve(output, (size_t)count + 1);
+    }
+}
+
+void output_printf(struct output* output, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    output_vprintf(output, format, args);
+    va_end(args);
+}
+
+void output_write(struct output* output, const void* bytes, size_t length) {
+    if (output->fd >= 0 && length >= output->capacity) {
+        output_flush(output);
+        write_all(output, bytes, length);
+        return;
+    }
+    reserve(output, length);
+    memcpy(output->data + output->length, bytes, length);
+    output->length += length;
+}
+
+void output_char(struct output* output, char c) {
+    if (output->length == output->capacity) {
+        reserve(output, 1);
+    }
+    output->data[output->length++] = c;
+}
+
+const char* output_markup(struct output* output, const char* format,
+                          size_t* length) {
+    const struct output_format* compiled = lookup(output, format);
+    *length = compiled->length[output->color];
+    return compiled->text[output->color];
+}
+
+char* output_claim(struct output* output, size_t length) {
+    reserve(output, length);
+    char* bytes = output->data + output->length;
+    output->length += length;
+    return bytes;
+}
+
+int output_flush(struct output* output) {
+    if (output->fd >= 0) {
+        write_all(output, output->data, output->length);
+        output->length = 0;
+    }
+    return output->failed ? -1 : 0;
+}
+
+uint64_t output_emitted(const struct output* output) {
+    return output->flushed + output->length;
+}
+
+void output_reset(struct output* output) {
+    output->length = 0;
+}
+
+void output_close(struct output* output) {
+    output_flush(output);
+    xfree(output->data);
+    output->data = NULL;
+    output->length = 0;
+    output->capacity = 0;
+}
@@ -0,0 +1,184 @@
+// src/record.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#include "record.h"
+#include "output.h"
+#include "safe.h"
+#include <stdio.h>
+#include <string.h>
+
+#define RECORD_BUFFER 4096
+
+enum {
+    TagUnsigned,
+    TagSigned,
+    TagString
+};
+
+// Records are assembled in a scratch buffer and handed to the output whole,
+// which lets binary records be length-prefixed even if the output flushes.
+static void reserve(struct record_writer* writer, size_t extra) {
+    if (writer->capacity - writer->length >= extra) {
+        return;
+    }
+    size_t capacity = writer->capacity * 2;
+    while (capacity - writer->length < extra) {
+        capacity *= 2;
+    }
+    char* data = xmalloc(capacity);
+    memcpy(data, writer->data, writer->length);
+    xfree(writer->data);
+    writer->data = data;
+    writer->capacity = capacity;
+}
+
+static void append(struct record_writer* writer, const void* bytes,
+                   size_t length) {
+    reserve(writer, length);
+    memcpy(writer->data + writer->length, bytes, length);
+    writer->length += length;
+}
+
+static void append_byte(struct record_writer* writer, unsigned char byte) {
+    append(writer, &byte, 1);
+}
+
+static void append_le(struct record_writer* writer, uint64_t value,
+                      size_t size) {
+    unsigned char bytes[8];
+    for (size_t i = 0; i < size; i++) {
+        bytes[i] = (unsigned char)(value >> (8 * i));
+    }
+    append(writer, bytes, size);
+}
+
+static void append_json_string(struct record_writer* writer,
+                               const char* value, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+    append_byte(writer, '"');
+    for (size_t i = 0; i < length; i++) {
+        const unsigned char c = (unsigned char)value[i];
+        if (c == '"' || c == '\\') {
+            const char escaped[2] = { '\\', (char)c };
+            append(writer, escaped, 2);
+        } else if (c < 0x20 || c >= 0x7f) {
+            const char escaped[6] = {
+                '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]
+            };
+            append(writer, escaped, 6);
+        } else {
+            append_byte(writer, c);
+        }
+    }
+    append_byte(writer, '"');
+}
+
+static void append_short_string(struct record_writer* writer,
+                                const char* value) {
+    const size_t length = strlen(value);
+    append_byte(writer, (unsigned char)length);
+    append(writer, value, length);
+}
+
+static void begin_field(struct record_writer* writer, const char* key,
+                        int tag) {
+    if (writer->format == RecordJson) {
+        append_byte(writer, ',');
+        append_json_string(writer, key, strlen(key));
+        append_byte(writer, ':');
+    } else {
+        append_short_string(writer, key);
+        append_byte(writer, (unsigned char)tag);
+    }
+}
+
+void record_writer_init(struct record_writer* writer, struct output* out,
+                        enum record_format format) {
+    writer->out = out;
+    writer->format = format;
+    writer->data = xmalloc(RECORD_BUFFER);
+    writer->length = 0;
+    writer->capacity = RECORD_BUFFER;
+}
+
+void record_writer_free(struct record_writer* writer) {
+    xfree(writer->data);
+    writer->data = NULL;
+}
+
+void record_begin(struct record_writer* writer, const char* type) {
+    writer->length = 0;
+    if (writer->format == RecordJson) {
+        append(writer, "{\"type\":", 8);
+        append_json_string(writer, type, strlen(type));
+    } else {
+        append_le(writer, 0, 4);
+        append_short_string(writer, type);
+    }
+}
+
+void record_uint(struct record_writer* writer, const char* key,
+                 uint64_t value) {
+    begin_field(writer, key, TagUnsigned);
+    if (writer->format == RecordJson) {
+        char text[24];
+        append(writer, text, (size_t)sprintf(text, "%llu",
+                                             (unsigned long long)value));
+    } else {
+        append_le(writer, value, 8);
+    }
+}
+
+void record_int(struct record_writer* writer, const char* key,
+                int64_t value) {
+    begin_field(writer, key, TagSigned);
+    if (writer->format == RecordJson) {
+        char text[24];
+        append(writer, text, (size_t)sprintf(text, "%lld", (long long)value));
+    } else {
+        append_le(writer, (uint64_t)value, 8);
+    }
+}
+
+void record_string_n(struct record_writer* writer, const char* key,
+                     const char* value, size_t max) {
+    const char* end = memchr(value, '\0', max);
+    const size_t length = end ? (size_t)(end - value) : max;
+    begin_field(writer, key, TagString);
+    if (writer->format == RecordJson) {
+        append_json_string(writer, value, length);
+    } else {
+        append_le(writer, length, 4);
+        append(writer, value, length);
+    }
+}
+
+void record_string(struct record_writer* writer, const char* key,
+                   const char* value) {
+    record_string_n(writer, key, value, strlen(value));
+}
+
+void record_end(struct record_writer* writer) {
+    if (writer->format == RecordJson) {
+        append(writer, "}\n", 2);
+    } else {
+        const size_t length = writer->length - 4;
+        for (size_t i = 0; i < 4; i++) {
+            writer->data[i] = (char)(length >> (8 * i));
+        }
+    }
+    output_write(writer->out, writer->data, writer->length);
+}
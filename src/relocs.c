@@ -0,0 +1,73 @@
+// src/relocs.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#include "relocs.h"
+#include <string.h>
+#include <mach-o/loader.h>
+#include <mach-o/reloc.h>
+#include <mach-o/arm64/reloc.h>
+#include <mach-o/x86_64/reloc.h>
+
+#define S(...) struct __VA_ARGS__
+
+#define NAME(value) [value] = #value
+
+static const char* const x86_64_names[16] = {
+    NAME(X86_64_RELOC_UNSIGNED), NAME(X86_64_RELOC_SIGNED),
+    NAME(X86_64_RELOC_BRANCH), NAME(X86_64_RELOC_GOT_LOAD),
+    NAME(X86_64_RELOC_GOT), NAME(X86_64_RELOC_SUBTRACTOR),
+    NAME(X86_64_RELOC_SIGNED_1), NAME(X86_64_RELOC_SIGNED_2),
+    NAME(X86_64_RELOC_SIGNED_4), NAME(X86_64_RELOC_TLV),
+};
+
+static const char* const arm64_names[16] = {
+    NAME(ARM64_RELOC_UNSIGNED), NAME(ARM64_RELOC_SUBTRACTOR),
+    NAME(ARM64_RELOC_BRANCH26), NAME(ARM64_RELOC_PAGE21),
+    NAME(ARM64_RELOC_PAGEOFF12), NAME(ARM64_RELOC_GOT_LOAD_PAGE21),
+    NAME(ARM64_RELOC_GOT_LOAD_PAGEOFF12), NAME(ARM64_RELOC_POINTER_TO_GOT),
+    NAME(ARM64_RELOC_TLVP_LOAD_PAGE21), NAME(ARM64_RELOC_TLVP_LOAD_PAGEOFF12),
+    NAME(ARM64_RELOC_ADDEND), NAME(ARM64_RELOC_AUTHENTICATED_POINTER),
+};
+
+void relocs_decode(const void* bytes, uint32_t count,
+                   struct machdump_relocation* relocs) {
+    const unsigned char* entry = bytes;
+    for (uint32_t i = 0; i < count; i++, entry += sizeof(S(relocation_info))) {
+        uint32_t words[2];
+        memcpy(words, entry, sizeof(words));
+        relocs[i].address = (int32_t)words[0];
+        relocs[i].symbolnum = words[1] & 0xffffff;
+        relocs[i].pcrel = (words[1] >> 24) & 1;
+        relocs[i].length = (words[1] >> 25) & 3;
+        relocs[i].external = (words[1] >> 27) & 1;
+        relocs[i].type = (uint8_t)(words[1] >> 28);
+    }
+}
+
+const char* reloc_type_name(int32_t cputype, uint32_t type) {
+    if (type >= 16) {
+        return NULL;
+    } else if (cputype == CPU_TYPE_X86_64) {
+        return x86_64_names[type];
+    } else if (cputype == CPU_TYPE_ARM64) {
+        return arm64_names[type];
+    }
+    return NULL;
+}
+
+int reloc_is_addend(int32_t cputype, uint32_t type) {
+    return cputype == CPU_TYPE_ARM64 && type == ARM64_RELOC_ADDEND;
+}
@@ -0,0 +1,224 @@
+// src/source.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "source.h"
+#include "safe.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define STREAM_CHUNK (64 * 1024)
+
+struct source_region {
+    struct source_region* next;
+    size_t offset;
+    size_t size;
+    char bytes[];
+};
+
+static int source_slurp(struct source* source, int fd) {
+    size_t capacity = STREAM_CHUNK;
+    size_t length = 0;
+    char* data = xmalloc(capacity);
+    for (;;) {
+        if (length == capacity) {
+            char* grown = xmalloc(capacity * 2);
+            memcpy(grown, data, length);
+            xfree(data);
+            data = grown;
+            capacity *= 2;
+        }
+        const ssize_t count = read(fd, data + length, capacity - length);
+        if (count == 0) {
+            break;
+        } else if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            xfree(data);
+            return -1;
+        }
+        length += (size_t)count;
+    }
+    source->kind = SourceMemory;
+    source->data = data;
+    source->length = length;
+    source->owns_data = 1;
+    return 0;
+}
+
+int source_open(struct source* source, const char* filename) {
+    memset(source, 0, sizeof(*source));
+    source->fd = -1;
+
+    const int is_stdin = strcmp(filename, "-") == 0;
+    const int fd = is_stdin ? STDIN_FILENO : open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        const int saved = errno;
+        if (!is_stdin) close(fd);
+        errno = saved;
+        return -1;
+    }
+
+    if (!S_ISREG(info.st_mode)) {
+        const int status = source_slurp(source, fd);
+        const int saved = errno;
+        if (!is_stdin) close(fd);
+        errno = saved;
+        return status;
+    }
+
+    source->length = (size_t)info.st_size;
+    if (source->length == 0) {
+        source->kind = SourceMemory;
+        if (!is_stdin) close(fd);
+        return 0;
+    }
+
+    void* map = mmap(NULL, source->length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+        source->kind = SourceMapped;
+        source->data = map;
+        if (!is_stdin) close(fd);
+        return 0;
+    }
+
+    source->kind = SourcePositioned;
+    source->fd = is_stdin ? dup(fd) : fd;
+    if (source->fd < 0) {
+        return -1;
+    }
+    pthread_mutex_init(&source->lock, NULL);
+    return 0;
+}
+
+void source_from_memory(struct source* source, const void* buffer,
+                        size_t length) {
+    memset(source, 0, sizeof(*source));
+    source->kind = SourceMemory;
+    source->fd = -1;
+    source->data = buffer;
+    source->length = length;
+}
+
+int source_slice(struct source* slice, struct source* parent, size_t offset,
+                 size_t size) {
+    if (offset > parent->length || size > parent->length - offset) {
+        return -1;
+    }
+    memset(slice, 0, sizeof(*slice));
+    slice->kind = parent->kind;
+    slice->fd = -1;
+    slice->length = size;
+    slice->parent = parent;
+    slice->base = offset;
+    return 0;
+}
+
+static const void* source_pread_locked(struct source* source, size_t offset,
+                                       size_t size) {
+    for (struct source_region* region = source->regions; region;
+         region = region->next) {
+        if (offset >= region->offset
+            && offset - region->offset <= region->size
+            && size <= region->size - (offset - region->offset)) {
+            return region->bytes + (offset - region->offset);
+        }
+    }
+
+    struct source_region* region = xmalloc(sizeof(*region) + size);
+    size_t done = 0;
+    while (done < size) {
+        const ssize_t count = pread(source->fd, region->bytes + done,
+                                    size - done, (off_t)(offset + done));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        } else if (count <= 0) {
+            xfree(region);
+            return NULL;
+        }
+        done += (size_t)count;
+    }
+    region->offset = offset;
+    region->size = size;
+    region->next = source->regions;
+    source->regions = region;
+    return region->bytes;
+}
+
+static const void* source_pread(struct source* source, size_t offset,
+                                size_t size) {
+    pthread_mutex_lock(&source->lock);
+    const void* bytes = source_pread_locked(source, offset, size);
+    pthread_mutex_unlock(&source->lock);
+    return bytes;
+}
+
+// Reads on behalf of a slice are counted against the slice only, so that
+// slices dumped on different threads never update the same counter.
+static const void* source_at(struct source* source, size_t offset,
+                             size_t size) {
+    if (source->parent) {
+        return source_at(source->parent, source->base + offset, size);
+    }
+    if (source->kind == SourcePositioned) {
+        return source_pread(source, offset, size);
+    }
+    return source->data + offset;
+}
+
+const void* source_read(struct source* source, size_t offset, size_t size) {
+    if (offset > source->length || size > source->length - offset) {
+        return NULL;
+    }
+    source->bytes_read += size;
+    return source_at(source, offset, size);
+}
+
+void source_close(struct source* source) {
+    if (source->parent) {
+        source->parent = NULL;
+        return;
+    }
+    if (source->kind == SourceMapped) {
+        munmap((void*)source->data, source->length);
+    } else if (source->owns_data) {
+        xfree((void*)source->data);
+    }
+    while (source->regions) {
+        struct source_region* next = source->regions->next;
+        xfree(source->regions);
+        source->regions = next;
+    }
+    if (source->kind == SourcePositioned) {
+        pthread_mutex_destroy(&source->lock);
+    }
+    if (source->fd >= 0) {
+        close(source->fd);
+    }
+    source->data = NULL;
+    source->fd = -1;
+}
@@ -0,0 +1,152 @@
+// src/stats.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "stats.h"
+#include "dump.h"
+#include "output.h"
+#include "record.h"
+#include <stdlib.h>
+#include <time.h>
+
+uint64_t stats_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+void stats_merge(struct stats* into, const struct stats* from) {
+    into->files += from->files;
+    into->load_ns += from->load_ns;
+    into->parse_ns += from->parse_ns;
+    into->render_ns += from->render_ns;
+    into->write_ns += from->write_ns;
+    into->bytes_read += from->bytes_read;
+    into->bytes_emitted += from->bytes_emitted;
+    into->commands += from->commands;
+    into->sections += from->sections;
+    into->symbols += from->symbols;
+    into->cache_hits += from->cache_hits;
+    into->cache_misses += from->cache_misses;
+    for (size_t i = 0; i < STATS_COMMAND_SLOTS; i++) {
+        if (from->by_command[i].count > 0) {
+            into->by_command[i].cmd = from->by_command[i].cmd;
+            into->by_command[i].count += from->by_command[i].count;
+            into->by_command[i].ns += from->by_command[i].ns;
+        }
+    }
+}
+
+static int compare_time(const void* lhs, const void* rhs) {
+    const struct stats_command* a = *(const struct stats_command* const*)lhs;
+    const struct stats_command* b = *(const struct stats_command* const*)rhs;
+    return (a->ns < b->ns) - (a->ns > b->ns);
+}
+
+// Collects the command types that took the most time, slowest first.
+static size_t slowest(const struct stats* stats,
+                      const struct stats_command** out) {
+    const struct stats_command* seen[STATS_COMMAND_SLOTS];
+    size_t n = 0;
+    for (size_t i = 0; i < STATS_COMMAND_SLOTS; i++) {
+        if (stats->by_command[i].count > 0) {
+            seen[n++] = &stats->by_command[i];
+        }
+    }
+    qsort(seen, n, sizeof(*seen), compare_time);
+    if (n > STATS_SLOWEST) {
+        n = STATS_SLOWEST;
+    }
+    for (size_t i = 0; i < n; i++) {
+        out[i] = seen[i];
+    }
+    return n;
+}
+
+static const char* command_name(uint32_t cmd) {
+    const char* name = load_command_name(cmd);
+    return name ? name : "Unknown";
+}
+
+static void print_json(struct output* out, const char* name,
+                       const struct stats* stats,
+                       const struct stats_command** top, size_t n) {
+    struct record_writer records;
+    record_writer_init(&records, out, RecordJson);
+    record_begin(&records, "stats");
+    record_string(&records, "name", name);
+    record_uint(&records, "files", stats->files);
+    record_uint(&records, "load_ns", stats->load_ns);
+    record_uint(&records, "parse_ns", stats->parse_ns);
+    record_uint(&records, "render_ns", stats->render_ns);
+    record_uint(&records, "write_ns", stats->write_ns);
+    record_uint(&records, "bytes_read", stats->bytes_read);
+    record_uint(&records, "bytes_emitted", stats->bytes_emitted);
+    record_uint(&records, "commands", stats->commands);
+    record_uint(&records, "sections", stats->sections);
+    record_uint(&records, "symbols", stats->symbols);
+    record_uint(&records, "cache_hits", stats->cache_hits);
+    record_uint(&records, "cache_misses", stats->cache_misses);
+    record_end(&records);
+    for (size_t i = 0; i < n; i++) {
+        record_begin(&records, "stats_command");
+        record_string(&records, "name", command_name(top[i]->cmd));
+        record_uint(&records, "cmd", top[i]->cmd);
+        record_uint(&records, "count", top[i]->count);
+        record_uint(&records, "ns", top[i]->ns);
+        record_end(&records);
+    }
+    record_writer_free(&records);
+}
+
+void stats_print(struct output* out, enum stats_format format,
+                 const char* name, const struct stats* stats) {
+    const struct stats_command* top[STATS_SLOWEST];
+    const size_t n = slowest(stats, top);
+    if (format == StatsJson) {
+        print_json(out, name, stats, top, n);
+        return;
+    }
+    const uint64_t total = stats->load_ns + stats->parse_ns
+        + stats->render_ns + stats->write_ns;
+    output_printf(out, "│ {C}Stats{0}: %s\n", name);
+    output_printf(out, "└─┐ Load: %.3f ms\n", stats->load_ns / 1e6);
+    output_printf(out, "  │ Parse: %.3f ms\n", stats->parse_ns / 1e6);
+    output_printf(out, "  │ Render: %.3f ms\n", stats->render_ns / 1e6);
+    output_printf(out, "  │ Write: %.3f ms\n", stats->write_ns / 1e6);
+    output_printf(out, "  │ Total: %.3f ms\n", total / 1e6);
+    output_printf(out, "  │ Bytes read: %llu\n",
+                  (unsigned long long)stats->bytes_read);
+    output_printf(out, "  │ Bytes emitted: %llu\n",
+                  (unsigned long long)stats->bytes_emitted);
+    output_printf(out, "  │ Load commands: %llu, sections: %llu, "
+                  "symbols: %llu\n", (unsigned long long)stats->commands,
+                  (unsigned long long)stats->sections,
+                  (unsigned long long)stats->symbols);
+    if (stats->cache_hits + stats->cache_misses > 0) {
+        output_printf(out, "  │ Cache hits: %llu, misses: %llu\n",
+                      (unsigned long long)stats->cache_hits,
+                      (unsigned long long)stats->cache_misses);
+    }
+    output_printf(out, "%s Slowest command types:%s\n",
+                  n > 0 ? "  │" : "┌─┘", n > 0 ? "" : " None");
+    for (size_t i = 0; i < n; i++) {
+        output_printf(out, "%s   {+}%s{0}: %u command(s), %.3f ms\n",
+                      i + 1 < n ? "  │" : "┌─┘", command_name(top[i]->cmd),
+                      top[i]->count, top[i]->ns / 1e6);
+    }
+}
@@ -0,0 +1,162 @@
+// src/symbols.c
+// Copyright (C) 2021 Ethan Uppal
+//
+// machdump is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// machdump is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+#include "symbols.h"
+#include "safe.h"
+#include <string.h>
+#include <mach-o/nlist.h>
+
+static uint64_t hash_name(const char* name) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static int compare_names(const void* lhs, const void* rhs) {
+    const struct symbol_name_entry* a = lhs;
+    const struct symbol_name_entry* b = rhs;
+    const int order = strcmp(a->name, b->name);
+    return order ? order : (a->index > b->index) - (a->index < b->index);
+}
+
+static int compare_addresses(const void* lhs, const void* rhs) {
+    const struct symbol_address_entry* a = lhs;
+    const struct symbol_address_entry* b = rhs;
+    if (a->value != b->value) {
+        return a->value < b->value ? -1 : 1;
+    }
+    return (a->index > b->index) - (a->index < b->index);
+}
+
+const char* symbol_index_name(const struct symbol_index* index, uint32_t i) {
+    const uint32_t strx = index->symbols[i].n_un.n_strx;
+    if (strx >= index->strsize
+        || !memchr(index->strings + strx, '\0', index->strsize - strx)) {
+        return "";
+    }
+    return index->strings + strx;
+}
+
+void symbol_index_build(struct symbol_index* index,
+                        const struct nlist_64* symbols, uint32_t count,
+                        const char* strings, uint32_t strsize) {
+    memset(index, 0, sizeof(*index));
+    index->symbols = symbols;
+    index->count = count;
+    index->strings = strings;
+    index->strsize = strsize;
+
+    size_t buckets = 16;
+    while (buckets < (size_t)count * 2) {
+        buckets *= 2;
+    }
+    index->mask = buckets - 1;
+    index->buckets = xmalloc(sizeof(*index->buckets) * buckets);
+    memset(index->buckets, 0xff, sizeof(*index->buckets) * buckets);
+    index->by_name = xmalloc(sizeof(*index->by_name) * (count + 1));
+    index->by_address = xmalloc(sizeof(*index->by_address) * (count + 1));
+
+    for (uint32_t i = 0; i < count; i++) {
+        const char* name = symbol_index_name(index, i);
+        size_t slot = (size_t)hash_name(name) & index->mask;
+        while (index->buckets[slot] != SYMBOL_NONE) {
+            slot = (slot + 1) & index->mask;
+        }
+        index->buckets[slot] = i;
+        index->by_name[i].name = name;
+        index->by_name[i].index = i;
+
+        const uint8_t type = symbols[i].n_type;
+        if (!(type & N_STAB) && (type & N_TYPE) == N_SECT) {
+            struct symbol_address_entry* entry =
+                &index->by_address[index->address_count++];
+            entry->value = symbols[i].n_value;
+            entry->index = i;
+        }
+    }
+    qsort(index->by_name, count, sizeof(*index->by_name), compare_names);
+    qsort(index->by_address, index->address_count,
+          sizeof(*index->by_address), compare_addresses);
+}
+
+void symbol_index_free(struct symbol_index* index) {
+    xfree(index->buckets);
+    xfree(index->by_name);
+    xfree(index->by_address);
+    memset(index, 0, sizeof(*index));
+}
+
+uint32_t symbol_index_find(const struct symbol_index* index,
+                           const char* name, size_t* cursor) {
+    // The cursor counts probes from the name's home slot, so a search can be
+    // resumed to find every symbol sharing the name.
+    const size_t home = (size_t)hash_name(name) & index->mask;
+    for (size_t probe = *cursor; probe <= index->mask; probe++) {
+        const uint32_t i = index->buckets[(home + probe) & index->mask];
+        if (i == SYMBOL_NONE) {
+            break;
+        }
+        if (strcmp(symbol_index_name(index, i), name) == 0) {
+            *cursor = probe + 1;
+            return i;
+        }
+    }
+    *cursor = index->mask + 1;
+    return SYMBOL_NONE;
+}
+
+size_t symbol_index_prefix(const struct symbol_index* index,
+                           const char* prefix, size_t* first) {
+    const size_t length = strlen(prefix);
+    size_t low = 0, high = index->count;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (strncmp(index->by_name[middle].name, prefix, length) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    *first = low;
+    size_t end = low;
+    high = index->count;
+    while (end < high) {
+        const size_t middle = end + (high - end) / 2;
+        if (strncmp(index->by_name[middle].name, prefix, length) == 0) {
+            end = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return end - low;
+}
+
+uint32_t symbol_index_containing(const struct symbol_index* index,
+                                 uint64_t address) {
+    size_t low = 0, high = index->address_count;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (index->by_address[middle].value <= address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low == 0 ? SYMBOL_NONE : index->by_address[low - 1].index;
+}
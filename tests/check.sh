@@ -0,0 +1,105 @@
+#!/bin/sh
+# tests/check.sh
+# Copyright (C) 2021 Ethan Uppal
+#
+# machdump is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# machdump is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with machdump. If not, see <https://www.gnu.org/licenses/>.
+
+# Regression checks on files generated by bench/machgen. Run by `make check`
+# with the machdump and machgen binaries to use.
+
+MACHDUMP=${1:-./machdump}
+MACHGEN=${2:-bench/machgen}
+DIR=${TMPDIR:-/tmp}/machdump-check.$$
+mkdir -p "$DIR" || exit 1
+trap 'rm -rf "$DIR"' EXIT
+failures=0
+
+fail() {
+    echo "FAIL: $1"
+    failures=$((failures + 1))
+}
+
+# Sets byte `offset` of `file` to `value`, given in octal.
+poke() {
+    printf "\\$3" | dd of="$1" bs=1 seek="$2" conv=notrunc 2>/dev/null
+}
+
+# Changing the flags of the last section must change the hashes of 32-bit
+# and byte-swapped files, which are hashed as stored, not as converted.
+# With three sections, the last one's flags are at 276 in 32-bit files and
+# 328 in 64-bit ones.
+for variant in "--width 32" "--big-endian" "--width 32 --big-endian"; do
+    case "$variant" in
+        *32*) flags=276 ;;
+        *) flags=328 ;;
+    esac
+    $MACHGEN $variant --sections 3 --symbols 16 --section-size 64 \
+        -o "$DIR/before.o" || exit 1
+    cp "$DIR/before.o" "$DIR/after.o"
+    poke "$DIR/after.o" $((flags + 3)) 001
+    $MACHDUMP --no-color --hash "$DIR/before.o" > "$DIR/before.txt"
+    $MACHDUMP --no-color --hash "$DIR/after.o" > "$DIR/after.txt"
+    if cmp -s "$DIR/before.txt" "$DIR/after.txt"; then
+        fail "--hash $variant: section flags change not hashed"
+    fi
+done
+
+# The symbol table is hashed and counted with the entry size of the file's
+# width: 16 bytes per nlist_64 and 12 per nlist. --summary counts the
+# command, its 16 entries and their 257 bytes of strings.
+for width in 32 64; do
+    case "$width" in
+        32) expected=192 ;;
+        *) expected=256 ;;
+    esac
+    $MACHGEN --width $width --symbols 16 -o "$DIR/symbols.o" || exit 1
+    if ! $MACHDUMP --no-color --hash "$DIR/symbols.o" \
+       | grep -q "LC_SYMTAB symbols: $expected byte(s)"; then
+        fail "--hash --width $width: symbol table not $expected bytes"
+    fi
+    total=$((24 + expected + 257))
+    if ! $MACHDUMP --no-color --summary "$DIR/symbols.o" \
+       | grep -q "LC_SYMTAB: 1 command(s), $total byte(s)"; then
+        fail "--summary --width $width: LC_SYMTAB not $total bytes"
+    fi
+done
+
+# --cmd alone picks only the commands named, not segments with sections.
+$MACHGEN --sections 3 --symbols 16 --section-size 64 -o "$DIR/cmd.o" || exit 1
+types=$($MACHDUMP --no-color --cmd LC_SYMTAB "$DIR/cmd.o" \
+        | grep "Command Type" | grep -v -c LC_SYMTAB)
+if [ "$types" -ne 0 ]; then
+    fail "--cmd LC_SYMTAB: $types other command(s) dumped"
+fi
+if $MACHDUMP --no-color --hash --cmd LC_SYMTAB "$DIR/cmd.o" \
+   | grep -q "Segment\|Section"; then
+    fail "--hash --cmd LC_SYMTAB: segments hashed"
+fi
+
+# Modes that replace the dump are rejected together rather than one of them
+# silently winning, but --symbol still picks fixups.
+for modes in "--hash --strings" "--hash --fixups" "--hash --symbol _sym0" \
+             "--strings --relocs=summary" "--fixups --addr 0"; do
+    if $MACHDUMP $modes "$DIR/cmd.o" > /dev/null 2>&1; then
+        fail "$modes: accepted together"
+    fi
+done
+if ! $MACHDUMP --fixups --symbol _sym0 "$DIR/cmd.o" > /dev/null; then
+    fail "--fixups --symbol: rejected"
+fi
+
+if [ "$failures" -gt 0 ]; then
+    exit 1
+fi
+echo "All checks passed"